@@ -1,10 +1,13 @@
 #ifndef PLANT_FATE_PLANT_ASSIMILATION_H_
 #define PLANT_FATE_PLANT_ASSIMILATION_H_
 
+#include <memory>
 #include <phydro.h>
 
 #include "plant_params.h"
 #include "plant_geometry.h"
+#include "phydro_cache.h"
+#include "utils/profiler.h"
 
 namespace plant{
 
@@ -43,21 +46,28 @@ class Assimilator{
 	double kappa_l;   ///< leaf turnover rate, updated by les functions
 	double kappa_r;   ///< fine root turnover rate, updated by les functions
 
+	/// Optional interpolation table for leaf assimilation. Plants copied from the same plant share the table. 
+	std::shared_ptr<PhydroCache> phydro_cache;
+
 	public:	
 
-	/// @brief  Calculate leaf-level assimilation rate using the Phydro model
+	/// @brief  Calculate leaf-level assimilation rate using the Phydro model, or its interpolation table if available
 	template<class _Climate>
 	phydro::PHydroResult leaf_assimilation_rate(double I0, double fapar, _Climate &clim, PlantParameters &par, PlantTraits &traits);
+
+	/// @brief  Calculate leaf-level assimilation rate using the Phydro model
+	template<class _Climate>
+	phydro::PHydroResult leaf_assimilation_rate_exact(double I0, double fapar, _Climate &clim, PlantParameters &par, PlantTraits &traits);
 	
 
 	/// @brief  Calculate whole-plant gross assimilation, transpiration, gs, etc. 
 	template<class Env>
-	void  calc_plant_assimilation_rate(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits);
+	void  calc_plant_assimilation_rate(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits, double c_open_avg = -1);
 
 
 	/// @brief  Calculate whole-plant net assimilation 
 	template<class Env>
-	PlantAssimilationResult net_production(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits);
+	PlantAssimilationResult net_production(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits, double c_open_avg = -1);
 
 
 	/// @brief Leaf economics - calculate optimal leaf lifespan 
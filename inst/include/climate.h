@@ -7,6 +7,11 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+
+#include "utils/mapped_file.h"
 
 
 namespace env{
@@ -24,61 +29,176 @@ class Clim{
 };
 
 
+/// @brief   Met and CO2 time series read from the forcing files.
+/// @details The forcing is not modified after it is read, so one copy is shared by all Climate objects that
+///          use the same files (see load()), e.g. patches of a landscape or members of an ensemble.
+///
+///          The met file starts with the time columns Year, Month, and optionally Day and Hour, followed by
+///          Temp [deg C], VPD [hPa], PPFD, PPFD_max [umol/m2/s] and |SWP| [MPa]. Records are placed at decimal
+///          years: monthly records at year + (month-1)/12, and daily or hourly records at
+///          year + (day of year - 1 + hour/24)/(days in year). Records need not be equally spaced (daily records are
+///          not, because of leap years), but lookup is fastest when they are (see prepare()).
+///
+///          The met file can be read in three ways (see MetMode):
+///          - MET_CSV: the CSV file is parsed into t_met and v_met.
+///          - MET_CACHE: as MET_CSV, but from a binary copy of the CSV file (`<metFile>.pfmet`), which is much faster
+///            to read. The binary copy is created on first use, and recreated when the CSV file changes.
+///          - MET_STREAM: the binary copy is memory-mapped, and records are read from it when needed, so that only the
+///            part of the series in use is held in memory. t_met and v_met stay empty in this mode;
+///            use n_met(), met_time() and met_record() to access the records.
+class ClimateForcing{
+	public:
+	enum MetMode {MET_CSV = 0, MET_CACHE = 1, MET_STREAM = 2};
+
+	std::string metFile;
+	std::string co2File;
+
+	std::vector<double> t_met;
+	std::vector<Clim>   v_met;
+	// Adding temp vector for soil water potential
+	std::vector<double> v_met_swp;
+
+	std::vector<int>    t_co2;
+	std::vector<double> v_co2;
+
+	double delta = 1.0/12;   // length of the met time series (it is cycled beyond this)
+
+	bool   uniform = false;  ///< true if the met records are equally spaced (set by prepare())
+	double dt_met = 0;       ///< interval between met records, if uniform
+
+	/// @brief Read the forcing from met_file and co2_file
+	void read(std::string met_file, std::string co2_file, int met_mode = MET_CSV);
+
+	/// @brief Number of met records
+	size_t n_met() const;
+
+	/// @brief Time of met record i
+	double met_time(size_t i) const;
+
+	/// @brief Met record i
+	Clim met_record(size_t i) const;
+
+	/// @brief Name of the binary copy of met_file
+	static std::string met_cache_file(std::string met_file);
+
+	/// @brief Set up constant-time lookup after the time series have been filled. Called by read().
+	void prepare();
+
+	/// @brief   Position of t in the met series, which is cycled with period delta
+	/// @param i index of the record at or before t
+	/// @param w fraction of the interval from record i to the next record (the first record after the last one)
+	void met_position(double t, int &i, double &w) const;
+
+	/// @brief  CO2 for the year of t, or the last value after the end of the series
+	/// @return false if t is before the start of the series
+	bool co2_at(double t, double &co2) const;
+
+	/// @brief Index of the last met record at or before t (not cycled), or -1 if t is before the first record
+	int met_index_before(double t) const;
+
+	/// @brief Returns the forcing in met_file and co2_file. The files are read again only if one of them has been 
+	///        modified (by modification time or size) since, or if no Climate still uses the forcing read before. Thread-safe.
+	static std::shared_ptr<const ClimateForcing> load(std::string met_file, std::string co2_file, int met_mode = MET_CSV);
+
+	private:
+	std::shared_ptr<io::MappedFile> met_map;   // binary copy of the met file, in MET_STREAM mode
+	const char * met_records = nullptr;        // first record in met_map
+	size_t n_records = 0;
+
+	void read_met_csv();
+	void read_co2_csv();
+	void update_met_cache();
+	void read_met_cache(bool stream);
+};
+
+
+// Layout of the binary copy of a met file: a header, followed by one record per line of the file
+struct MetCacheHeader{
+	char     magic[8];        // "PFMET01"
+	uint64_t n_records;
+	uint64_t csv_size;        // size and modification time of the CSV file it was created from
+	int64_t  csv_mtime;
+	uint64_t record_size;
+	uint64_t reserved;
+};
+
+struct MetCacheRecord{
+	double t, tc, vpd, ppfd, ppfd_max, swp;
+};
+
+
+inline size_t ClimateForcing::n_met() const {
+	return (met_records)? n_records : t_met.size();
+}
+
+inline double ClimateForcing::met_time(size_t i) const {
+	if (!met_records) return t_met[i];
+	double t;
+	std::memcpy(&t, met_records + i*sizeof(MetCacheRecord), sizeof(double));
+	return t;
+}
+
+inline Clim ClimateForcing::met_record(size_t i) const {
+	if (!met_records) return v_met[i];
+	MetCacheRecord r;
+	std::memcpy(&r, met_records + i*sizeof(MetCacheRecord), sizeof(MetCacheRecord));
+	Clim c;
+	c.tc = r.tc;
+	c.vpd = r.vpd;
+	c.ppfd = r.ppfd;
+	c.ppfd_max = r.ppfd_max;
+	c.swp = r.swp;
+	return c;
+}
+
+
 class Climate{
 	private:
 	double t_prev = 0;  // time at current data values (years since 2000-01-01)
 	double t_next = 0;  // next time in file for which data is available
 	Clim clim_prev;
 	Clim clim_next;
+
+	// Result of the last lookup, reused while updateClimate() is called with the same t
+	double t_cached = std::nan("");
+	bool   interpolate_cached = false;
+	std::shared_ptr<const ClimateForcing> forcing_cached;
+	Clim   met_cached;
+	bool   co2_known = false;
+	double co2_cached = 0;
    	double t0 = 2000.0;
 	double tf = 2001 + 11.0/12;
 	double t_base = 2000.0;
-	double delta = 1.0/12;
-
-	std::vector<int>    t_co2;
-	std::vector<double> v_co2;
-
-	//std::vector<double> t_met;
-	//std::vector<Clim>   v_met;
-	// Adding temp vector for soil water potential
-	//std::vector<double> v_met_swp;
 
 	public:
 	double t_now;
 	Clim clim;
-	std::vector<double> t_met;
-	std::vector<Clim>   v_met;
-	// Adding temp vector for soil water potential
-	std::vector<double> v_met_swp;
+	std::shared_ptr<const ClimateForcing> forcing;   ///< Forcing data, shared with other Climate objects that read the same files
 	int counter_var = 1;
 
 	std::string metFile = "";
 	std::string co2File = "";
-	bool interpolate = false;
+	int         met_mode = ClimateForcing::MET_CSV;  ///< How the met file is read (see ClimateForcing)
+	bool interpolate = false;   ///< Interpolate met data linearly between records (otherwise use the record at or before t)
 	
 	bool update_met = true;
 	bool update_co2 = true;
 
-	private:
-	std::ifstream fin_met;
-	std::ifstream fin_co2;
-
 	public:
-	
+	/// @brief Use the forcing in metFile and co2File. The files are read only if no other Climate has read them already.
 	int init();
+
+	/// @brief Use forcing data that has already been loaded
+	int init(std::shared_ptr<const ClimateForcing> _forcing);
 	
-	Clim interp(Clim &clim_prev, Clim &clim_next);
+	/// @brief Linear interpolation between two met records, w = 0 giving clim_prev
+	Clim interp(const Clim &clim_prev, const Clim &clim_next, double w);
 
 	int id(double t);
 	void updateClimate(double t);
 
-	int readNextLine_met(Clim &clim, double &t);
-	
 	int binarySearch(double k);
 	double inst_swp(double year);
-	
-	template<class T> 
-	T as(std::string s);
 
 	void print(double t);
 	void print_all();
@@ -86,15 +206,6 @@ class Climate{
 };
 
 
-template<class T> 
-T Climate::as(std::string s){
-	std::stringstream sin(s);
-	T data;
-	sin >> data;
-	return data;
-}
-
-
 } // namespace env
 
 
@@ -0,0 +1,58 @@
+#ifndef PLANT_FATE_ENV_COHORT_CACHE_H_
+#define PLANT_FATE_ENV_COHORT_CACHE_H_
+
+#include <vector>
+
+namespace env{
+
+/// @ingroup ppa_module
+/// @brief   Structure-of-arrays copy of the cohort properties needed by the PPA light environment
+///          and the community-level integrals.
+/// @details Plant objects are large, so reading a handful of geometry fields from each cohort in every 
+///          integral scatters memory accesses across the whole cohort vector. This cache gathers those 
+///          fields into contiguous columns once per environment update, and the integrals then read only 
+///          the columns they need. 
+///          Columns are stored per species. Cohort `i` of the solver is stored at position `col(i)`,
+///          so that the boundary cohort (i = -1) is also available to the solver's integration routines.
+class CohortGeometryCache {
+	public:
+	struct Columns {
+		bool resident = false;
+		std::vector<double> u;           ///< cohort density
+		std::vector<double> height;      ///< plant height
+		std::vector<double> crown_area;  ///< crown area
+		std::vector<double> lai;         ///< leaf area index
+		std::vector<double> zm;          ///< height of maximum crown radius
+		std::vector<double> qm;          ///< \f$q(z_m)\f$
+		std::vector<double> m, n;        ///< crown shape parameters
+		std::vector<double> fg;          ///< upper canopy gap fraction
+		std::vector<double> k_light;     ///< light extinction coefficient
+
+		/// Position of solver cohort `i` in the columns
+		static int col(int i){ return i+1; }
+
+		/// Resize all columns to hold `ncohorts` cohorts plus the boundary cohort
+		void resize(int ncohorts);
+		int size() const;
+
+		/// Same as plant::PlantGeometry::q()
+		double q(int j, double z) const;
+		/// Same as plant::PlantGeometry::crown_area_extent_projected()
+		double crown_area_extent_projected(int j, double z) const;
+		/// Same as plant::PlantGeometry::crown_area_above()
+		double crown_area_above(int j, double z) const;
+
+		/// Batched versions of the above for all cohorts in the columns, using the crown kernel (see crown_kernel.h)
+		void crown_area_extent_projected(double z, std::vector<double> &out) const;
+		void crown_area_above(double z, std::vector<double> &out) const;
+	};
+
+	std::vector<Columns> species;
+
+	void resize(int nspecies);
+};
+
+} // namespace env
+
+#endif
+
@@ -0,0 +1,123 @@
+#ifndef PLANT_FATE_COLUMNAR_IO_H_
+#define PLANT_FATE_COLUMNAR_IO_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+namespace io{
+
+/// @brief   Binary columnar output file (`.pfc`), an alternative to the tab-separated text output.
+/// @details Rows are buffered column-wise, and written in chunks of `chunk_rows` rows.
+///          Each column of a chunk is compressed separately:
+///          - FLOAT64 values are delta-encoded on their bit patterns (the difference from the previous value of 
+///            the column, as a zigzag-coded integer), so that slowly changing values give mostly zero high bytes. 
+///            The bytes are then grouped by significance (all 1st bytes, all 2nd bytes, ...) and entropy-coded 
+///            with an adaptive binary range coder. Each byte is coded in the context of its significance and of
+///            the magnitude of the same byte of the previous value. Models start afresh in every chunk.
+///          - FLOAT32 values are rounded to single precision (~7 significant digits, more than the 6 digits 
+///            of the text output), and compressed as FLOAT64.
+///          - INT32 values are delta-encoded (zigzag) and compressed the same way.
+///          - STRING values are stored as INT32 indices into a dictionary. New dictionary entries are
+///            written before the chunk that first uses them.
+///
+///          File layout (little-endian):
+///          \code
+///          "PFCOL002"  ncols:u32  { name_len:u16 name type:u8 } x ncols
+///          { 'D' col:u32 len:u32 string }    dictionary entry
+///          { 'C' nrows:u32 { nbytes:u32 bytes } x ncols }    chunk
+///          \endcode
+///          Files are self-describing and can be read with ColumnReader (or read_columnar() in R).
+///
+///          Size: on the cohort table of tests/columnar_io_test, files are ~5.4x smaller than the text output.
+///          The ratio depends on the data: single-precision mantissas of quantities that vary irregularly between 
+///          rows carry more information than 6 printed digits, and cannot be compressed much. The 5-10x targeted 
+///          for this format is therefore not met in general.
+class ColumnWriter{
+	public:
+	enum Type : uint8_t {FLOAT64 = 0, INT32 = 1, STRING = 2, FLOAT32 = 3};
+
+	int chunk_rows = 4096;
+
+	private:
+	std::ofstream fout;
+	std::vector<std::string> names;
+	std::vector<Type> types;
+
+	std::vector<std::vector<double>>  dbuf;   // buffers for FLOAT64 columns
+	std::vector<std::vector<float>>   fbuf;   // buffers for FLOAT32 columns
+	std::vector<std::vector<int32_t>> ibuf;   // buffers for INT32 and STRING columns
+	std::vector<std::map<std::string, int32_t>> dicts;
+	std::vector<std::pair<int, std::string>> new_dict_entries;
+
+	int icol = 0;     // column to be filled by the next value
+	int nrows = 0;    // rows in the current chunk
+
+	public:
+	ColumnWriter() = default;
+	ColumnWriter(const ColumnWriter&) = delete;
+	ColumnWriter& operator=(const ColumnWriter&) = delete;
+	~ColumnWriter();
+
+	/// @brief Open file and write the schema
+	void open(const std::string &file, const std::vector<std::pair<std::string, Type>> &schema);
+
+	/// @brief Open an existing file to continue it (e.g. when a run is resumed from a saved state). Rows whose first 
+	///        column is greater than `t_max` are dropped, and the others are written again, so that the file is chunked 
+	///        as if it had been written without interruption. If `file` does not exist, this is the same as open().
+	void reopen(const std::string &file, const std::vector<std::pair<std::string, Type>> &schema, double t_max);
+	bool is_open() const;
+
+	/// Append a value to the next column of the current row. Numeric values are converted to the column type.
+	ColumnWriter& operator << (double v);
+	ColumnWriter& operator << (int v);
+	ColumnWriter& operator << (const std::string &s);
+
+	/// Complete the current row. All columns must have been filled.
+	void end_row();
+
+	/// Write buffered rows as a chunk
+	void flush();
+
+	/// Flush and close the file
+	void close();
+
+	private:
+	void next_col();
+};
+
+
+/// @brief Reads a file written by ColumnWriter into memory.
+class ColumnReader{
+	public:
+	std::vector<std::string> names;
+	std::vector<ColumnWriter::Type> types;
+	std::vector<std::vector<double>>      numeric;  ///< Values of numeric columns (empty for STRING columns)
+	std::vector<std::vector<std::string>> strings;  ///< Values of STRING columns (empty for numeric columns)
+
+	/// @brief Read the entire file. Throws std::runtime_error if the file is not a valid columnar file.
+	void read(const std::string &file);
+
+	int  col_index(const std::string &name) const;
+	int  nrows() const;
+	const std::vector<double>& get_numeric(const std::string &name) const;
+	const std::vector<std::string>& get_string(const std::string &name) const;
+};
+
+
+// Compression used for the column chunks, exposed for testing
+namespace columnar{
+std::vector<uint8_t> encode_float64(const std::vector<double> &v);
+std::vector<double>  decode_float64(const std::vector<uint8_t> &b, int n);
+std::vector<uint8_t> encode_float32(const std::vector<float> &v);
+std::vector<float>   decode_float32(const std::vector<uint8_t> &b, int n);
+std::vector<uint8_t> encode_int32(const std::vector<int32_t> &v);
+std::vector<int32_t> decode_int32(const std::vector<uint8_t> &b, int n);
+} // namespace columnar
+
+} // namespace io
+
+#endif
+
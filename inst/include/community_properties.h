@@ -1,9 +1,18 @@
 #ifndef PLANT_FATE_COMMUNITY_PROPERTIES_H_
 #define PLANT_FATE_COMMUNITY_PROPERTIES_H_
 
+#include <array>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include "pspm_interface.h"
 #include "trait_evolution.h"
 #include "utils/sequence.h"
+#include "columnar_io.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358
@@ -16,7 +25,7 @@ double integrate_prop(double t, Solver &S, const Func &f){
 		bool is_resident = static_cast<MySpecies<PSPM_Plant>*>(S.species_vec[k])->isResident;
 		if (is_resident){
 			x += S.integrate_x([&S,k,f](int i, double t){
-					auto p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
+					auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
 					const PSPM_Plant * pp = &p;
 					return f(pp);
 				 }, t, k);
@@ -25,6 +34,73 @@ double integrate_prop(double t, Solver &S, const Func &f){
 	return x;
 }
 
+/// Same as integrate_prop(), but reads cohort properties from the cohort geometry cache. 
+/// `f` receives the columns of a species and the position of the cohort in them. 
+/// The cache must be up to date with the current cohorts (see PSPM_Dynamic_Environment::fill_cohort_cache()). 
+template<class Func>
+double integrate_prop_cached(double t, Solver &S, const env::CohortGeometryCache &cache, const Func &f){
+	double x = 0;
+	for (int k=0; k<S.n_species(); ++k){
+		auto& c = cache.species[k];
+		if (c.resident){
+			x += S.integrate_x([&c,&f](int i, double t){
+					return f(c, c.col(i));
+				 }, t, k);
+		}
+	}
+	return x;
+}
+
+
+/// @brief  Integrals of all cohort diagnostics of one species, as used by SpeciesProps and EmergentProps
+struct SpeciesIntegrals{
+	/// Quantities integrated over all sizes
+	enum {N_IND, CROWN_AREA, HEIGHT, GS, GPP, NPP, TRANS, RESP_AUTO, LAI, LEAF_MASS, STEM_MASS, CROOT_MASS, FROOT_MASS, TLEAF, TROOT, N_ALL};
+	/// Quantities integrated over sizes above CommunityIntegrals::x_above
+	enum {BIOMASS, BA, VCMAX, N_ABOVE};
+
+	bool resident = false;
+	bool fused = false;                 ///< Whether the integrals were computed in a single sweep (otherwise with the solver's integrals)
+	std::array<double, N_ALL> all{};
+	std::array<double, N_ABOVE> above{};
+	std::vector<double> lai_vert;       ///< Leaf area above heights 0, 1, 2, ... m
+};
+
+
+/// @brief   Integrals of cohort diagnostics for all species, computed in a single sweep over the cohorts of each species.
+/// @details Instead of one call to the solver's integrals per diagnostic (and per height for the LAI profile), 
+///          all diagnostics of a cohort are evaluated once and accumulated with the cohort density as weight, 
+///          as in the EBT family of methods. Species are swept in parallel using the environment's thread pool, if any.
+///
+///          Whether density weights reproduce the solver's integrals is checked per species with a heuristic: 
+///          the weighted sums of 1 and of crown area (over all sizes), and of 1 and of biomass (above x_above), 
+///          must match the solver's integrals of the same values. This catches solvers whose integrals are not
+///          of the form \f$\sum_i u_i f_i\f$ over all cohorts, but does not prove that the sums agree for every 
+///          quantity. If the check fails, that species falls back to one solver integral per quantity, 
+///          reusing the cohort values from the sweep.
+///
+///          Cohort properties are read from a copy of the cohort geometry cache owned by this object, so 
+///          computing diagnostics does not modify the environment.
+class CommunityIntegrals{
+	public:
+	double x_above = 0.1;     ///< Lower size limit for biomass, basal area, and vcmax
+	int    n_lai_vert = 25;   ///< Number of heights in the LAI profile
+	std::vector<SpeciesIntegrals> species;
+
+	void compute(double t, Solver &S);
+
+	private:
+	env::CohortGeometryCache cache;            // cohort properties, refreshed in every call to compute()
+	std::vector<std::vector<double>> values;   // values of all quantities for each cohort of each species, one row per cohort (see row())
+	std::vector<double> u_above;               // sum of densities of cohorts above x_above, per species
+
+	int     n_values() const;
+	double* row(int k, int i);
+	void sweep_fused(Solver &S, int k);
+	bool weights_match(double t, Solver &S, int k);
+	void sweep_solver(double t, Solver &S, int k);
+	void cohort_values(PSPM_Plant &p, const env::CohortGeometryCache::Columns &c, int j, double * all, double * above, double * lai_vert);
+};
 
 
 // FIXME: move definitions to cpp
@@ -57,6 +133,7 @@ public:
 	void resize(int n);
 	bool isResident(Species_Base * spp);
 	void update(double t, Solver &S);
+	void update(double t, Solver &S, const CommunityIntegrals &ci);
 	
 	SpeciesProps & operator /= (double s);
 	SpeciesProps & operator += (const SpeciesProps &s);
@@ -90,17 +167,50 @@ public:
 	bool isResident(Species_Base * spp);
 	
 	void update(double t, Solver &S);
+	void update(double t, Solver &S, const CommunityIntegrals &ci);
 
 };
 
 EmergentProps operator + (EmergentProps lhs, EmergentProps &rhs);
 
 
+/// @brief   Copy of all quantities written by SolverIO at one time step.
+/// @details Snapshots do not refer to the solver, so they can be written on a different thread while the simulation continues.
+struct OutputSnapshot{
+	struct Cohort{
+		double height, lai, mort, fec, rgr, gpp;
+	};
+
+	struct Species{
+		std::string name;
+		bool resident;
+		std::vector<double> traits;
+		std::vector<std::string> trait_names;
+		double r0_last, r0_avg, r0_exp;
+		double seeds;
+		std::vector<double> size_dist;  // only for residents
+		std::vector<Cohort> cohorts;    // only for residents
+	};
+
+	double t;
+	SpeciesProps cwm;
+	EmergentProps props;
+	std::vector<Species> species;
+	std::vector<double> z_star;
+	std::vector<double> canopy_openness;
+};
+
+
 class SolverIO{
 	public:
 	int nspecies;
 	Solver * S;
+	bool binary_output = false;   ///< Write binary columnar files (see io::ColumnWriter) instead of text files
+	bool async_output = false;    ///< Write output files on a background thread
+	int  queue_capacity = 16;     ///< Max snapshots waiting to be written in async mode. writeState() blocks when the queue is full.
 	std::vector<std::string> varnames = {"height", "lai", "mort", "fec", "rgr", "gpp"};
+	bool   resume_output = false;     ///< Continue existing output files instead of overwriting them (set when a run is resumed)
+	double resume_time = 0;           ///< Time of the resumed state. Rows after this time are dropped from continued files.
 
 	// std::vector <std::vector<std::ofstream>> streams;
 	std::ofstream cohort_props_out;
@@ -116,11 +226,49 @@ class SolverIO{
 	std::ofstream fouty_spp;
 	std::ofstream ftraits;
 
+	// Binary equivalents of the above streams, used if binary_output is true
+	io::ColumnWriter cohort_props_bin;
+	io::ColumnWriter size_dists_bin;
+	io::ColumnWriter zst_bin;
+	io::ColumnWriter co_bin;
+	io::ColumnWriter lai_bin;
+	io::ColumnWriter emg_bin;
+	io::ColumnWriter cwm_bin;
+	io::ColumnWriter cwm_spp_bin;
+	io::ColumnWriter traits_bin;     // opened on first write, when the number of traits is known
+	std::string traits_bin_file;
+
 	void openStreams(std::string dir, io::Initializer &I);
 
 	void closeStreams();
 
 	void writeState(double t, SpeciesProps& cwm, EmergentProps& props);
+
+	OutputSnapshot snapshot(double t, const SpeciesProps& cwm, const EmergentProps& props);
+	void write(const OutputSnapshot &o);
+
+	// Header and rows of the emergent properties (emgProps) and community-weighted mean (cwmAvg) text files
+	static const std::string emergent_props_header;
+	static const std::string cwm_header;
+	static void write_emergent_props(std::ostream &fout, double t, const SpeciesProps &cwm, const EmergentProps &props);
+	static void write_cwm(std::ostream &fout, double t, const SpeciesProps &cwm);
+
+	private:
+	std::thread writer;
+	std::mutex queue_mtx;
+	std::condition_variable cv_not_empty, cv_not_full;
+	std::deque<std::shared_ptr<const OutputSnapshot>> queue;
+	bool writer_stop = false;
+	std::exception_ptr writer_error;
+
+	void start_writer();
+	void stop_writer();
+
+	void openStreams_binary(std::string dir, io::Initializer &I);
+	bool open_text(std::ofstream &fout, const std::string &file);
+	void open_binary(io::ColumnWriter &fout, const std::string &file, const std::vector<std::pair<std::string, io::ColumnWriter::Type>> &schema);
+	void write_text(const OutputSnapshot &o);
+	void write_binary(const OutputSnapshot &o);
 };
 
 
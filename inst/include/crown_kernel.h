@@ -0,0 +1,38 @@
+#ifndef PLANT_FATE_ENV_CROWN_KERNEL_H_
+#define PLANT_FATE_ENV_CROWN_KERNEL_H_
+
+namespace env{
+
+/// @ingroup ppa_module
+/// @brief   Batched evaluation of the crown shape over arrays of cohorts at a single height.
+/// @details These kernels compute the same quantities as plant::PlantGeometry::q(), crown_area_above() and
+///          crown_area_extent_projected(), but for many cohorts at once. When compiled with AVX2 support 
+///          (e.g. `-mavx2 -mfma`), 4 cohorts are evaluated per instruction, with \f$x^y\f$ replaced by fast_pow().
+///          Otherwise, a scalar loop with `std::pow` is used.
+///          The crown shape is not evaluated for cohorts whose crown is full at z (\f$z < z_m\f$) and has no gaps.
+///
+///          Error bound: fast_pow(x,y) has a relative error below \f$10^{-12}(1 + |y \log_2 x|)\f$
+///          for \f$x \in [2^{-1022}, 2^{1023}]\f$. With the crown shape exponents used in Plant-FATE (m, n < 10),
+///          this gives a relative error in the crown area below \f$10^{-10}\f$ (checked by tests/crown_kernel_bench.cpp).
+namespace crown_kernel{
+
+/// Returns true if the batched kernels use AVX2 instructions
+bool simd_enabled();
+
+/// @brief Fast approximation of \f$x^y\f$ for \f$x \ge 0\f$, computed as \f$2^{y\log_2 x}\f$ with polynomial
+///        approximations for \f$\log_2\f$ and \f$2^x\f$. Returns 0 for x = 0. Does not handle x < 0, NaN or infinities.
+double fast_pow(double x, double y);
+
+/// @brief     Crown area above z of N cohorts, \f$A_c (1 - f_g (q/q_m)^2)\f$ below \f$z_m\f$, and \f$A_c (1-f_g)(q/q_m)^2\f$ above it.
+/// @param fg  Gap fractions. If nullptr, gaps are ignored, and the result is the projected crown extent
+///            (as in plant::PlantGeometry::crown_area_extent_projected())
+/// @param out Array of size N to write the results to
+void crown_area_above(int N, double z, const double * height, const double * crown_area, const double * zm,
+                      const double * qm, const double * m, const double * n, const double * fg, double * out);
+
+} // namespace crown_kernel
+
+} // namespace env
+
+#endif
+
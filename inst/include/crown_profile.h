@@ -0,0 +1,59 @@
+#ifndef PLANT_FATE_ENV_CROWN_PROFILE_H_
+#define PLANT_FATE_ENV_CROWN_PROFILE_H_
+
+#include <vector>
+
+namespace env{
+
+/// @ingroup ppa_module
+/// @brief   Cumulative projected crown area profile of the community,
+///          used to read off the PPA layer heights \f$z^*\f$ in a single sweep.
+/// @details Each crown contributes \f$w A_c\f$ below its \f$z_m\f$, \f$w A_c (q(z)/q_m)^2\f$ between \f$z_m\f$ and
+///          its height \f$H\f$, and nothing above \f$H\f$, where \f$w\f$ is the quadrature weight of the cohort.
+///          Crowns are sorted once by their breakpoints (\f$z_m\f$, \f$H\f$), so that the total area above any z
+///          can be evaluated from a prefix sum plus the (few) crowns whose tapering region contains z.
+///          The layer heights are then bracketed between consecutive breakpoints, where the profile is smooth,
+///          and refined using only the crowns active in that bracket.
+class CrownAreaProfile {
+	private:
+	struct Crown{
+		double wca;      ///< weighted crown area, \f$w A_c\f$
+		double height;   ///< crown top
+		double zm;       ///< height of maximum crown radius
+		double m, n;     ///< crown shape parameters
+		double qm;       ///< \f$q(z_m)\f$
+	};
+
+	std::vector<Crown>  crowns;         // sorted by height, tallest first
+	std::vector<double> zm_desc;        // z_m of all crowns, in decreasing order
+	std::vector<double> wca_cumm;       // wca_cumm[j] = sum of wca over the j crowns with the largest z_m
+	std::vector<double> breaks;         // unique breakpoints (0, all z_m and H) in increasing order
+	double zm_H_min = 1;                // smallest z_m/H across crowns, bounds the search for tapering crowns
+
+	public:
+	/// Remove all crowns
+	void clear();
+
+	/// Add a crown with quadrature weight `w`
+	void add_crown(double w, double crown_area, double height, double zm, double m, double n, double qm);
+
+	/// Sort breakpoints and build the cumulative profile. Must be called after all crowns are added.
+	void build();
+
+	/// Total projected crown area above z
+	double area_above(double z) const;
+
+	/// Total projected crown area (at z = 0)
+	double total() const;
+
+	/// @brief Heights at which the area above z equals `layer*fG`, for layer = 1...n_layers
+	std::vector<double> solve_z_star(int n_layers, double fG, double tol = 1e-10) const;
+
+	private:
+	double crown_shape_area(const Crown &c, double z) const;
+};
+
+} // namespace env
+
+#endif
+
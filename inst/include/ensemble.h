@@ -0,0 +1,61 @@
+#ifndef PLANT_FATE_ENSEMBLE_H_
+#define PLANT_FATE_ENSEMBLE_H_
+
+#include <vector>
+#include <map>
+#include <string>
+
+#include "plantfate.h"
+
+/// @brief   Runs an ensemble of simulations that differ in some parameters of a base parameter file.
+/// @details Each member is defined by a name and a set of overrides (parameter name -> value) of the base file.
+///          The base file with the overrides applied is written to `<outDir>/<exptName>/<name>.ini`, and the
+///          member writes its output to `<outDir>/<exptName>/<name>`. Members run concurrently, one per thread,
+///          on up to `n_threads` threads.
+///
+///          Each running member owns a full Simulator (solver, cohorts, output buffers), so memory use grows with 
+///          the number of threads. Only the climate forcing is shared: members that use the same climate files 
+///          share one copy of it (see env::ClimateForcing::load()).
+///
+///          Members run on threads of one process, rather than in separate worker processes. They therefore share
+///          process-wide state: the profiler counters (see prof::Profiler) and the cache of parsed parameter files
+///          (see plant::Plant::params_prototype()). Profiles of an ensemble run cover all members together.
+class EnsembleRunner{
+	public:
+	struct Member{
+		std::string name;
+		std::map<std::string, std::string> overrides;
+		std::string error;   ///< Error message if the member failed, empty otherwise
+	};
+
+	std::string paramsFile;
+	std::string parent_dir, expt_dir;
+	int         n_threads;   ///< Number of members run concurrently
+
+	std::vector<Member> members;
+
+	public:
+	EnsembleRunner(std::string params_file);
+
+	/// @brief Add a member that overrides the parameters `names` with `values`
+	void add_member(std::string name, std::vector<std::string> names, std::vector<std::string> values);
+
+	/// @brief   Add members listed in a table.
+	/// @details The first row is a header: `name` followed by the names of the parameters to override.
+	///          Each following row gives the member name and its values for these parameters.
+	///          Lines starting with "#" are ignored.
+	void read_members(std::string file);
+
+	/// @brief  Simulate all members from tstart to tend
+	/// @return Number of members that failed. Failed members do not stop the others; see Member::error.
+	int run(double tstart, double tend);
+
+	/// @brief Error messages of all members (empty for members that succeeded)
+	std::vector<std::string> get_errors();
+
+	private:
+	void write_params(const Member &m, std::string file);
+	std::shared_ptr<const env::ClimateForcing> run_member(Member &m, double tstart, double tend);
+};
+
+#endif
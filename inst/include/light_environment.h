@@ -4,6 +4,8 @@
 #include <iostream>
 #include <vector>
 
+#include "crown_profile.h"
+
 namespace env{
 
 class LightEnvironment {
@@ -18,7 +20,12 @@ class LightEnvironment {
 	std::vector<double> z_star;
 	std::vector<double> fapar_tot;
 	std::vector<double> canopy_openness;
-	
+
+	bool use_crown_profile = true;   ///< Read z* off the cumulative crown area profile (false: root-find on the crown area integral for each layer)
+	bool use_fused_fapar = true;     ///< Accumulate fapar of all layers in a single pass over cohorts (false: integrate over cohorts separately for each layer)
+	bool use_crown_kernel = false;   ///< Evaluate crown areas in batches over cohorts with the (vectorized) crown kernel
+	double z_star_tol = 1e-4;        ///< Tolerance [m] of root-finding for z* (used if use_crown_profile is false, or if the profile cannot be used)
+	CrownAreaProfile crown_profile;
 	
 	public:
 	LightEnvironment();
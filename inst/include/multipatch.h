@@ -0,0 +1,59 @@
+#ifndef PLANT_FATE_MULTIPATCH_H_
+#define PLANT_FATE_MULTIPATCH_H_
+
+#include <vector>
+#include <memory>
+#include <fstream>
+
+#include "plantfate.h"
+#include "utils/thread_pool.h"
+
+/// @brief   Simulates a landscape of independent patches that differ only in their disturbance histories.
+/// @details The parameter file is parsed once, and all patches share one copy of the climate forcing
+///          (see env::ClimateForcing::load()). Patches are advanced together in intervals of delta_T,
+///          each patch on one thread, using up to `n_threads` threads.
+///          Patch i draws its disturbance times from random seed `randomSeed + i`, so that results do not depend
+///          on the number of threads. Each patch writes its own output to `<outDir>/<exptName>/patch_<i>`,
+///          and the landscape averages of the community properties are written to the `emgProps` and `cwmAvg`
+///          files in `<outDir>/<exptName>`.
+class MultiPatchSimulator{
+	public:
+	std::string paramsFile;
+	std::string parent_dir, expt_dir;
+
+	int      n_patches;
+	int      n_threads;
+	unsigned seed;
+
+	double y0;
+	double yf;
+	double delta_T;
+
+	std::vector<std::unique_ptr<Simulator>> patches;
+
+	SpeciesProps  cwm;     ///< landscape average of community weighted means
+	EmergentProps props;   ///< landscape average of emergent properties
+
+	private:
+	io::Initializer I;
+	std::unique_ptr<ThreadPool> pool;
+	std::ofstream   foutd, fouty;
+
+	public:
+	MultiPatchSimulator(std::string params_file);
+
+	void init(double tstart, double tend);
+
+	/// @brief Simulate all patches from y0 to yf, in steps of delta_T
+	void simulate();
+
+	/// @brief Advance all patches to time t, and write the landscape averages
+	void step_to(double t);
+
+	void close();
+
+	private:
+	void average_patches();
+};
+
+#endif
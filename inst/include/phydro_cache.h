@@ -0,0 +1,110 @@
+#ifndef PLANT_FATE_PLANT_PHYDRO_CACHE_H_
+#define PLANT_FATE_PLANT_PHYDRO_CACHE_H_
+
+#include <array>
+#include <vector>
+#include <mutex>
+#include <phydro.h>
+
+#include "plant_params.h"
+
+namespace plant{
+
+/// @brief   Interpolation table for leaf assimilation, shared by all cohorts of a species.
+/// @ingroup physiology
+/// @details Within a species and a climate snapshot, Phydro inputs differ between cohorts only in the 
+///          light level at the top of the crown (\f$I_0\f$) and in fapar. This cache tabulates Phydro over 
+///          these two inputs, and returns linear interpolates between the table nodes. Nodes are computed 
+///          lazily, when a cohort first falls into a neighbouring cell.
+///
+///          If Phydro depends on \f$I_0\f$ and fapar only through the absorbed light \f$I_{abs} = I_0 f_{apar}\f$, 
+///          the table is 1D in \f$I_{abs}\f$, otherwise it is a 2D \f$(I_0, f_{apar})\f$ grid. This is tested 
+///          (to within `tol`) every time the table is reset. Light nodes are spaced uniformly in 
+///          \f$\sqrt{I/I_{max}}\f$, where \f$I_{max}\f$ is the maximum PPFD in the climate, so that they are 
+///          denser at low light, where the light response is most curved. 
+///
+///          Error control: when a cell is first used, Phydro is also called at the cell centre, where the 
+///          linear interpolation error of a smooth function is largest. If any of the interpolated outputs 
+///          differs from the exact value by more than `tol` (relative to the largest magnitude of that output
+///          in the cell), the cell is marked as exact, and queries falling into it call Phydro directly. 
+///          Queries outside the table also call Phydro directly.
+///
+///          The table is discarded whenever any other Phydro input (climate, photosynthesis parameters, or 
+///          hydraulic traits) changes. With daily or hourly forcing, this happens at every record, so the 
+///          table is rarely reused. Only the outputs used by the Assimilator (a, e, gs, vcmax, vcmax25, 
+///          dpsi, mc) are interpolated, the remaining ones are taken from the nearest node.
+///          Note that finite-difference derivatives of the interpolated outputs are piecewise constant.
+///
+///          get() is thread-safe. Phydro is called without holding the lock, and results are added to 
+///          the table afterwards, so threads do not wait for each other's table fills. Tabulated values do not depend on the order of queries, so results are
+///          identical in serial and parallel runs (only the diagnostic counters may differ).
+class PhydroCache{
+	public:
+	typedef std::array<double, 13> Key;
+
+	private:
+	double tol;
+	int nI, nf;           // number of nodes along light and fapar (nf = 1 for the 1D table)
+	int nf_2d;            // number of nodes along fapar in the 2D table
+	double I_max;         // light at the last node
+
+	Key key;
+	bool key_valid = false;
+	bool iabs_only = false;
+
+	std::vector<phydro::PHydroResult> nodes;
+	std::vector<char> node_ok;
+	std::vector<char> cell_state;  // CELL_UNCHECKED, CELL_INTERP, or CELL_EXACT
+
+	enum {CELL_UNCHECKED = 0, CELL_INTERP = 1, CELL_EXACT = 2};
+
+	static const std::array<double phydro::PHydroResult::*, 7> interpolated_fields;
+
+	std::mutex mtx;       // guards the table. Phydro is called without holding it
+	long generation = 0;  // incremented when the table is reset
+
+	public:
+	// ~~ Counters for diagnostics
+	long n_queries = 0;       ///< Number of calls to get()
+	long n_phydro_calls = 0;  ///< Number of calls to Phydro made by the cache (nodes, error checks, and exact fallbacks)
+	long n_resets = 0;        ///< Number of times the table was discarded
+
+	public:
+	/// @param tol  Relative error tolerance for interpolation
+	/// @param nI   Number of nodes along light
+	/// @param nf   Number of nodes along fapar (used only if Phydro does not depend on light through \f$I_{abs}\f$ alone)
+	PhydroCache(double tol, int nI = 65, int nf = 21);
+
+	/// @brief Leaf assimilation at (I0, fapar), from the table if possible, or from `exact(I0, fapar)`
+	template<class _Climate, class Func>
+	phydro::PHydroResult get(double I0, double fapar, _Climate &clim, PlantParameters &par, PlantTraits &traits, Func exact);
+
+	/// Discard all tabulated values
+	void clear();
+
+	/// Whether the current table is 1D in absorbed light
+	bool is_1d() const;
+
+	/// Print call counts
+	void print_stats();
+
+	private:
+	void reset(const Key &k, double _I_max, bool _iabs_only);
+
+	bool results_match(const phydro::PHydroResult &r1, const phydro::PHydroResult &r2) const;
+
+	double light_at(int i) const;
+	double node_light(int id) const;
+	double node_fapar(int id) const;
+
+	void check_cell(int i, int j, const phydro::PHydroResult &mid_exact);
+
+	phydro::PHydroResult interpolate(int i, int j, double wi, double wf);
+};
+
+} // namespace plant
+
+#include "phydro_cache.tpp"
+
+#endif
+
@@ -1,6 +1,7 @@
 #ifndef PLANT_FATE_PLANT_PLANT_H_
 #define PLANT_FATE_PLANT_PLANT_H_
 #include <fstream>
+#include <memory>
 #include "plant_params.h"
 #include "plant_geometry.h"
 #include "assimilation.h"
@@ -48,6 +49,8 @@ class Plant{
 	/// @brief Result of whole-plant assimilation calculation, returned by Assimilator::calc_plant_assimilation_rate()
 	PlantAssimilationResult res;
 
+	int traits_revision = 0;  ///< Incremented whenever traits are (re)coordinated, so that results computed with old traits can be detected
+
 	public:
 	//std::ofstream fmuh; // Cannot use streams here because we need copy-constructor for Plants, which in turn would need a copy constructor for streams, which is deleted.
 	PlantTraits traits;   ///< Collection of all functional traits
@@ -58,9 +61,27 @@ class Plant{
 	
 	public:
 
-	/// @brief  This function initializes the plant (traits, par, and geometry) from ini file
+	/// @brief   This function initializes the plant (traits, par, and geometry) from ini file
+	/// @details Parameters and traits are copied from the cached prototype for this file (see params_prototype()),
+	///          so the file is parsed only once, however many species or cohorts are initialized from it.
 	void initParamsFromFile(std::string file);
 
+	/// @brief   Parameters and traits read from an ini file, shared by all plants initialized from that file.
+	struct ParamsPrototype{
+		PlantParameters par;
+		PlantTraits traits;
+	};
+
+	/// @brief   Returns the parameters and traits in `file`. The file is parsed on the first call, and again only
+	///          if it has changed since. Prototypes are keyed by canonical path; a file whose size and modification
+	///          time are unchanged is not read again, unless it was modified within the timestamp resolution of
+	///          its last read, in which case its contents are hashed to check for a rewrite. Thread-safe.
+	static std::shared_ptr<const ParamsPrototype> params_prototype(std::string file);
+
+	/// @brief   Remove the prototype of `file` from the cache, or all prototypes if `file` is empty. 
+	///          Prototypes are otherwise kept for the lifetime of the process.
+	static void clear_params_cache(std::string file = "");
+
 	
 	/// @brief Set traits that are calculated from other traits (e.g., leaf_p50, a, c)
 	void coordinateTraits();
@@ -85,6 +106,10 @@ class Plant{
 	template<class Env>
 	double lai_model(PlantAssimilationResult& res, double _dmass_dt_tot, Env &env);
 
+	/// @brief Derivatives of gpp, npp, and transpiration with respect to LAI, per unit crown area
+	template<class Env>
+	PlantAssimilationResult lai_derivatives(PlantAssimilationResult& res, Env &env, int method);
+
 
 	/// @brief  Partition total biomass dm_dt_tot into various carbon pools
 	/// @param dm_dt_tot  Total biomass to partition
@@ -114,6 +139,9 @@ class Plant{
 	template<class Env>
 	double p_survival_germination(Env &env);
 
+	/// @brief  Probability of survival during germination, from the result of net_production() for the current state and environment
+	double p_survival_germination_from_result(const PlantAssimilationResult &res);
+
 	/// @brief  Probability of survival during dispersal
 	template<class Env>
 	double p_survival_dispersal(Env &env);
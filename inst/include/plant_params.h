@@ -2,6 +2,7 @@
 #define PLANT_FATE_PLANT_PARAMS_H_
 
 #include "utils/initializer.h"
+#include "utils/binary_io.h"
 #include <cmath>
 #include <string>
 #include <io_utils.h>
@@ -39,7 +40,11 @@ class PlantTraits{
 	inline void initFromFile(std::string fname){
 		io::Initializer I(fname);
 		I.readFile();
+		initFromInitializer(I);
+	}
 
+	/// @brief Read traits from an already parsed parameter file
+	inline void initFromInitializer(io::Initializer &I){
 		lma = I.getScalar("lma");
 		zeta = I.getScalar("zeta");
 		fcr = I.getScalar("fcr");
@@ -109,6 +114,22 @@ class PlantTraits{
 			>> b_xylem;
 	}
 
+	void save(io::BinaryWriter &fout){
+		fout.write(std::string("Traits::v1"));
+		fout.write(species_name);
+		fout.write(std::vector<double>{lma, zeta, fcr, hmat, fhmat, seed_mass, wood_density, p50_xylem, K_leaf, K_xylem, b_leaf, b_xylem});
+	}
+
+	void restore(io::BinaryReader &fin){
+		if (fin.get<std::string>() != "Traits::v1") throw std::runtime_error("Traits: unsupported binary version");
+		fin.read(species_name);
+		std::vector<double> v;
+		fin.read(v);
+		if (v.size() != 12) throw std::runtime_error("Traits: wrong number of traits in binary state");
+		int i=0;
+		for (double* x : {&lma, &zeta, &fcr, &hmat, &fhmat, &seed_mass, &wood_density, &p50_xylem, &K_leaf, &K_xylem, &b_leaf, &b_xylem}) *x = v[i++];
+	}
+
 	void print(){
 		std::cout << "Traits:\n";
 		std::cout << "   lma          = " << lma          << '\n';
@@ -138,6 +159,7 @@ class PlantParameters{
 	double kphio;           ///< Quantum use efficiency
 	double alpha;           ///< Cost of maintaining photosynthetic capacity
 	double gamma;           ///< Cost of hydraulic risks
+	double phydro_cache_tol = 0; ///< Relative error tolerance for interpolating Phydro outputs within a species (0 = always call Phydro)
 
 	// **
 	// ** Allocation and geometric paramaters  
@@ -153,6 +175,7 @@ class PlantParameters{
 	double response_intensity;	///< speed of response to environment
 	double max_alloc_lai;       ///< max fraction of NPP that can be allocated to LAI increment
 	double dl;	                ///< stepsize for profit derivative
+	int    lai_deriv_method = 0;    ///< Method for derivatives of profit wrt LAI: 0 = finite difference, 1 = finite difference reusing canopy openness (both make a second Phydro call)
 	double lai0;                ///< initial lai
 	bool   optimize_lai;
 
@@ -220,11 +243,17 @@ class PlantParameters{
 		io::Initializer I(fname);
 		I.readFile();
 		//I.print();
+		initFromInitializer(I);
+	}
+
+	/// @brief Read parameters from an already parsed parameter file
+	inline void initFromInitializer(io::Initializer &I){
 		
 //		#define GET(x) x = I.getScalar(#_x);
 		kphio = I.getScalar("kphio");
 		alpha = I.getScalar("alpha");
 		gamma = I.getScalar("gamma");
+		phydro_cache_tol = I.getScalarOrDefault("phydro_cache_tol", 0);
 		m = I.getScalar("m");
 		n = I.getScalar("n");
 		fg = I.getScalar("fg");
@@ -236,6 +265,7 @@ class PlantParameters{
 		response_intensity  = I.getScalar("response_intensity");
 		max_alloc_lai  = I.getScalar("max_alloc_lai");
 		dl  = I.getScalar("lai_deriv_step");
+		lai_deriv_method = I.getScalarOrDefault("lai_deriv_method", 0);
 		lai0  = I.getScalar("lai0");
 		optimize_lai = (I.getScalar("optimize_lai") == 1) ? true:false;
 
@@ -7,6 +7,7 @@
 #include <cmath>
 #include <numeric>
 #include <functional>
+#include <random>
 
 #include <solver.h>
 #include "pspm_interface.h"
@@ -27,13 +28,16 @@ class Simulator{
 	std::string co2_file;
 
 	bool        save_state;
+	bool        binary_state;     ///< Save state as a binary checkpoint (see saveState())
 	std::string state_outfile;
 	std::string config_outfile;
 
-	std::string continueFrom_stateFile;
+	std::string continueFrom_stateFile;   // "latest" resumes from the newest checkpoint in the output directory
 	std::string continueFrom_configFile;
 	bool        continuePrevious;
 
+	Checkpointer checkpoints;
+
 	bool        evolve_traits;
 
 	// Set up simulation start and end points
@@ -41,12 +45,14 @@ class Simulator{
 	double      yf;
 	double      ye;  // year in which trait evolution starts (need to allow this period because r0 is averaged over previous time)
 
-	double t_clear = 105000;
+	double t_clear = 105000;   // time of next disturbance (patch clearing)
 	// t is years since 2000-01-01
 	double delta_T;
 	double timestep;
 
 	std::string solver_method;
+	int         n_threads;   // threads used to compute cohort rates (1 = serial)
+	bool        verbose = true;   ///< Print the time and number of cohorts of each species at every step. Turned off by drivers that step simulators on several threads.
 
 	io::Initializer          I;
 	Solver                   S;
@@ -55,17 +61,39 @@ class Simulator{
 	SolverIO      sio;
 	SpeciesProps  cwm;
 	EmergentProps props; 
+	CommunityIntegrals integrals;
+
+	prof::ProfileWriter profile;   ///< Per-year timings of model phases, written only if compiled with PLANTFATE_PROFILE
+
+	private:
+	std::mt19937 rng;   // random numbers for disturbances
 
 	public:
 	Simulator(std::string params_file);
+
+	/// @brief Create a simulator from an already parsed parameter file
+	Simulator(const io::Initializer &config, std::string params_file);
 	
 	void init(double tstart, double tend);
 
+	/// @brief Simulate from y0 to yf, in steps of delta_T
 	void simulate();
 
+	/// @brief Advance the simulation to time t, update community properties, and write output
+	/// @details When continuing a previous run, output files are continued from the restored time (see SolverIO::resume_output),
+	///          and the step to y0 is skipped, because it was completed before the state was saved.
+	void step_to(double t);
+
 	void close();
 
+	/// @brief Reseed the disturbance random number generator, which is otherwise seeded from `randomSeed`
+	void set_random_seed(unsigned seed);
+
+	/// @brief Draw the time of the next disturbance after t, with return interval `T_return`
+	void draw_next_disturbance(double t);
+
 	private: 
+	void configure();
 	double runif(double rmin=0, double rmax=1);
 
 	/// @brief     Calculate seed output of all species
@@ -1,8 +1,12 @@
 #ifndef PLANT_FATE_PSPM_INTERFACE_H_
 #define PLANT_FATE_PSPM_INTERFACE_H_
 
+#include <memory>
 #include <solver.h>
+#include "utils/thread_pool.h"
+#include "utils/profiler.h"
 #include "light_environment.h"
+#include "cohort_cache.h"
 #include "climate.h"
 #include "plant.h"
 
@@ -26,9 +30,15 @@ class PSPM_Plant : public plant::Plant {
 
 	std::vector<std::string> statevarnames = {"lai", "mort"};  // header corresponding to state output (not used currently)
 
+	// Call counters, incremented only if compiled with PLANTFATE_PROFILE (see utils/profiler.h)
 	int nrc = 0; // number of evals of compute_vars_phys() - derivative computations actually done by plant
 	int ndc = 0; // number of evals of mortality_rate() - derivative computations requested by solver
-	int nbc = 0;
+	int nbc = 0; // number of evals of birthRate()
+
+	// Environment update, size, LAI and traits revision at the last preCompute(), for which `res` is valid (see establishmentProbability())
+	long   rates_env_update = -1;
+	double rates_x = 0, rates_lai = 0;
+	int    rates_traits_revision = -1;
 
 	PSPM_Plant(); 
 
@@ -67,9 +77,29 @@ class PSPM_Plant : public plant::Plant {
 /// @ingroup  libpspm_interface
 /// @brief    Environment class for interfacing with the PSPM Solver
 class PSPM_Dynamic_Environment : public EnvironmentBase, public env::LightEnvironment, public env::Climate{
+	private:
+	std::vector<double> crown_area_buffer;  // scratch space for batched crown area evaluations
+	std::vector<double> crown_area_top_buffer, absorption_buffer;  // scratch space for fapar_all_layers() with the crown kernel
+	std::vector<std::vector<int>> profile_cols;  // cache columns of the cohorts visited by the solver's integral, per species (see build_crown_profile())
+	std::shared_ptr<ThreadPool> thread_pool;
+
 	public:
+	env::CohortGeometryCache cohort_cache;  ///< Contiguous copy of cohort properties, refreshed in every call to computeEnv()
+	int precompute_chunk_size = 4;          ///< Number of cohorts per task in precompute_all_cohorts()
+	long n_env_updates = 0;                 ///< Number of calls to computeEnv(), used to detect results computed in an older environment
+	long n_crown_profile_fallbacks = 0;     ///< Number of calls to computeEnv() in which the crown area profile did not match the solver's integral (only the first is reported)
+
+	void   set_n_threads(int n);
+	int    get_n_threads();
+	ThreadPool * get_thread_pool();
+	void   precompute_all_cohorts(double t, Solver *S);
+
+	void   refresh_cohort_cache(Solver *S);
+	static void fill_cohort_cache(Solver *S, env::CohortGeometryCache &cache);
 	double projected_crown_area_above_z(double t, double z, Solver *S);
+	void   build_crown_profile(double t, Solver *S);
 	double fapar_layer(double t, int layer, Solver *S);
+	void   fapar_all_layers(double t, Solver *S);
 	void computeEnv(double t, Solver *S, std::vector<double>::iterator _S, std::vector<double>::iterator _dSdt);
 	void print(double t);
 };
@@ -3,14 +3,75 @@
 
 #include <fstream>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <exception>
 
 #include <utils/initializer.h>
 #include "trait_evolution.h"
 #include "pspm_interface.h"
 
-void saveState(Solver * S, std::string state_outfile, std::string config_outfile, std::string params_file);
+/// @brief  Save the solver state and a copy of the parameter file. 
+/// @param binary  If true, write a binary checkpoint instead of text. Binary checkpoints restore exactly, 
+///                and sections are checksummed.
+void saveState(Solver * S, std::string state_outfile, std::string config_outfile, std::string params_file, bool binary = false);
+
+/// @brief  Restore a state saved by saveState(). Text and binary files are detected automatically.
 void restoreState(Solver * S, std::string state_infile, std::string config_infile);
 
+/// @brief  Returns the contents of the state file that saveState() would write.
+std::string serializeState(Solver * S, bool binary = false);
+
+
+/// @brief   Periodic checkpoints of the solver state during a run.
+/// @details A checkpoint is taken when `interval_years` of simulated time or `interval_seconds` of wall-clock 
+///          time have passed since the last one (a value of 0 disables that criterion). The state is serialized 
+///          in memory on the calling thread, and written to disk on a background thread, so the simulation 
+///          continues while the file is written. 
+///
+///          Each checkpoint consists of `ckpt_<t>.state` and `ckpt_<t>.ini` (a copy of the parameter file) 
+///          in `dir`. Both are written to temporary files and renamed, so a checkpoint file is either 
+///          complete or absent. Only the newest `keep` checkpoints are retained.
+class Checkpointer{
+	public:
+	std::string dir;
+	std::string params_file;
+	bool   binary = false;
+	double interval_years = 0;
+	double interval_seconds = 0;
+	int    keep = 3;
+
+	private:
+	double t_last;
+	std::chrono::steady_clock::time_point wall_last;
+	std::thread writer;
+	std::exception_ptr writer_error;
+
+	public:
+	Checkpointer() = default;
+	Checkpointer(const Checkpointer&) = delete;
+	Checkpointer& operator=(const Checkpointer&) = delete;
+	~Checkpointer();
+
+	bool enabled() const;
+
+	/// @brief Start counting intervals from time t
+	void start(double t);
+
+	/// @brief Returns true if a checkpoint is due at time t
+	bool due(double t) const;
+
+	/// @brief Take a checkpoint at time t. Waits for the previous checkpoint to be written, if necessary.
+	void save(double t, Solver * S);
+
+	/// @brief Wait until all checkpoints have been written. Rethrows errors that occurred while writing.
+	void wait();
+
+	/// @brief  Find the newest complete checkpoint in dir. 
+	/// @return false if there is none
+	static bool find_latest(std::string dir, std::string &state_file, std::string &config_file);
+};
+
 
 #endif
 
@@ -44,6 +44,19 @@ class MySpecies : public Species<Model>{
 
 	public: 
 	/*NO_SAVE_RESTORE*/ std::string configfile_for_restore = "";  // Dont output this variable in save/restore. This is set by restoreState() to provide the saved config file for recreating cohorts  
+	/*NO_SAVE_RESTORE*/ bool binary_state = false;                // If true, save() writes species-level data and cohorts to a separate binary record (see saveState() with binary format)
+	/*NO_SAVE_RESTORE*/ std::string binary_state_for_restore = "";  // Binary record of species-level data and cohorts, set by restoreState() for binary checkpoints
+
+	private:
+	/*NO_SAVE_RESTORE*/ bool   precomputed = false;    // Whether cohort rates have already been computed at t_precomputed (e.g., in parallel by the environment)
+	/*NO_SAVE_RESTORE*/ double t_precomputed = 0;
+	/*NO_SAVE_RESTORE*/ std::vector<double> precomputed_inputs;  // Cohort states from which the precomputed rates were calculated
+	/*NO_SAVE_RESTORE*/ std::vector<double> rate_inputs_buffer;  // Current cohort states, to compare with precomputed_inputs
+
+	void get_rate_inputs(std::vector<double> &v);
+
+	void save_cohorts(io::BinaryWriter &fout);
+	void restore_cohorts(io::BinaryReader &fin);
 
 	public:
 	MySpecies(Model M, bool res=true);
@@ -60,9 +73,16 @@ class MySpecies : public Species<Model>{
 
 	void print_extra();
 
+	void set_precomputed(double t);
+	void clear_precomputed();
+	void preComputeAllCohorts(double t, void * env) override;
+
 	void save(std::ofstream &fout);
 	void restore(std::ifstream &fin);
 
+	void save(io::BinaryWriter &fout);
+	void restore(io::BinaryReader &fin);
+
 };
 
 #include "trait_evolution.tpp"
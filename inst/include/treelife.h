@@ -5,6 +5,7 @@
 #include "plant_geometry.h"
 #include "assimilation.h"
 #include "plant.h"
+#include "utils/rk45.h"
 
 #include "climate.h"
 #include "light_environment.h"
@@ -26,6 +27,16 @@ class LifeHistoryOptimizer{
 	std::string co2_file = "";
 
 	double dt = 0.1; 
+	int    n_threads = 1;   ///< Threads used by calcFitness_batch()
+
+	std::string integrator = "rk4";  ///< Integrator used by calcFitness(): "rk4" (fixed step dt) or "rk45" (adaptive, with tolerances rtol and atol)
+	double rtol = 1e-6;
+	double atol = 1e-6;
+
+	int n_derivs = 0;         ///< Number of rate evaluations (calls to calc_demographic_rates) in the last calcFitness()
+	int n_derivs_saved = 0;   ///< Rate evaluations saved by the adaptive integrator in the last calcFitness(), compared to RK4 with step dt
+
+	RK4Integrator<> rk4;   // workspace for grow_for_dt()
 
 	double rep;
 	double litter_pool;
@@ -45,14 +56,25 @@ class LifeHistoryOptimizer{
 	std::vector<double> get_traits();
 
 	void set_state(std::vector<double>::iterator it);
+	std::vector<double> get_state();
 
 	void get_rates(std::vector<double>::iterator it);
 
+	/// @brief Calculate the rates of the state variables S at time t (see set_state() and get_rates())
+	void calc_rates(double t, std::vector<double>&S, std::vector<double>&dSdt);
+
 	void grow_for_dt(double t, double dt);
 
 
 	double calcFitness();
 
+	/// @brief   Calculate fitness for each row of `trait_matrix` (one trait vector per row, as in set_traits()).
+	/// @details Each trait vector gets its own plant, initialized from params_file as in init(), and its fitness is 
+	///          calculated with calcFitness(), using up to `n_threads` threads. This is thread-parallel only: rates are 
+	///          still evaluated one plant at a time, so the work is the same as a loop over calcFitness(), and the 
+	///          result for each trait vector is identical to calling init(), set_traits() and calcFitness().
+	std::vector<double> calcFitness_batch(std::vector<std::vector<double>> trait_matrix);
+
 };
 
 
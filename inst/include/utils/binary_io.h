@@ -0,0 +1,135 @@
+#ifndef UTILS_IO_BINARY_IO_H_
+#define UTILS_IO_BINARY_IO_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+/** \ingroup utils */
+
+namespace io{
+
+/// @brief   Serializes values into an in-memory byte buffer, in native byte order.
+/// @details Doubles are stored as their 8-byte representation, so values are restored exactly.
+///          Strings and vectors are prefixed with their length.
+class BinaryWriter{
+	private:
+	std::string buf;
+
+	public:
+	template<class T>
+	void write(const T &v){
+		static_assert(std::is_arithmetic<T>::value, "BinaryWriter::write() supports only arithmetic types");
+		buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+	}
+
+	void write(const std::string &s){
+		write(uint64_t(s.size()));
+		buf.append(s);
+	}
+
+	template<class T>
+	void write(const std::vector<T> &v){
+		write(uint64_t(v.size()));
+		for (auto& x : v) write(x);
+	}
+
+	void write_bytes(const char * data, size_t n){
+		buf.append(data, n);
+	}
+
+	void write(const std::vector<bool> &v){
+		write(uint64_t(v.size()));
+		for (bool x : v) write(uint8_t(x));
+	}
+
+	const std::string& data() const {
+		return buf;
+	}
+};
+
+
+/// @brief Reads values written by BinaryWriter. Throws std::runtime_error if the data ends prematurely.
+class BinaryReader{
+	private:
+	const char * p;
+	const char * end;
+
+	void check(uint64_t n){
+		if (n > uint64_t(end-p)) throw std::runtime_error("BinaryReader: unexpected end of data");
+	}
+
+	public:
+	BinaryReader(const std::string &data) : p(data.data()), end(data.data()+data.size()) {}
+
+	template<class T>
+	void read(T &v){
+		static_assert(std::is_arithmetic<T>::value, "BinaryReader::read() supports only arithmetic types");
+		check(sizeof(T));
+		std::memcpy(&v, p, sizeof(T));
+		p += sizeof(T);
+	}
+
+	void read(std::string &s){
+		uint64_t n; read(n);
+		check(n);
+		s.assign(p, n);
+		p += n;
+	}
+
+	template<class T>
+	void read(std::vector<T> &v){
+		uint64_t n; read(n);
+		check(n);  // each element takes at least 1 byte, so this rejects corrupt sizes before allocating
+		v.resize(n);
+		for (auto& x : v) read(x);
+	}
+
+	void read(std::vector<bool> &v){
+		uint64_t n; read(n);
+		check(n);
+		v.resize(n);
+		for (uint64_t i=0; i<n; ++i){ uint8_t x; read(x); v[i] = x; }
+	}
+
+	void read_bytes(char * data, size_t n){
+		check(n);
+		std::memcpy(data, p, n);
+		p += n;
+	}
+
+	template<class T>
+	T get(){
+		T v; read(v);
+		return v;
+	}
+
+	bool at_end() const {
+		return p == end;
+	}
+};
+
+
+/// @brief CRC-32 (IEEE 802.3 polynomial, as used by zlib) of n bytes
+inline uint32_t crc32(const char * data, size_t n, uint32_t crc = 0){
+	static const auto table = [](){
+		std::vector<uint32_t> t(256);
+		for (uint32_t i=0; i<256; ++i){
+			uint32_t c = i;
+			for (int k=0; k<8; ++k) c = (c & 1)? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (size_t i=0; i<n; ++i) crc = table[(crc ^ uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+} // namespace io
+
+#endif
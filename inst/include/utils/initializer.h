@@ -54,6 +54,17 @@ class Initializer{
 		init_fname = fname;
 	}
 
+	/// Copies the values read from the file (the file is not re-read)
+	inline Initializer(const Initializer &other) : init_fname(other.init_fname), strings(other.strings), scalars(other.scalars), arrays(other.arrays) {}
+
+	inline Initializer& operator = (const Initializer &other){
+		init_fname = other.init_fname;
+		strings = other.strings;
+		scalars = other.scalars;
+		arrays = other.arrays;
+		return *this;
+	}
+
 	inline void setInitFile(std::string fname){
 		init_fname = fname;
 	}
@@ -150,6 +161,28 @@ class Initializer{
 		}
 	}
 
+	/// Returns the value of an optional string, or `def` if it is not present in the file
+	inline std::string getStringOrDefault(std::string s, std::string def){
+		std::map <std::string, std::string>::iterator it = strings.find(s);
+		return (it != strings.end())? it->second : def;
+	}
+
+	/// Returns the value of an optional scalar, or `def` if it is not present in the file
+	inline double getScalarOrDefault(std::string s, double def){
+		std::map <std::string, double>::iterator it = scalars.find(s);
+		return (it != scalars.end())? it->second : def;
+	}
+
+	/// Sets a string, replacing the value read from the file, if any
+	inline void setString(std::string s, std::string value){
+		strings[s] = value;
+	}
+
+	/// Sets a scalar, replacing the value read from the file, if any
+	inline void setScalar(std::string s, double value){
+		scalars[s] = value;
+	}
+
 	inline std::vector <double> getArray(std::string s, int size = -1){
 		std::map <std::string, std::vector<double> >::iterator it = arrays.find(s);
 		if (it == arrays.end()) {	// array not found
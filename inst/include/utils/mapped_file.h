@@ -0,0 +1,80 @@
+#ifndef UTILS_IO_MAPPED_FILE_H_
+#define UTILS_IO_MAPPED_FILE_H_
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/** \ingroup utils */
+
+namespace io{
+
+/// @brief   Read-only view of the contents of a file.
+/// @details On POSIX systems the file is memory-mapped, so pages are loaded only when they are accessed, and the
+///          OS can drop them again when memory is needed. Elsewhere, the file is read into memory.
+class MappedFile{
+	private:
+	const char * ptr = nullptr;
+	size_t len = 0;
+	std::string buf;   // contents, if the file is not mapped
+
+	public:
+	explicit MappedFile(const std::string &file){
+#if !defined(_WIN32)
+		int fd = ::open(file.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("Could not open file " + file);
+		struct stat st;
+		if (::fstat(fd, &st) != 0){
+			::close(fd);
+			throw std::runtime_error("Could not read file " + file);
+		}
+		len = st.st_size;
+		if (len > 0){
+			void * p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED){
+				::close(fd);
+				throw std::runtime_error("Could not map file " + file);
+			}
+			ptr = static_cast<const char*>(p);
+		}
+		::close(fd);  // the mapping stays valid
+#else
+		std::ifstream fin(file, std::ios::binary);
+		if (!fin) throw std::runtime_error("Could not open file " + file);
+		std::stringstream ss;
+		ss << fin.rdbuf();
+		buf = ss.str();
+		ptr = buf.data();
+		len = buf.size();
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile(){
+#if !defined(_WIN32)
+		if (ptr) ::munmap(const_cast<char*>(ptr), len);
+#endif
+	}
+
+	const char * data() const {
+		return ptr;
+	}
+
+	size_t size() const {
+		return len;
+	}
+};
+
+} // namespace io
+
+#endif
@@ -2,58 +2,109 @@
 #define UTILS_MATH_MOVING_AVG_H_
 
 #include <iostream>
+#include <fstream>
 
-#include <list>
 #include <cmath>
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <string>
+#include <stdexcept>
 
+#include "binary_io.h"
+
+/// @brief   Time-weighted moving average of a quantity f(t) over the last T time units, using the trapezoidal rule.
+/// @details The history is stored in a ring buffer, so push() does not allocate memory once the buffer 
+///          has grown to the number of points in the averaging interval. Use set_capacity() to preallocate 
+///          space for long intervals, or to cap the number of points kept.
 class MovingAverager{
 	private:
 	double area_sum = 0;
-	std::list<double> areas;
-	std::list<double> dts;
-	std::list<double> f_hist;
-	std::list<double> t_hist;
+
+	// Ring buffer of history points. The oldest point is at index `first`. For each point, `areas` and `dts` 
+	// hold the area and width of the trapezoid between the previous point and this one (unused for the oldest point).
+	std::vector<double> f_hist;
+	std::vector<double> t_hist;
+	std::vector<double> areas;
+	std::vector<double> dts;
+	int  first = 0;
+	int  npoints = 0;
+	bool fixed_capacity = false;
 
 	public:
 	// seed output history
 	double T = 5;
 	bool debug = false;
 
+	private:
+	// Buffer index of the i-th oldest point
+	inline int idx(int i) const {
+		int k = first + i;
+		return (k >= int(t_hist.size()))? k - int(t_hist.size()) : k;
+	}
+
+	inline void resize_buffer(int cap){
+		std::vector<double> f(cap), t(cap), a(cap), d(cap);
+		for (int i=0; i<npoints; ++i){
+			int k = idx(i);
+			f[i] = f_hist[k]; t[i] = t_hist[k]; a[i] = areas[k]; d[i] = dts[k];
+		}
+		f_hist.swap(f); t_hist.swap(t); areas.swap(a); dts.swap(d);
+		first = 0;
+	}
+
+	inline void pop_front(){
+		area_sum -= areas[idx(1)];  // trapezoid between the oldest point and the next one
+		first = idx(1);
+		--npoints;
+	}
+
+	inline void push_back(double t, double f, double area, double dt){
+		if (npoints == int(t_hist.size())){
+			if (fixed_capacity) pop_front();
+			else resize_buffer(std::max(16, 2*npoints));
+		}
+		int k = idx(npoints);
+		f_hist[k] = f; t_hist[k] = t; areas[k] = area; dts[k] = dt;
+		++npoints;
+	}
+
 	public:
 	
 	inline void set_interval(double _T){
 		T = _T;
 	}
+
+	/// @brief Preallocate space for n points. If `fixed` is true, at most n points are kept: when the buffer is full,
+	///        the oldest point is dropped, even if it is still within the averaging interval.
+	inline void set_capacity(int n, bool fixed = false){
+		n = std::max(n, 2);
+		fixed_capacity = fixed;
+		while (npoints > n) pop_front();
+		if (n != int(t_hist.size())) resize_buffer(n);
+	}
+
+	inline int size() const {
+		return npoints;
+	}
 	
 	inline void push(double t, double f){
-		if (f_hist.empty()){
-			f_hist.push_back(f);
-			t_hist.push_back(t);
-			//areas.push_back(0);
+		if (npoints == 0){
+			push_back(t, f, 0, 0);
 			return;
 		}
 		
-		assert(t > t_hist.back());
+		assert(t > t_hist[idx(npoints-1)]);
 
-		double f_lo = f_hist.back();
-		double t_lo = t_hist.back();
+		double f_lo = f_hist[idx(npoints-1)];
+		double t_lo = t_hist[idx(npoints-1)];
 		double area_new = (f + f_lo) / 2 * (t - t_lo);
-		f_hist.push_back(f);
-		t_hist.push_back(t);
-		dts.push_back(t - t_lo);
-		areas.push_back(area_new);
+		push_back(t, f, area_new, t - t_lo);
 		area_sum += area_new;
 		
-		while(!t_hist.empty()){
-			if (t_hist.front() < t - T){  // past t is beyond the averaging interval
-				area_sum -= areas.front();
-				f_hist.pop_front();
-				t_hist.pop_front();
-				dts.pop_front();
-				areas.pop_front();
+		while(npoints > 1){
+			if (t_hist[first] < t - T){  // past t is beyond the averaging interval
+				pop_front();
 			}
 			else{
 				break;
@@ -62,47 +113,40 @@ class MovingAverager{
 	}
 
 	inline double get(){
-		if (t_hist.size() == 0) return 0;
-		else if (t_hist.size() == 1) return f_hist.front();
-		else return area_sum/(t_hist.back()-t_hist.front());
+		if (npoints == 0) return 0;
+		else if (npoints == 1) return f_hist[first];
+		else return area_sum/(t_hist[idx(npoints-1)]-t_hist[first]);
 	}
 
 	inline double get_first(){
-		if (t_hist.size() == 0) return 0;
-		else return f_hist.front();
+		if (npoints == 0) return 0;
+		else return f_hist[first];
 	}
 
 	inline double get_last(){
-		if (t_hist.size() == 0) return 0;
-		else return f_hist.back();
+		if (npoints == 0) return 0;
+		else return f_hist[idx(npoints-1)];
 	}
 
 	inline double get_interval(){
-		if (t_hist.size() == 0) return 0;
-		else return (t_hist.back()-t_hist.front());
+		if (npoints == 0) return 0;
+		else return (t_hist[idx(npoints-1)]-t_hist[first]);
 	}
 
 	inline void clear(){
 		area_sum = 0;
-		f_hist.clear();
-		t_hist.clear();
-		areas.clear();
-		dts.clear();
+		first = 0;
+		npoints = 0;
 	}
 	
 	inline void print(){
 		std::cout << "MovingAverager:\n";
-		auto f_it = f_hist.begin();
-		auto t_it = t_hist.begin();
-		auto a_it = areas.begin();
-		auto d_it = dts.begin();
-		
 		std::cout << "   t\tf\tA\tdt\n";
-		while(f_it != f_hist.end()){
-			std::cout << "   " << *t_it << "\t" << *f_it << "\t";
-			std::cout << ((a_it != areas.end())? *a_it : 0) << "\t";
-			std::cout << ((d_it != dts.end())? *d_it : 0) << "\n";
-			++f_it; ++t_it; ++a_it;
+		for (int i=0; i<npoints; ++i){
+			int k = idx(i);
+			std::cout << "   " << t_hist[k] << "\t" << f_hist[k] << "\t";
+			std::cout << ((i+1 < npoints)? areas[idx(i+1)] : 0) << "\t";
+			std::cout << ((i+1 < npoints)? dts[idx(i+1)] : 0) << "\n";
 		}
 		std::cout << "-----\n";
 		std::cout << "sum = " << area_sum << ", avg = " << get() << "\n";
@@ -110,31 +154,27 @@ class MovingAverager{
 	}
 
 	inline void print_summary(){
-		std::cout << "MovingAverager:  t = " << t_hist.front() << " - " << t_hist.back() << ", x = " << f_hist.front() << " - " << f_hist.back() << ", xmean = " << get() << ", (T = " << t_hist.back() - t_hist.front() << "), npoints = " << f_hist.size() << "\n";
+		std::cout << "MovingAverager:  t = " << t_hist[first] << " - " << t_hist[idx(npoints-1)] << ", x = " << f_hist[first] << " - " << f_hist[idx(npoints-1)] << ", xmean = " << get() << ", (T = " << t_hist[idx(npoints-1)] - t_hist[first] << "), npoints = " << npoints << "\n";
 	}
 
 	inline double get_exp(double c = 0){
-		if (t_hist.size() == 0) return 0;
-		if (t_hist.size() == 1) return f_hist.front();
+		if (npoints == 0) return 0;
+		if (npoints == 1) return f_hist[first];
 
 		if (debug) std::cout << "Exp avg: ";
-		auto f_it = f_hist.rbegin();
-		auto t_it = t_hist.rbegin();
 		double avg = 0;
 		double D = 0;
-		double t0 = *t_hist.rbegin();
-		int i=0;
-		while (f_it != prev(f_hist.rend())){
-			double t_hi = *t_it;
-			double t_lo = *next(t_it);
-			double f_hi = (*f_it);
+		double t0 = t_hist[idx(npoints-1)];
+		for (int i=npoints-1; i>0; --i){
+			double t_hi = t_hist[idx(i)];
+			double t_lo = t_hist[idx(i-1)];
+			double f_hi = f_hist[idx(i)];
 			double w_hi = exp(-c*(t0-t_hi));
-			double f_lo = (*next(f_it));
+			double f_lo = f_hist[idx(i-1)];
 			double w_lo = exp(-c*(t0-t_lo));
 			double dt = t_hi - t_lo;
 			avg += (f_hi*w_hi + f_lo*w_lo)/2 * dt;
 			D += (w_hi + w_lo)/2 * dt;
-			++f_it; ++t_it;
 
 			if (debug) std::cout << (f_hi*w_hi + f_lo*w_lo)/2 * dt << " ";
 		}
@@ -147,26 +187,29 @@ class MovingAverager{
 
 
 	inline double get_cesaro(double c=0){
-		if (t_hist.size() == 0) return 0;
-		if (t_hist.size() == 1) return f_hist.front();
+		if (npoints == 0) return 0;
+		if (npoints == 1) return f_hist[first];
 
 		// f_hist has 2 or more elements, so compute
 		// assert that t is equally spaced
-		auto tt = std::minmax_element(dts.begin(), dts.end());
+		double dt_min = dts[idx(1)], dt_max = dts[idx(1)];
+		for (int i=2; i<npoints; ++i){
+			dt_min = std::min(dt_min, dts[idx(i)]);
+			dt_max = std::max(dt_max, dts[idx(i)]);
+		}
 		double thresh = 0.01;
-		if (fabs(*tt.first - *tt.second) > thresh) throw std::runtime_error("Cesaro Average requires equally spaced intervals.");
-		double Dt = *tt.first;
+		if (fabs(dt_min - dt_max) > thresh) throw std::runtime_error("Cesaro Average requires equally spaced intervals.");
+		double Dt = dt_min;
 
 		// 
-		int nmax = f_hist.size();
+		int nmax = npoints;
 		std::vector<double> avgs(nmax, 0);
 
 		for (int n=1; n<nmax; ++n){
 			avgs[n] = 0;
 			double D = 0;
-			auto f_it = f_hist.rbegin();
-			for (int i=0; i<n; ++i, ++f_it){
-				avgs[n] += (*f_it) * exp(-c*i*Dt);
+			for (int i=0; i<n; ++i){
+				avgs[n] += f_hist[idx(npoints-1-i)] * exp(-c*i*Dt);
 				D += exp(-c*i*Dt);
 			}
 			avgs[n] /= D;
@@ -189,26 +232,28 @@ class MovingAverager{
 		return avg;
 	}
 
+	// The saved format stores the trapezoids (areas, dts) of all points except the oldest, followed by the points
 	void save(std::ofstream &fout){
 		fout << "MovingAverager::v1\n";
 
 		fout << area_sum << ' '
 		     << T << '\n';
 		
-		fout << areas.size() << " | "; 
-		for (auto x : areas) fout << x << ' '; 
+		int na = std::max(npoints-1, 0);
+		fout << na << " | "; 
+		for (int i=1; i<npoints; ++i) fout << areas[idx(i)] << ' '; 
 		fout << '\n';
 
-		fout << dts.size() << " | "; 
-		for (auto x : dts) fout << x << ' '; 
+		fout << na << " | "; 
+		for (int i=1; i<npoints; ++i) fout << dts[idx(i)] << ' '; 
 		fout << '\n';
 
-		fout << f_hist.size() << " | "; 
-		for (auto x : f_hist) fout << x << ' '; 
+		fout << npoints << " | "; 
+		for (int i=0; i<npoints; ++i) fout << f_hist[idx(i)] << ' '; 
 		fout << '\n';
 
-		fout << t_hist.size() << " | "; 
-		for (auto x : t_hist) fout << x << ' '; 
+		fout << npoints << " | "; 
+		for (int i=0; i<npoints; ++i) fout << t_hist[idx(i)] << ' '; 
 		fout << '\n';
 		
 	}
@@ -220,20 +265,62 @@ class MovingAverager{
 		fin >> area_sum
 		    >> T;
 		
-		int n;
-		double x;
-
-		fin >> n >> s; 
-		for (int i=0; i<n; ++i) {fin >> x; areas.push_back(x);}
+		std::vector<double> a, d, f, t;
+		for (auto v : {&a, &d, &f, &t}){
+			int n; 
+			fin >> n >> s; 
+			v->resize(n);
+			for (auto& x : *v) fin >> x;
+		}
+		restore_points(a, d, f, t);
+	}
 
-		fin >> n >> s; 
-		for (int i=0; i<n; ++i) {fin >> x; dts.push_back(x);}
+	void save(io::BinaryWriter &fout){
+		fout.write(std::string("MovingAverager::v1"));
+		fout.write(area_sum);
+		fout.write(T);
+		std::vector<double> a, d, f, t;
+		for (int i=0; i<npoints; ++i){
+			if (i > 0) { a.push_back(areas[idx(i)]); d.push_back(dts[idx(i)]); }
+			f.push_back(f_hist[idx(i)]);
+			t.push_back(t_hist[idx(i)]);
+		}
+		for (auto v : {&a, &d, &f, &t}) fout.write(*v);
+	}
 
-		fin >> n >> s; 
-		for (int i=0; i<n; ++i) {fin >> x; f_hist.push_back(x);}
+	void restore(io::BinaryReader &fin){
+		if (fin.get<std::string>() != "MovingAverager::v1") throw std::runtime_error("MovingAverager: unsupported binary version");
+		fin.read(area_sum);
+		fin.read(T);
+		std::vector<double> a, d, f, t;
+		for (auto v : {&a, &d, &f, &t}) fin.read(*v);
+		restore_points(a, d, f, t);
+	}
 
-		fin >> n >> s; 
-		for (int i=0; i<n; ++i) {fin >> x; t_hist.push_back(x);}
+	private:
+	// Refill the buffer from saved points (oldest first). The trapezoids a, d belong to the last a.size() points.
+	// With a fixed capacity, only the newest points that fit are kept, as if they had been pushed.
+	void restore_points(const std::vector<double> &a, const std::vector<double> &d, const std::vector<double> &f, const std::vector<double> &t){
+		if (f.size() != t.size() || a.size() != d.size() || a.size() > f.size()) throw std::runtime_error("MovingAverager: inconsistent saved history");
+		int n = f.size();
+		int cap0 = t_hist.size();
+		int cap = std::max(cap0, n);
+		t_hist.assign(cap, 0); f_hist.assign(cap, 0); areas.assign(cap, 0); dts.assign(cap, 0);
+		first = 0;
+		npoints = n;
+		int offset = n - a.size();
+		for (int i=0; i<n; ++i){
+			f_hist[i] = f[i];
+			t_hist[i] = t[i];
+			if (i >= offset){
+				areas[i] = a[i-offset];
+				dts[i] = d[i-offset];
+			}
+		}
+		if (fixed_capacity && n > cap0){
+			while (npoints > cap0) pop_front();
+			resize_buffer(cap0);
+		}
 	}
 
 };
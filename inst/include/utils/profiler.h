@@ -0,0 +1,177 @@
+#ifndef UTILS_PROFILER_H_
+#define UTILS_PROFILER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+/** \ingroup utils */
+
+/// @brief   Built-in instrumentation of the main phases of a simulation.
+/// @details Timers and call counters are compiled in only if PLANTFATE_PROFILE is defined (e.g. with
+///          `make PROFILE_FLAGS=-DPLANTFATE_PROFILE`). Otherwise the PF_PROFILE_* macros expand to
+///          nothing and the instrumented code is identical to an uninstrumented build.
+///
+///          A phase is timed with `PF_PROFILE_SCOPE(PHASE)`, which adds one call and the wall time until the end of
+///          the enclosing scope. Phases nest (e.g. Z_STAR and FAPAR are inside COMPUTE_ENV, and PHYDRO is inside
+///          PRECOMPUTE), so times are inclusive. When a phase runs on several threads, its time is the sum over
+///          threads. Totals are kept in one process-wide Profiler, so concurrent simulations in the same process
+///          (e.g. members of an ensemble) are counted together.
+namespace prof{
+
+enum Phase {
+	COMPUTE_ENV = 0,   ///< PSPM_Dynamic_Environment::computeEnv()
+	Z_STAR,            ///< Finding z* of all canopy layers
+	FAPAR,             ///< Light absorbed by canopy layers (fapar_layer() or fapar_all_layers())
+	PRECOMPUTE,        ///< PSPM_Plant::preCompute(), i.e. calc_demographic_rates() of one cohort
+	PHYDRO,            ///< Calls to Phydro (misses of the Phydro cache, if it is used)
+	SPECIES_PROPS,     ///< SpeciesProps::update()
+	EMERGENT_PROPS,    ///< EmergentProps::update()
+	WRITE_STATE,       ///< SolverIO::writeState()
+	TRAIT_EVOLUTION,   ///< Fitness gradients and trait updates
+	N_PHASES
+};
+
+inline const char * phase_name(int p){
+	static const char * names[N_PHASES] = {"computeEnv", "z_star", "fapar", "preCompute", "phydro",
+	                                       "speciesProps", "emergentProps", "writeState", "traitEvolution"};
+	return names[p];
+}
+
+/// @brief Process-wide call counts and times of all phases. Thread-safe.
+class Profiler{
+	private:
+	std::array<std::atomic<long long>, N_PHASES> n_calls{};
+	std::array<std::atomic<long long>, N_PHASES> n_ns{};
+
+	public:
+	static Profiler& instance(){
+		static Profiler p;
+		return p;
+	}
+
+	void add(int phase, long long ns){
+		n_calls[phase].fetch_add(1, std::memory_order_relaxed);
+		n_ns[phase].fetch_add(ns, std::memory_order_relaxed);
+	}
+
+	long long calls(int phase) const {
+		return n_calls[phase].load(std::memory_order_relaxed);
+	}
+
+	double seconds(int phase) const {
+		return n_ns[phase].load(std::memory_order_relaxed)*1e-9;
+	}
+
+	void reset(){
+		for (int p=0; p<N_PHASES; ++p){
+			n_calls[p] = 0;
+			n_ns[p] = 0;
+		}
+	}
+};
+
+/// @brief Adds the time from construction to destruction to a phase
+class ScopedTimer{
+	private:
+	int phase;
+	std::chrono::steady_clock::time_point start;
+
+	public:
+	explicit ScopedTimer(int _phase) : phase(_phase), start(std::chrono::steady_clock::now()) {}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	~ScopedTimer(){
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		Profiler::instance().add(phase, ns);
+	}
+};
+
+/// @brief   Writes the calls and times of all phases per simulated year.
+/// @details The file has one row per year and phase: `year phase calls seconds` (tab-separated, with a header).
+///          record(t) is called after each step of the simulation; the work done since the previous call is
+///          attributed to the year of t. A year is written when the first step of a later year is recorded, and
+///          the last year is written by close().
+class ProfileWriter{
+	private:
+	// Totals of all phases at some point in time
+	struct Totals{
+		std::array<long long, N_PHASES> calls{};
+		std::array<double, N_PHASES>    seconds{};
+
+		static Totals now(){
+			Totals x;
+			for (int p=0; p<N_PHASES; ++p){
+				x.calls[p]   = Profiler::instance().calls(p);
+				x.seconds[p] = Profiler::instance().seconds(p);
+			}
+			return x;
+		}
+	};
+
+	std::ofstream fout;
+	int    year = 0;
+	bool   have_year = false;
+	Totals at_start;   // at the start of the current year
+	Totals at_last;    // at the last call to record()
+
+	void write_year(const Totals &at_end){
+		for (int p=0; p<N_PHASES; ++p){
+			long long n = at_end.calls[p] - at_start.calls[p];
+			if (n == 0) continue;
+			fout << year << "\t" << phase_name(p) << "\t" << n << "\t" << at_end.seconds[p] - at_start.seconds[p] << "\n";
+		}
+		fout.flush();
+	}
+
+	public:
+	void open(std::string file){
+		fout.open(file);
+		if (!fout) throw std::runtime_error("Could not open profile file " + file);
+		fout << "year\tphase\tcalls\tseconds\n";
+		have_year = false;
+		at_start = at_last = Totals::now();
+	}
+
+	bool is_open() const {
+		return fout.is_open();
+	}
+
+	void record(double t){
+		if (!fout.is_open()) return;
+		int y = int(std::floor(t));
+		if (have_year && y != year){
+			write_year(at_last);  // work since the last call belongs to the new year
+			at_start = at_last;
+		}
+		year = y;
+		have_year = true;
+		at_last = Totals::now();
+	}
+
+	void close(){
+		if (!fout.is_open()) return;
+		if (have_year) write_year(at_last);
+		fout.close();
+	}
+};
+
+} // namespace prof
+
+
+#ifdef PLANTFATE_PROFILE
+#define PF_PROFILE_CONCAT_(a, b) a##b
+#define PF_PROFILE_CONCAT(a, b) PF_PROFILE_CONCAT_(a, b)
+/// Time the rest of the enclosing scope as phase prof::PHASE
+#define PF_PROFILE_SCOPE(PHASE) prof::ScopedTimer PF_PROFILE_CONCAT(pf_profile_timer_, __LINE__)(prof::PHASE)
+#else
+#define PF_PROFILE_SCOPE(PHASE)
+#endif
+
+#endif
@@ -1,28 +1,77 @@
 #ifndef UTILS_MATH_RK4_H_
 #define UTILS_MATH_RK4_H_
 
+#include <vector>
+#include <array>
+#include <stdexcept>
+
+/** \ingroup utils */
+
+/// Resize a workspace buffer of an integrator to hold n state variables
+inline void resize_workspace(std::vector<double> &c, size_t n){
+	c.resize(n);
+}
+
+template<size_t N>
+void resize_workspace(std::array<double, N> &c, size_t n){
+	if (n != N) throw std::runtime_error("Integrator: state size differs from the fixed size of the workspace");
+}
+
+/// @brief   Fixed-step RK4 and Euler integrators with caller-owned workspace.
+/// @details The workspace (k1..k4, yt) belongs to the integrator object, so independent integrators can be
+///          used concurrently and with different state sizes. With a std::vector the workspace is resized to
+///          the state on each step (allocating only when the size grows). With std::array<double, N> the state
+///          size is fixed at compile time and the integrator can live on the stack.
+///          derivs(x, y, dydt) must write the derivatives of y at x into dydt.
+template <class container = std::vector<double>>
+class RK4Integrator{
+	private:
+	container k1, k2, k3, k4, yt;
+
+	void resize_all(size_t n){
+		for (auto c : {&k1, &k2, &k3, &k4, &yt}) resize_workspace(*c, n);
+	}
+
+	public:
+	/// @brief Advance y from x to x+h with one Euler step
+	template <class functor>
+	void euler_step(double x, double h, container& y, functor& derivs){
+		resize_all(y.size());
+		derivs(x, y, k1);
+		for (int i=0; i<y.size(); i++) y[i] += h*k1[i];
+	}
+
+	/// @brief Advance y from x to x+h with one RK4 step
+	template <class functor>
+	void step(double x, double h, container& y, functor& derivs){
+		resize_all(y.size());
+
+		double h2=h*0.5;
+		double xh = x + h2;
+		derivs(x, y, k1);     // First step : evaluating k1
+		for (int i=0; i<y.size(); i++) yt[i] = y[i] + h2*k1[i];// Preparing second step by  ty <- y + k1/2
+		derivs(xh, yt, k2);                                    // Second step : evaluating k2
+		for (int i=0; i<y.size(); i++) yt[i] = y[i] + h2*k2[i];// Preparing third step by   yt <- y + k2/2
+		derivs(xh, yt, k3);                                    // Third step : evaluating k3
+		for (int i=0; i<y.size(); i++) yt[i] = y[i] +  h*k3[i];// Preparing fourth step  yt <- y + k3
+		derivs(x+h, yt, k4);                                   // Final step : evaluating k4
+		for (int i=0; i<y.size(); i++) y[i] += h/6.0*(k1[i]+2.0*(k2[i]+k3[i])+k4[i]);
+	}
+};
+
+
+/// @brief One Euler step with a temporary workspace. Thread-safe; use an RK4Integrator to reuse the workspace.
 template <class functor, class container>
 void Euler(double x, double h, container& y, functor& derivs){
-	container fk(y.size());
-	derivs(x, y, fk);
-	for (int i=0; i<y.size(); i++) y[i] += h*fk[i]; 
+	RK4Integrator<container> integrator;
+	integrator.euler_step(x, h, y, derivs);
 }
 
+/// @brief One RK4 step with a temporary workspace. Thread-safe; use an RK4Integrator to reuse the workspace.
 template <class functor, class container>
 void RK4(double x, double h, container& y, functor& derivs){
-	static container k1(y.size()), k2(y.size()), k3(y.size()), k4(y.size());// temporary arrays
-	static container yt(y.size());
-
-	double h2=h*0.5;
-	double xh = x + h2;
-	derivs(x, y, k1);     // First step : evaluating k1
-	for (int i=0; i<y.size(); i++) yt[i] = y[i] + h2*k1[i];// Preparing second step by  ty <- y + k1/2
-	derivs(xh, yt, k2);                                    // Second step : evaluating k2
-	for (int i=0; i<y.size(); i++) yt[i] = y[i] + h2*k2[i];// Preparing third step by   yt <- y + k2/2
-	derivs(xh, yt, k3);                                    // Third step : evaluating k3
-	for (int i=0; i<y.size(); i++) yt[i] = y[i] +  h*k3[i];// Preparing fourth step  yt <- y + k3
-	derivs(x+h, yt, k4);                                   // Final step : evaluating k4
-	for (int i=0; i<y.size(); i++) y[i] += h/6.0*(k1[i]+2.0*(k2[i]+k3[i])+k4[i]);
+	RK4Integrator<container> integrator;
+	integrator.step(x, h, y, derivs);
 }
 
 #endif
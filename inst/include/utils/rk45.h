@@ -0,0 +1,114 @@
+#ifndef UTILS_MATH_RK45_H_
+#define UTILS_MATH_RK45_H_
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "rk4.h"
+
+/** \ingroup utils */
+
+/// @brief   Adaptive-step Runge-Kutta-Cash-Karp (RK45) integrator.
+/// @details Each step evaluates 4th and 5th order solutions from the same 6 derivative evaluations, and uses
+///          their difference as the error estimate. A step is accepted if, for all variables,
+///          \f$|\text{err}_i| \le \text{atol} + \text{rtol}\,|y_i|\f$, and the step size is adapted to keep the
+///          error near this tolerance. The last step size is kept between calls to integrate().
+///          The workspace belongs to the integrator, as in RK4Integrator.
+template <class container = std::vector<double>>
+class RK45Integrator{
+	public:
+	double rtol = 1e-6;
+	double atol = 1e-6;
+	double h = 0;          ///< Next step size. If 0, the first call to integrate() starts with 1/100 of the interval.
+	double h_min = 1e-8;   ///< integrate() throws if the step size falls below this
+	double h_max = 1e20;
+
+	long n_evals = 0;      ///< Number of derivative evaluations
+	long n_steps = 0;      ///< Number of accepted steps
+	long n_rejected = 0;   ///< Number of rejected steps
+
+	private:
+	container k1, k2, k3, k4, k5, k6, yt, yerr;
+
+	void resize_all(size_t n){
+		for (auto c : {&k1, &k2, &k3, &k4, &k5, &k6, &yt, &yerr}) resize_workspace(*c, n);
+	}
+
+	// One Cash-Karp step of size hs from (x,y), with k1 = derivs(x,y) already computed.
+	// The 5th order solution is written to yt and the error estimate to yerr.
+	template <class functor>
+	void try_step(double x, double hs, const container &y, functor &derivs){
+		static const double a2=0.2, a3=0.3, a4=0.6, a5=1.0, a6=0.875,
+			b21=0.2,
+			b31=3.0/40.0, b32=9.0/40.0,
+			b41=0.3, b42=-0.9, b43=1.2,
+			b51=-11.0/54.0, b52=2.5, b53=-70.0/27.0, b54=35.0/27.0,
+			b61=1631.0/55296.0, b62=175.0/512.0, b63=575.0/13824.0, b64=44275.0/110592.0, b65=253.0/4096.0,
+			c1=37.0/378.0, c3=250.0/621.0, c4=125.0/594.0, c6=512.0/1771.0,
+			dc1=c1-2825.0/27648.0, dc3=c3-18575.0/48384.0, dc4=c4-13525.0/55296.0, dc5=-277.0/14336.0, dc6=c6-0.25;
+
+		int n = y.size();
+		for (int i=0; i<n; ++i) yt[i] = y[i] + hs*b21*k1[i];
+		derivs(x+a2*hs, yt, k2);
+		for (int i=0; i<n; ++i) yt[i] = y[i] + hs*(b31*k1[i] + b32*k2[i]);
+		derivs(x+a3*hs, yt, k3);
+		for (int i=0; i<n; ++i) yt[i] = y[i] + hs*(b41*k1[i] + b42*k2[i] + b43*k3[i]);
+		derivs(x+a4*hs, yt, k4);
+		for (int i=0; i<n; ++i) yt[i] = y[i] + hs*(b51*k1[i] + b52*k2[i] + b53*k3[i] + b54*k4[i]);
+		derivs(x+a5*hs, yt, k5);
+		for (int i=0; i<n; ++i) yt[i] = y[i] + hs*(b61*k1[i] + b62*k2[i] + b63*k3[i] + b64*k4[i] + b65*k5[i]);
+		derivs(x+a6*hs, yt, k6);
+		n_evals += 5;
+
+		for (int i=0; i<n; ++i){
+			yt[i]   = y[i] + hs*(c1*k1[i] + c3*k3[i] + c4*k4[i] + c6*k6[i]);
+			yerr[i] = hs*(dc1*k1[i] + dc3*k3[i] + dc4*k4[i] + dc5*k5[i] + dc6*k6[i]);
+		}
+	}
+
+	public:
+	/// @brief Integrate y from x0 to x1 with adaptive steps. derivs(x, y, dydt) must write the derivatives of y at x into dydt.
+	template <class functor>
+	void integrate(double x0, double x1, container &y, functor &derivs){
+		resize_all(y.size());
+		if (h <= 0) h = (x1-x0)/100;
+
+		double x = x0;
+		while (x < x1){
+			double hs = std::min(std::min(h, h_max), x1-x);
+			bool last = (hs == x1-x);
+
+			derivs(x, y, k1);
+			++n_evals;
+			while (true){
+				try_step(x, hs, y, derivs);
+
+				double err = 0;
+				for (int i=0; i<y.size(); ++i){
+					double scale = atol + rtol*std::max(std::fabs(y[i]), std::fabs(yt[i]));
+					err = std::max(err, std::fabs(yerr[i])/scale);
+				}
+
+				if (err <= 1){
+					// grow the step for the next time, but not by more than 5x
+					double grow = (err > 1.89e-4)? 0.9*pow(err, -0.2) : 5;
+					if (!last || grow < 1) h = hs*grow;  // do not let a shortened last step shrink the next call's step
+					break;
+				}
+
+				++n_rejected;
+				hs *= std::max(0.9*pow(err, -0.25), 0.1);
+				last = false;
+				if (hs < h_min) throw std::runtime_error("RK45Integrator: step size underflow at x = " + std::to_string(x));
+			}
+
+			x = (last)? x1 : x+hs;
+			for (int i=0; i<y.size(); ++i) y[i] = yt[i];
+			++n_steps;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef UTILS_THREAD_POOL_H_
+#define UTILS_THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+/// @brief  Fixed-size pool of worker threads for data-parallel loops.
+/// @details parallel_for() runs f(0) ... f(n-1) on the workers and the calling thread. Tasks are handed out
+///          dynamically from a shared counter, so that threads that finish early pick up the remaining tasks.
+///          Each task must only write to data owned by that task; then results do not depend on which
+///          thread ran which task. If a task throws, the first exception is rethrown in the calling thread
+///          after all tasks have finished.
+class ThreadPool{
+	private:
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable cv_start, cv_done;
+
+	const std::function<void(int)> * job = nullptr;
+	int  n_tasks = 0;
+	long generation = 0;           // incremented for every parallel_for() call
+	int  n_busy = 0;               // workers still working on the current call
+	bool stop = false;
+
+	std::atomic<int> next_task{0};
+	std::exception_ptr error;
+
+	void run_tasks(){
+		int i;
+		while ((i = next_task.fetch_add(1)) < n_tasks){
+			try{
+				(*job)(i);
+			}
+			catch(...){
+				std::lock_guard<std::mutex> lock(mtx);
+				if (!error) error = std::current_exception();
+			}
+		}
+	}
+
+	void worker_loop(){
+		long seen = 0;
+		while (true){
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv_start.wait(lock, [&]{ return stop || generation != seen; });
+				if (stop) return;
+				seen = generation;
+			}
+			run_tasks();
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				if (--n_busy == 0) cv_done.notify_one();
+			}
+		}
+	}
+
+	public:
+	/// @param n_threads Total number of threads, including the calling thread.
+	explicit ThreadPool(int n_threads){
+		for (int i=1; i<n_threads; ++i) workers.emplace_back(&ThreadPool::worker_loop, this);
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool(){
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop = true;
+		}
+		cv_start.notify_all();
+		for (auto& w : workers) w.join();
+	}
+
+	int size() const {
+		return workers.size()+1;
+	}
+
+	/// @brief  Call f(i) for i in [0, n), and wait until all calls have returned. Not re-entrant.
+	void parallel_for(int n, const std::function<void(int)>& f){
+		if (n <= 0) return;
+		if (workers.empty() || n == 1){
+			for (int i=0; i<n; ++i) f(i);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			job = &f;
+			n_tasks = n;
+			next_task = 0;
+			error = nullptr;
+			n_busy = workers.size();
+			++generation;
+		}
+		cv_start.notify_all();
+		run_tasks();
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv_done.wait(lock, [&]{ return n_busy == 0; });
+			job = nullptr;
+		}
+		if (error) std::rethrow_exception(error);
+	}
+};
+
+#endif
+
@@ -13,10 +13,12 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 
 RcppExport SEXP _rcpp_module_boot_treelife_module();
 RcppExport SEXP _rcpp_module_boot_plantfate_module();
+RcppExport SEXP _rcpp_module_boot_output_module();
 
 static const R_CallMethodDef CallEntries[] = {
     {"_rcpp_module_boot_treelife_module", (DL_FUNC) &_rcpp_module_boot_treelife_module, 0},
     {"_rcpp_module_boot_plantfate_module", (DL_FUNC) &_rcpp_module_boot_plantfate_module, 0},
+    {"_rcpp_module_boot_output_module", (DL_FUNC) &_rcpp_module_boot_output_module, 0},
     {NULL, NULL, 0}
 };
 
@@ -5,6 +5,19 @@ namespace plant{
 // **
 template<class _Climate>
 phydro::PHydroResult Assimilator::leaf_assimilation_rate(double I0, double fapar, _Climate &clim, PlantParameters &par, PlantTraits &traits){
+	if (phydro_cache){
+		auto exact = [this, &clim, &par, &traits](double _I0, double _fapar){
+			return leaf_assimilation_rate_exact(_I0, _fapar, clim, par, traits);
+		};
+		return phydro_cache->get(I0, fapar, clim, par, traits, exact);
+	}
+	return leaf_assimilation_rate_exact(I0, fapar, clim, par, traits);
+}
+
+
+template<class _Climate>
+phydro::PHydroResult Assimilator::leaf_assimilation_rate_exact(double I0, double fapar, _Climate &clim, PlantParameters &par, PlantTraits &traits){
+	PF_PROFILE_SCOPE(PHYDRO);
 	phydro::ParCost par_cost(par.alpha, par.gamma);
 	phydro::ParPlant par_plant(traits.K_leaf, traits.p50_leaf, traits.b_leaf);
 	par_plant.gs_method = phydro::GS_APX;
@@ -16,8 +29,11 @@ phydro::PHydroResult Assimilator::leaf_assimilation_rate(double I0, double fapar
 }
 
 
+/// @param c_open_avg  Crown-area weighted canopy openness experienced by the plant. If negative (default), it 
+///                    is calculated from the light environment. Since it does not depend on LAI, a value from a 
+///                    previous call for the same plant size can be reused to skip the traversal of canopy layers.
 template<class Env>
-void  Assimilator::calc_plant_assimilation_rate(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits){
+void  Assimilator::calc_plant_assimilation_rate(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits, double c_open_avg){
 	//double GPP_plant = 0, Rl_plant = 0, dpsi_avg = 0;
 	double fapar = 1-exp(-par.k_light*G->lai);
 	bool by_layer = false;
@@ -32,33 +48,40 @@ void  Assimilator::calc_plant_assimilation_rate(Env &env, PlantGeometry *G, Plan
 	plant_assim.gs_avg     = 0;
 	plant_assim.c_open_avg = 0;
 	
-	double ca_cumm = 0;
-	//std::cout << "--- PPA Assim begin ---" << "\n";
-	for (int ilayer=0; ilayer <= env.n_layers; ++ilayer){ // for l in 1:layers{	
-		double zst = env.z_star[ilayer];
-		double ca_layer = G->crown_area_above(zst, traits) - ca_cumm;
-		//std::cout << "h = " << G->height << ", z* = " << zst << ", I = " << env.canopy_openness[ilayer] << ", fapar = " << fapar << /*", A = " << (res.a + res.vcmax*par.rd) << " umol/m2/s x " <<*/ ", ca_layer = " << ca_layer << /*" m2 = " << (res.a + res.vcmax*par.rd) * ca_layer << ", vcmax = " << res.vcmax <<*/ "\n"; 
+	double ca_total = G->crown_area;                   // total crown area
+
+	if (by_layer == true || c_open_avg < 0){
+		double ca_cumm = 0;
+		//std::cout << "--- PPA Assim begin ---" << "\n";
+		for (int ilayer=0; ilayer <= env.n_layers; ++ilayer){ // for l in 1:layers{	
+			double zst = env.z_star[ilayer];
+			double ca_layer = G->crown_area_above(zst, traits) - ca_cumm;
+			//std::cout << "h = " << G->height << ", z* = " << zst << ", I = " << env.canopy_openness[ilayer] << ", fapar = " << fapar << /*", A = " << (res.a + res.vcmax*par.rd) << " umol/m2/s x " <<*/ ", ca_layer = " << ca_layer << /*" m2 = " << (res.a + res.vcmax*par.rd) * ca_layer << ", vcmax = " << res.vcmax <<*/ "\n"; 
 		
-		if (by_layer == true){
-			double I_top = env.clim.ppfd_max * env.canopy_openness[ilayer]; 
-			auto res = leaf_assimilation_rate(I_top, fapar, env.clim, par, traits);
-			plant_assim.gpp        += (res.a + res.vcmax*par.rd) * ca_layer;
-			plant_assim.rleaf      += (res.vcmax*par.rd) * ca_layer;
-			plant_assim.trans      += res.e * ca_layer;
-			plant_assim.dpsi_avg   += res.dpsi * ca_layer;
-			plant_assim.vcmax_avg  += res.vcmax * ca_layer;
-			plant_assim.gs_avg     += res.gs * ca_layer;
-			plant_assim.vcmax25_avg += res.vcmax25 * ca_layer;
-			plant_assim.mc_avg     += res.mc * ca_layer;
-		}
+			if (by_layer == true){
+				double I_top = env.clim.ppfd_max * env.canopy_openness[ilayer]; 
+				auto res = leaf_assimilation_rate(I_top, fapar, env.clim, par, traits);
+				plant_assim.gpp        += (res.a + res.vcmax*par.rd) * ca_layer;
+				plant_assim.rleaf      += (res.vcmax*par.rd) * ca_layer;
+				plant_assim.trans      += res.e * ca_layer;
+				plant_assim.dpsi_avg   += res.dpsi * ca_layer;
+				plant_assim.vcmax_avg  += res.vcmax * ca_layer;
+				plant_assim.gs_avg     += res.gs * ca_layer;
+				plant_assim.vcmax25_avg += res.vcmax25 * ca_layer;
+				plant_assim.mc_avg     += res.mc * ca_layer;
+			}
 		
-		plant_assim.c_open_avg += env.canopy_openness[ilayer] * ca_layer;
-		ca_cumm += ca_layer;
+			plant_assim.c_open_avg += env.canopy_openness[ilayer] * ca_layer;
+			ca_cumm += ca_layer;
 		
+		}
+		assert(fabs(ca_cumm/G->crown_area - 1) < 1e-6);
+		plant_assim.c_open_avg /= ca_total;                // unitless
 	}
-	assert(fabs(ca_cumm/G->crown_area - 1) < 1e-6);
-	double ca_total = G->crown_area;                   // total crown area
-	plant_assim.c_open_avg /= ca_total;                // unitless
+	else {
+		plant_assim.c_open_avg = c_open_avg;
+	}
+
 	if (by_layer == true){
 		plant_assim.dpsi_avg   /= ca_total;                // MPa
 		plant_assim.vcmax_avg  /= ca_total;                // umol CO2/m2/s
@@ -101,10 +124,10 @@ void  Assimilator::calc_plant_assimilation_rate(Env &env, PlantGeometry *G, Plan
 
 
 template<class Env>
-PlantAssimilationResult Assimilator::net_production(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits){
+PlantAssimilationResult Assimilator::net_production(Env &env, PlantGeometry *G, PlantParameters &par, PlantTraits &traits, double c_open_avg){
 	plant_assim = PlantAssimilationResult(); // reset plant_assim
 
-	calc_plant_assimilation_rate(env, G, par, traits); // update plant_assim
+	calc_plant_assimilation_rate(env, G, par, traits, c_open_avg); // update plant_assim
 	les_update_lifespans(G->lai, par, traits);
 
 	plant_assim.rleaf = leaf_respiration_rate(G,par,traits);      // kg yr-1  
@@ -126,8 +149,5 @@ PlantAssimilationResult Assimilator::net_production(Env &env, PlantGeometry *G,
 	return plant_assim;
 }
 
-} // namespace plant
-
-
-
 
+} // namespace plant
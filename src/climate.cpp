@@ -6,6 +6,13 @@
 #include <iomanip>
 #include <cmath>
 #include <stdexcept>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <filesystem>
+#include <random>
+#include <cstring>
+#include <cctype>
 
 #include "climate.h"
 
@@ -13,132 +20,423 @@
 namespace env{
 
 
-int Climate::init(){
-	fin_met.open(metFile.c_str());
-	fin_co2.open(co2File.c_str());
-	
-	if (!fin_met){
-		throw std::runtime_error("Could not open file " + metFile);
+// Parse the number in [p, end) up to the next comma or end of line, and move p past the comma. Does not allocate.
+static double next_number(const char *&p, const char *end){
+	char buf[64];
+	int n = 0;
+	while (p < end && *p != ',' && *p != '\n' && *p != '\r'){
+		if (n < 63) buf[n++] = *p;
+		++p;
+	}
+	if (p < end && *p == ',') ++p;
+	buf[n] = '\0';
+	return std::strtod(buf, nullptr);
+}
+
+// Start of the line after the one starting at p
+static const char * next_line(const char *p, const char *end){
+	const char * q = static_cast<const char*>(std::memchr(p, '\n', end-p));
+	return (q)? q+1 : end;
+}
+
+static bool is_blank(const char *p, const char *end){
+	for (; p < end; ++p) if (!isspace(static_cast<unsigned char>(*p))) return false;
+	return true;
+}
+
+static bool is_leap_year(int year){
+	return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// Number of leading time columns in the header of the met file: Year, Month, and optionally Day and Hour
+static int met_time_columns(const char *p, const char *end, const std::string &file){
+	static const char * names[] = {"year", "month", "day", "hour"};
+	int n = 0;
+	while (p < end && n < 4){
+		while (p < end && (*p == ' ' || *p == '"')) ++p;
+		const char * q = p;
+		while (q < end && *q != ',' && *q != '\n' && *q != '\r' && *q != '"' && *q != ' ') ++q;
+		std::string name(p, q);
+		for (auto& c : name) c = std::tolower(static_cast<unsigned char>(c));
+		if (name != names[n]) break;
+		++n;
+		p = q;
+		while (p < end && *p != ',' && *p != '\n') ++p;
+		if (p < end && *p == ',') ++p;
+		else break;
 	}
-	if (!fin_co2){
-		throw std::runtime_error("Could not open file " + co2File);
+	if (n < 2) throw std::runtime_error("Met file " + file + " must start with columns Year, Month[, Day[, Hour]]");
+	return n;
+}
+
+// Parse a line of the met file: time columns (see met_time_columns()), Temp [deg C], VPD [hPa], PPFD, PPFD_max, |SWP| [MPa]
+// Monthly records are at t = year + (month-1)/12. Daily and hourly records are at
+// t = year + (day of year - 1 + hour/24)/(days in year).
+static MetCacheRecord parse_met_line(const char *p, const char *end, int n_time){
+	static const int days_before[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+	MetCacheRecord r;
+	int year  = next_number(p, end);
+	int month = next_number(p, end);
+	if (n_time == 2){
+		r.t = year + (month-1)/12.0;
 	}
-	
-	// skip header
-	std::string line;
-	getline(fin_met, line);
-	getline(fin_co2, line);
+	else {
+		double day  = next_number(p, end);
+		double hour = (n_time > 3)? next_number(p, end) : 0;
+		bool leap = is_leap_year(year);
+		double doy = days_before[std::max(0, std::min(month-1, 11))] + ((leap && month > 2)? 1 : 0) + day;
+		r.t = year + (doy - 1 + hour/24)/((leap)? 366 : 365);
+	}
+	r.tc       = next_number(p, end);
+	r.vpd      = next_number(p, end)*100;  // convert hPa to Pa
+	r.ppfd     = next_number(p, end);
+	r.ppfd_max = next_number(p, end);
+	r.swp      = -next_number(p, end);     // convert to negative (in file it is absolute value)
+	return r;
+}
+
+// Call f(record) for each record of the met file, without holding the whole file in memory
+template <class Func>
+static void for_each_met_record(const std::string &file, Func f){
+	io::MappedFile mf(file);
+	const char * p = mf.data();
+	const char * end = p + mf.size();
+	const char * eol = next_line(p, end);
+	int n_time = met_time_columns(p, eol, file);
+	p = eol;
+	while (p < end){
+		eol = next_line(p, end);
+		if (!is_blank(p, eol)) f(parse_met_line(p, eol, n_time));
+		p = eol;
+	}
+}
+
+
+void ClimateForcing::read(std::string met_file, std::string co2_file, int met_mode){
+	metFile = met_file;
+	co2File = co2_file;
+
+	if (met_mode == MET_CSV){
+		read_met_csv();
+	}
+	else {
+		try{
+			update_met_cache();
+		}
+		catch(const std::runtime_error &e){
+			std::cerr << "Warning: " << e.what() << ". Reading " << metFile << " directly.\n";
+			met_mode = MET_CSV;
+			read_met_csv();
+		}
+		if (met_mode != MET_CSV) read_met_cache(met_mode == MET_STREAM);
+	}
+	if (n_met() < 2) throw std::runtime_error("Met file " + metFile + " must have at least 2 records");
 
-	while (fin_met.peek() != EOF){
+	delta = met_time(n_met()-1) - met_time(0) + met_time(1)-met_time(0)+ 1e-6;
+
+	read_co2_csv();
+
+	prepare();
+}
+
+
+void ClimateForcing::read_met_csv(){
+	for_each_met_record(metFile, [this](const MetCacheRecord &r){
 		Clim clim1;
-		double t1;
-		readNextLine_met(clim1, t1);
-		t_met.push_back(t1);
+		clim1.tc = r.tc;
+		clim1.vpd = r.vpd;
+		clim1.ppfd = r.ppfd;
+		clim1.ppfd_max = r.ppfd_max;
+		clim1.swp = r.swp;
+		t_met.push_back(r.t);
 		v_met.push_back(clim1);
-	}
-	
-	delta = *t_met.rbegin() - *t_met.begin() + t_met[1]-t_met[0]+ 1e-6;
-	
-	// read CO2 file
-	while (fin_co2.peek() != EOF){
-		std::getline(fin_co2, line);
-	
-		std::stringstream lineStream(line);
+	});
+}
 
-		std::string cell;
-		
-		std::getline(lineStream, cell, ',');
-		int year = as<int>(cell);
 
-		std::getline(lineStream, cell, ',');
-		double co2 = as<double>(cell);
-		
-		t_co2.push_back(year);
-		v_co2.push_back(co2);
+void ClimateForcing::read_co2_csv(){
+	io::MappedFile f(co2File);
+	const char * p = f.data();
+	const char * end = p + f.size();
+
+	p = next_line(p, end);  // skip header
+	while (p < end){
+		const char * eol = next_line(p, end);
+		if (!is_blank(p, eol)){
+			const char * q = p;
+			int year = next_number(q, eol);
+			double co2 = next_number(q, eol);
+			t_co2.push_back(year);
+			v_co2.push_back(co2);
+		}
+		p = eol;
 	}
-	
-	return 0;
+}
 
+
+std::string ClimateForcing::met_cache_file(std::string met_file){
+	return met_file + ".pfmet";
 }
 
 
-Clim Climate::interp(Clim &clim_prev, Clim &clim_next){
-	return clim_prev;
+static int64_t mtime_count(std::string file){
+	return std::filesystem::last_write_time(file).time_since_epoch().count();
 }
 
-int Climate::id(double t){
-	int id = (t - *t_met.begin())/delta*t_met.size();
-	id = id % t_met.size();
-	return id;
+
+// (Re)create the binary copy of the met file if it is missing or older than the CSV file.
+// Records are converted one line at a time, so the whole series is never held in memory.
+void ClimateForcing::update_met_cache(){
+	std::string cache = met_cache_file(metFile);
+	uint64_t csv_size = std::filesystem::file_size(metFile);
+	int64_t  csv_mtime = mtime_count(metFile);
+
+	if (std::filesystem::exists(cache)){
+		std::ifstream fin(cache, std::ios::binary);
+		MetCacheHeader h;
+		if (fin.read(reinterpret_cast<char*>(&h), sizeof(h))
+		    && std::string(h.magic) == "PFMET01" && h.record_size == sizeof(MetCacheRecord)
+		    && h.csv_size == csv_size && h.csv_mtime == csv_mtime
+		    && std::filesystem::file_size(cache) == sizeof(h) + h.n_records*h.record_size){
+			return;
+		}
+	}
+
+	std::string tmp = cache + ".tmp" + std::to_string(std::random_device{}());
+	std::ofstream fout(tmp, std::ios::binary);
+	if (!fout) throw std::runtime_error("Could not create climate cache " + tmp);
+
+	MetCacheHeader h{};
+	std::strcpy(h.magic, "PFMET01");
+	h.csv_size = csv_size;
+	h.csv_mtime = csv_mtime;
+	h.record_size = sizeof(MetCacheRecord);
+	fout.write(reinterpret_cast<const char*>(&h), sizeof(h));  // n_records is filled in below
+
+	for_each_met_record(metFile, [&fout, &h](const MetCacheRecord &r){
+		fout.write(reinterpret_cast<const char*>(&r), sizeof(r));
+		++h.n_records;
+	});
+
+	fout.seekp(0);
+	fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	fout.close();
+	if (!fout){
+		std::filesystem::remove(tmp);
+		throw std::runtime_error("Could not write climate cache " + cache);
+	}
+	std::filesystem::rename(tmp, cache);
 }
 
 
-void Climate::updateClimate(double t){
+void ClimateForcing::read_met_cache(bool stream){
+	auto f = std::make_shared<io::MappedFile>(met_cache_file(metFile));
+	MetCacheHeader h;
+	std::memcpy(&h, f->data(), sizeof(h));
+	const char * records = f->data() + sizeof(h);
 
-	// double tadj = t;  // adjusted t to lie between limits of observed data
-	// while(tadj < *t_met.begin()) tadj += delta;
-	if (t_met.size() == 0) throw std::runtime_error("Climate time vector is empty");
-		
-	if (update_met){
-		double tadj = t;  // adjusted t to lie between limits of observed data
-		while(tadj < *t_met.begin()) tadj += delta;
-		int idx_now = id(tadj);
-		int idx_next = (idx_now+1) % t_met.size();
-		clim = interp(v_met[idx_now], v_met[idx_next]);
+	if (stream){
+		met_map = f;
+		met_records = records;
+		n_records = h.n_records;
+	}
+	else {
+		t_met.resize(h.n_records);
+		v_met.resize(h.n_records);
+		for (size_t i=0; i<h.n_records; ++i){
+			MetCacheRecord r;
+			std::memcpy(&r, records + i*sizeof(r), sizeof(r));
+			t_met[i] = r.t;
+			v_met[i].tc = r.tc;
+			v_met[i].vpd = r.vpd;
+			v_met[i].ppfd = r.ppfd;
+			v_met[i].ppfd_max = r.ppfd_max;
+			v_met[i].swp = r.swp;
+		}
 	}
+}
 
-	if (update_co2){
-		int year = int(t);
-		//std::cout << "CO2: " << t << " " << *t_co2.begin() << " " << *t_co2.rbegin() << "\n";
-		if (year >=  *t_co2.begin() && year <= *t_co2.rbegin()){
-			clim.co2 = v_co2[year - t_co2[0]];
-			//std::cout << "Setting co2 @ t = " << year << " from (" << year - t_co2[0] << " / " << v_co2[year - t_co2[0]] << ")\n";
+
+void ClimateForcing::prepare(){
+	size_t n = n_met();
+	uniform = (n >= 2);
+	if (uniform){
+		dt_met = (met_time(n-1) - met_time(0))/(n-1);
+		for (size_t i=1; i<n; ++i){
+			if (std::fabs(met_time(i) - met_time(i-1) - dt_met) > 1e-6*dt_met) { uniform = false; break; }
 		}
-		else if (year > *t_co2.rbegin()) {
-			//std::cout << "Setting co2 @ end \n";
-			clim.co2 = *v_co2.rbegin();
+	}
+	if (!uniform) dt_met = 0;
+}
+
+
+void ClimateForcing::met_position(double t, int &i, double &w) const {
+	int n = n_met();
+	double t0 = met_time(0);
+	double tadj = std::fmod(t - t0, delta);  // bring t within the limits of observed data
+	if (tadj < 0) tadj += delta;
+	if (uniform){
+		i = std::min(int(tadj/delta*n), n-1);
+		w = (tadj - (met_time(i) - t0))/dt_met;  // delta is slightly longer than the series, so i/n is slightly off
+	}
+	else {
+		// e.g. daily records, whose spacing in years differs in leap years
+		i = std::max(met_index_before(t0 + tadj), 0);
+		double t_end = (i+1 < n)? met_time(i+1) : t0 + delta;  // the record after the last one is the first one of the next cycle
+		w = (tadj - (met_time(i) - t0))/(t_end - met_time(i));
+	}
+	w = std::max(0.0, std::min(w, 1.0));
+}
+
+
+bool ClimateForcing::co2_at(double t, double &co2) const {
+	int year = int(t);
+	if (year >= t_co2.front() && year <= t_co2.back()){
+		co2 = v_co2[year - t_co2[0]];
+		return true;
+	}
+	else if (year > t_co2.back()){
+		co2 = v_co2.back();
+		return true;
+	}
+	return false;
+}
+
+
+int ClimateForcing::met_index_before(double t) const {
+	int n = n_met();
+	if (!uniform){
+		// binary search
+		int low = 0, high = n-1, index = -1;
+		while (low <= high){
+			int mid = (low + high)/2;
+			if (met_time(mid) <= t){ index = mid; low = mid+1; }
+			else high = mid-1;
 		}
+		return index;
 	}
 
+	// estimate from the uniform spacing, then correct for rounding
+	double pos = (t - met_time(0))/dt_met;
+	int i = (pos < -1)? -1 : (pos >= n)? n-1 : int(std::floor(pos));
+	while (i+1 < n && met_time(i+1) <= t) ++i;
+	while (i >= 0 && met_time(i) > t) --i;
+	return i;
 }
 
-int Climate::readNextLine_met(Clim &clim, double &t){
 
-	std::string                line, cell;
-	
-	// READ line
-	std::getline(fin_met, line);
+// Forcing read so far (by file names and met mode), with the modification times and sizes of the met and CO2 files 
+// when they were read. Entries are held weakly, so forcing is freed when the last Climate using it is destroyed.
+struct FileStamp{
+	std::filesystem::file_time_type mtime;
+	std::uintmax_t size;
+	bool operator == (const FileStamp &f) const { return mtime == f.mtime && size == f.size; }
+};
+struct ForcingEntry{
+	FileStamp met, co2;
+	std::weak_ptr<const ClimateForcing> forcing;
+};
+static std::mutex forcings_mtx;
+static std::map<std::tuple<std::string, std::string, int>, ForcingEntry> forcings;
+
+
+std::shared_ptr<const ClimateForcing> ClimateForcing::load(std::string met_file, std::string co2_file, int met_mode){
+	std::error_code ec1, ec2, ec3, ec4;
+	FileStamp met = {std::filesystem::last_write_time(met_file, ec1), std::filesystem::file_size(met_file, ec2)};  // if this fails, read() below throws
+	FileStamp co2 = {std::filesystem::last_write_time(co2_file, ec3), std::filesystem::file_size(co2_file, ec4)};
+	bool stamped = !ec1 && !ec2 && !ec3 && !ec4;
+
+	std::lock_guard<std::mutex> lock(forcings_mtx);
+
+	// drop forcing that is no longer used by anyone
+	for (auto it = forcings.begin(); it != forcings.end(); ){
+		if (it->second.forcing.expired()) it = forcings.erase(it);
+		else ++it;
+	}
 
-	std::stringstream          lineStream(line);
-	
-	// PARSE line
-	std::getline(lineStream, cell, ',');
-	int year = as<int>(cell);
-	
-	std::getline(lineStream, cell, ',');
-	int month = as<int>(cell);
+	auto key = std::make_tuple(met_file, co2_file, met_mode);
+	auto it = forcings.find(key);
+	if (stamped && it != forcings.end() && it->second.met == met && it->second.co2 == co2){
+		if (auto f = it->second.forcing.lock()) return f;
+	}
 
-	std::getline(lineStream, cell, ',');
-	clim.tc = as<double>(cell);
-	
-	std::getline(lineStream, cell, ',');
-	clim.vpd = as<double>(cell)*100;  // convert hPa to Pa
-	
-	std::getline(lineStream, cell, ',');
-	clim.ppfd = as<double>(cell);
+	auto f = std::make_shared<ClimateForcing>();
+	f->read(met_file, co2_file, met_mode);
 
-	std::getline(lineStream, cell, ',');
-	clim.ppfd_max = as<double>(cell);
-	
-	std::getline(lineStream, cell, ',');
-	clim.swp = -as<double>(cell);  // convert to negative (in file it is absolute value)
+	forcings[key] = {met, co2, f};
+	return f;
+}
 
-	t = year + (month-1)/12.0;
-		
+
+int Climate::init(){
+	forcing = ClimateForcing::load(metFile, co2File, met_mode);
 	return 0;
 }
 
 
+int Climate::init(std::shared_ptr<const ClimateForcing> _forcing){
+	forcing = _forcing;
+	metFile = forcing->metFile;
+	co2File = forcing->co2File;
+	return 0;
+}
+
+
+Clim Climate::interp(const Clim &clim_prev, const Clim &clim_next, double w){
+	Clim c = clim_prev;
+	c.tc       += w*(clim_next.tc       - clim_prev.tc);
+	c.ppfd_max += w*(clim_next.ppfd_max - clim_prev.ppfd_max);
+	c.ppfd     += w*(clim_next.ppfd     - clim_prev.ppfd);
+	c.vpd      += w*(clim_next.vpd      - clim_prev.vpd);
+	c.swp      += w*(clim_next.swp      - clim_prev.swp);
+	return c;
+}
+
+int Climate::id(double t){
+	int i; double w;
+	forcing->met_position(t, i, w);
+	return i;
+}
+
+
+void Climate::updateClimate(double t){
+
+	if (!forcing || forcing->n_met() == 0) throw std::runtime_error("Climate time vector is empty");
+
+	// computeEnv() is called several times at the same t, so the lookup is done once per t
+	if (t != t_cached || interpolate != interpolate_cached || forcing != forcing_cached){
+		int n = forcing->n_met();
+		double w;
+		int idx_now;
+		forcing->met_position(t, idx_now, w);
+		int idx_next = (idx_now+1) % n;
+		clim_prev = forcing->met_record(idx_now);
+		clim_next = forcing->met_record(idx_next);
+		met_cached = (interpolate)? interp(clim_prev, clim_next, w) : clim_prev;
+		co2_known = forcing->co2_at(t, co2_cached);
+
+		t_prev = forcing->met_time(idx_now);
+		t_next = forcing->met_time(idx_next);
+		t_cached = t;
+		interpolate_cached = interpolate;
+		forcing_cached = forcing;
+	}
+
+	// FIXME: The climate-only terms of Phydro (Gamma*, K_M, viscosity and density of water, vapour pressure terms)
+	//        should be computed here, once per record, and passed to Phydro's lower-level entry points. They are 
+	//        currently recomputed by phydro_analytical() in every call, i.e. for every cohort, so with daily or 
+	//        hourly forcing their cost grows with the number of records.
+	if (update_met){
+		clim = met_cached;
+	}
+
+	if (update_co2){
+		if (co2_known) clim.co2 = co2_cached;
+	}
+
+	t_now = t;
+}
+
 void Climate::print(double t){
 	int year = int(t);
 	double month = (t-int(t))*12;
@@ -148,44 +446,31 @@ void Climate::print(double t){
 
 
 void Climate::print_all(){
-	for (int i = 0; i<t_met.size(); ++i){
-		double t = t_met[i];
+	for (int i = 0; i<forcing->n_met(); ++i){
+		double t = forcing->met_time(i);
+		Clim c = forcing->met_record(i);
 		int year = int(t);
 		double month = (t-int(t))*12;
 		std::cout << "Climate at t = " << t << " (" << year << "/" << month << ")";
-		std::cout << " | " << v_met[i].tc << " " << v_met[i].ppfd      << " " << v_met[i].vpd << "\n"; 
+		std::cout << " | " << c.tc << " " << c.ppfd      << " " << c.vpd << "\n"; 
 	}
 }
 
 int Climate::binarySearch(double k){
-	int low = 0;
-	int len = t_met.size();
-	int high = len - 1;
-	int mid = (high+low)/2;
-	int index = -1;
-	while(low <= high){
-		mid =( low + high ) / 2;
-		if(t_met[mid] <= k){
-			index = mid;
-			low = mid+1;
-		}
-		else{
-			high=mid-1;
-		}
-	}
-	return index;
+	return forcing->met_index_before(k);
 }
 	
 
 double Climate::inst_swp(double year){
-	int i = binarySearch(year);
-	if (i == (t_met.size()-1)){
+	const auto& v_met_swp = forcing->v_met_swp;
+	int i = forcing->met_index_before(year);
+	if (i == (forcing->n_met()-1)){
 		return v_met_swp[i];
 	}
 	else {
-		double x_1 = t_met[i];
+		double x_1 = forcing->met_time(i);
 		double y_1 = v_met_swp[i];
-		int x_2 = t_met[i+1];
+		int x_2 = forcing->met_time(i+1);
 		double y_2 = v_met_swp[i+1];
 		double y = y_1 - (((y_2-y_1)/(x_2-x_1))*(x_1-year));
 		return y;
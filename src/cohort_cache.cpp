@@ -0,0 +1,80 @@
+#include <cmath>
+
+#include "cohort_cache.h"
+#include "crown_kernel.h"
+
+namespace env{
+
+void CohortGeometryCache::Columns::resize(int ncohorts){
+	int nc = ncohorts+1;
+	u.resize(nc);
+	height.resize(nc);
+	crown_area.resize(nc);
+	lai.resize(nc);
+	zm.resize(nc);
+	qm.resize(nc);
+	m.resize(nc);
+	n.resize(nc);
+	fg.resize(nc);
+	k_light.resize(nc);
+}
+
+
+int CohortGeometryCache::Columns::size() const {
+	return u.size();
+}
+
+
+double CohortGeometryCache::Columns::q(int j, double z) const {
+	double H = height[j];
+	if (z > H || z < 0) return 0;
+	else{
+		double zHn_1 = pow(z/H, n[j]-1);
+		double zHn   = zHn_1 * z/H;
+		return m[j]*n[j] * pow(1 - zHn, m[j]-1) * zHn_1;
+	}
+}
+
+
+double CohortGeometryCache::Columns::crown_area_extent_projected(int j, double z) const {
+	if (z >= zm[j]){
+		double fq = q(j,z)/qm[j];
+		return crown_area[j] * fq*fq;
+	}
+	else{
+		return crown_area[j];
+	}
+}
+
+
+double CohortGeometryCache::Columns::crown_area_above(int j, double z) const {
+	if (z == 0) return crown_area[j]; // shortcut because z=0 is used often
+
+	double fq = q(j,z)/qm[j];
+	if (z >= zm[j]){
+		return crown_area[j] * fq*fq * (1-fg[j]);
+	}
+	else{
+		return crown_area[j] * (1 - fq*fq * fg[j]);
+	}
+}
+
+
+void CohortGeometryCache::Columns::crown_area_extent_projected(double z, std::vector<double> &out) const {
+	out.resize(size());
+	crown_kernel::crown_area_above(size(), z, height.data(), crown_area.data(), zm.data(), qm.data(), m.data(), n.data(), nullptr, out.data());
+}
+
+
+void CohortGeometryCache::Columns::crown_area_above(double z, std::vector<double> &out) const {
+	out.resize(size());
+	crown_kernel::crown_area_above(size(), z, height.data(), crown_area.data(), zm.data(), qm.data(), m.data(), n.data(), fg.data(), out.data());
+}
+
+
+void CohortGeometryCache::resize(int nspecies){
+	species.resize(nspecies);
+}
+
+} // namespace env
+
@@ -0,0 +1,517 @@
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include "columnar_io.h"
+
+namespace io{
+
+namespace columnar{
+
+static const char MAGIC[9] = "PFCOL002";
+
+// Adaptive binary range coder (as in LZMA). Probabilities of a 0 bit are 11-bit fixed point, 
+// and move towards each coded bit by 1/16 of the difference.
+class RangeEncoder{
+	uint64_t low = 0;
+	uint32_t range = 0xFFFFFFFF;
+	uint8_t  cache = 0;
+	uint64_t cache_size = 1;
+	std::vector<uint8_t> &out;
+
+	void shift_low(){
+		if (uint32_t(low) < 0xFF000000u || (low >> 32) != 0){
+			uint8_t carry = uint8_t(low >> 32);
+			uint8_t c = cache;
+			do{
+				out.push_back(uint8_t(c + carry));
+				c = 0xFF;
+			} while (--cache_size != 0);
+			cache = uint8_t(low >> 24);
+		}
+		++cache_size;
+		low = (low & 0x00FFFFFF) << 8;
+	}
+
+	public:
+	RangeEncoder(std::vector<uint8_t> &_out) : out(_out) {}
+
+	void encode_bit(uint16_t &p, int bit){
+		uint32_t bound = (range >> 11) * p;
+		if (bit == 0){
+			range = bound;
+			p += (2048 - p) >> 4;
+		}
+		else {
+			low += bound;
+			range -= bound;
+			p -= p >> 4;
+		}
+		while (range < (1u << 24)){
+			range <<= 8;
+			shift_low();
+		}
+	}
+
+	void finish(){
+		for (int i=0; i<5; ++i) shift_low();
+	}
+};
+
+class RangeDecoder{
+	uint32_t range = 0xFFFFFFFF;
+	uint32_t code = 0;
+	const std::vector<uint8_t> &in;
+	size_t pos = 0;
+
+	uint8_t next(){
+		if (pos >= in.size()) throw std::runtime_error("Corrupt column chunk in columnar file");
+		return in[pos++];
+	}
+
+	public:
+	RangeDecoder(const std::vector<uint8_t> &_in) : in(_in) {
+		for (int i=0; i<5; ++i) code = (code << 8) | next();
+	}
+
+	int decode_bit(uint16_t &p){
+		uint32_t bound = (range >> 11) * p;
+		int bit;
+		if (code < bound){
+			range = bound;
+			p += (2048 - p) >> 4;
+			bit = 0;
+		}
+		else {
+			code -= bound;
+			range -= bound;
+			p -= p >> 4;
+			bit = 1;
+		}
+		while (range < (1u << 24)){
+			range <<= 8;
+			code = (code << 8) | next();
+		}
+		return bit;
+	}
+};
+
+// Byte model: a binary tree of bit probabilities, for each context
+struct ByteModel{
+	std::vector<uint16_t> p;
+	ByteModel(int ncontexts) : p(256*ncontexts, 1024) {}
+	uint16_t * tree(int ctx){ return &p[256*ctx]; }
+};
+
+// Bytes of a word are coded in the context of their significance and of the same byte of the previous word
+static const int NCTX_PREV = 4;
+static inline int prev_context(uint8_t prev){
+	return (prev == 0)? 0 : (prev < 16)? 1 : (prev < 128)? 2 : 3;
+}
+
+// Groups bytes of n words of size W by significance, and entropy-codes each group with an adaptive model
+template<int W>
+static std::vector<uint8_t> shuffle_encode(const uint8_t * words, int n){
+	std::vector<uint8_t> out;
+	out.reserve(n*W/4);
+	RangeEncoder rc(out);
+	ByteModel model(W*NCTX_PREV);
+	for (int b=0; b<W; ++b){
+		uint8_t prev = 0;
+		for (int i=0; i<n; ++i){
+			uint8_t c = words[i*W+b];
+			uint16_t * p = model.tree(b*NCTX_PREV + prev_context(prev));
+			int m = 1;
+			for (int k=7; k>=0; --k){
+				int bit = (c >> k) & 1;
+				rc.encode_bit(p[m], bit);
+				m = (m << 1) | bit;
+			}
+			prev = c;
+		}
+	}
+	rc.finish();
+	return out;
+}
+
+template<int W>
+static void decode_unshuffle(const std::vector<uint8_t> &in, int n, uint8_t * words){
+	RangeDecoder rc(in);
+	ByteModel model(W*NCTX_PREV);
+	for (int b=0; b<W; ++b){
+		uint8_t prev = 0;
+		for (int i=0; i<n; ++i){
+			uint16_t * p = model.tree(b*NCTX_PREV + prev_context(prev));
+			int m = 1;
+			for (int k=0; k<8; ++k) m = (m << 1) | rc.decode_bit(p[m]);
+			prev = words[i*W+b] = uint8_t(m);
+		}
+	}
+}
+
+// Words are stored little-endian, independent of the host
+template<class T>
+static void store_le(T v, uint8_t * p){
+	for (int k=0; k<sizeof(T); ++k) p[k] = uint8_t(v >> (8*k));
+}
+
+template<class T>
+static T load_le(const uint8_t * p){
+	T v = 0;
+	for (int k=0; k<sizeof(T); ++k) v |= T(p[k]) << (8*k);
+	return v;
+}
+
+
+// Floating point values are delta-encoded on their bit patterns (zigzag, as for INT32)
+std::vector<uint8_t> encode_float64(const std::vector<double> &v){
+	std::vector<uint8_t> words(8*v.size());
+	uint64_t prev = 0;
+	for (int i=0; i<v.size(); ++i){
+		uint64_t bits;
+		std::memcpy(&bits, &v[i], 8);
+		int64_t d = int64_t(bits - prev);
+		store_le<uint64_t>((uint64_t(d) << 1) ^ uint64_t(d >> 63), &words[8*i]);
+		prev = bits;
+	}
+	return shuffle_encode<8>(words.data(), v.size());
+}
+
+std::vector<double> decode_float64(const std::vector<uint8_t> &b, int n){
+	std::vector<uint8_t> words(8*n);
+	decode_unshuffle<8>(b, n, words.data());
+	std::vector<double> v(n);
+	uint64_t prev = 0;
+	for (int i=0; i<n; ++i){
+		uint64_t z = load_le<uint64_t>(&words[8*i]);
+		uint64_t bits = prev + ((z >> 1) ^ (0ull - (z & 1)));
+		std::memcpy(&v[i], &bits, 8);
+		prev = bits;
+	}
+	return v;
+}
+
+std::vector<uint8_t> encode_float32(const std::vector<float> &v){
+	std::vector<uint8_t> words(4*v.size());
+	uint32_t prev = 0;
+	for (int i=0; i<v.size(); ++i){
+		uint32_t bits;
+		std::memcpy(&bits, &v[i], 4);
+		int32_t d = int32_t(bits - prev);
+		store_le<uint32_t>((uint32_t(d) << 1) ^ uint32_t(d >> 31), &words[4*i]);
+		prev = bits;
+	}
+	return shuffle_encode<4>(words.data(), v.size());
+}
+
+std::vector<float> decode_float32(const std::vector<uint8_t> &b, int n){
+	std::vector<uint8_t> words(4*n);
+	decode_unshuffle<4>(b, n, words.data());
+	std::vector<float> v(n);
+	uint32_t prev = 0;
+	for (int i=0; i<n; ++i){
+		uint32_t z = load_le<uint32_t>(&words[4*i]);
+		uint32_t bits = prev + ((z >> 1) ^ (0u - (z & 1)));
+		std::memcpy(&v[i], &bits, 4);
+		prev = bits;
+	}
+	return v;
+}
+
+std::vector<uint8_t> encode_int32(const std::vector<int32_t> &v){
+	std::vector<uint8_t> words(4*v.size());
+	uint32_t prev = 0;
+	for (int i=0; i<v.size(); ++i){
+		int32_t d = int32_t(uint32_t(v[i]) - prev);                // wraps around, so any delta is representable
+		uint32_t z = (uint32_t(d) << 1) ^ uint32_t(d >> 31);      // zigzag: small negative and positive deltas have small codes
+		store_le<uint32_t>(z, &words[4*i]);
+		prev = uint32_t(v[i]);
+	}
+	return shuffle_encode<4>(words.data(), v.size());
+}
+
+std::vector<int32_t> decode_int32(const std::vector<uint8_t> &b, int n){
+	std::vector<uint8_t> words(4*n);
+	decode_unshuffle<4>(b, n, words.data());
+	std::vector<int32_t> v(n);
+	uint32_t prev = 0;
+	for (int i=0; i<n; ++i){
+		uint32_t z = load_le<uint32_t>(&words[4*i]);
+		uint32_t d = (z >> 1) ^ (0u - (z & 1));
+		prev += d;
+		v[i] = int32_t(prev);
+	}
+	return v;
+}
+
+
+template<class T>
+static void write_le(std::ofstream &fout, T v){
+	uint8_t b[sizeof(T)];
+	store_le<T>(v, b);
+	fout.write((const char*)b, sizeof(T));
+}
+
+template<class T>
+static T read_le(std::ifstream &fin){
+	uint8_t b[sizeof(T)];
+	if (!fin.read((char*)b, sizeof(T))) throw std::runtime_error("Unexpected end of columnar file");
+	return load_le<T>(b);
+}
+
+} // namespace columnar
+
+
+// **********************************************************
+// ********** ColumnWriter **********************************
+// **********************************************************
+
+ColumnWriter::~ColumnWriter(){
+	close();
+}
+
+
+void ColumnWriter::open(const std::string &file, const std::vector<std::pair<std::string, Type>> &schema){
+	using namespace columnar;
+	close();
+	fout.open(file.c_str(), std::ios::out | std::ios::binary);
+	if (!fout) throw std::runtime_error("Could not open output file " + file);
+
+	names.clear();
+	types.clear();
+	for (auto& c : schema){
+		names.push_back(c.first);
+		types.push_back(c.second);
+	}
+	dbuf.assign(names.size(), {});
+	fbuf.assign(names.size(), {});
+	ibuf.assign(names.size(), {});
+	dicts.assign(names.size(), {});
+	new_dict_entries.clear();
+	icol = 0;
+	nrows = 0;
+
+	fout.write(MAGIC, 8);
+	write_le<uint32_t>(fout, names.size());
+	for (int i=0; i<names.size(); ++i){
+		write_le<uint16_t>(fout, names[i].size());
+		fout.write(names[i].data(), names[i].size());
+		write_le<uint8_t>(fout, types[i]);
+	}
+}
+
+
+void ColumnWriter::reopen(const std::string &file, const std::vector<std::pair<std::string, Type>> &schema, double t_max){
+	std::ifstream fin(file.c_str(), std::ios::in | std::ios::binary);
+	if (!fin){
+		open(file, schema);
+		return;
+	}
+	fin.close();
+
+	ColumnReader R;
+	R.read(file);
+	bool same = (R.names.size() == schema.size());
+	for (int i=0; same && i<schema.size(); ++i) same = (R.names[i] == schema[i].first && R.types[i] == schema[i].second);
+	if (!same) throw std::runtime_error("Columns of " + file + " differ from those of the output being continued");
+	if (schema.empty() || schema[0].second == STRING) throw std::runtime_error("Columnar file " + file + " has no numeric first column");
+
+	open(file, schema);
+	for (int r=0; r<R.nrows(); ++r){
+		if (R.numeric[0][r] > t_max) continue;
+		for (int i=0; i<names.size(); ++i){
+			if (types[i] == STRING) (*this) << R.strings[i][r];
+			else                    (*this) << R.numeric[i][r];
+		}
+		end_row();
+	}
+}
+
+
+bool ColumnWriter::is_open() const {
+	return fout.is_open();
+}
+
+
+void ColumnWriter::next_col(){
+	++icol;
+}
+
+
+ColumnWriter& ColumnWriter::operator << (double v){
+	if (icol >= names.size()) throw std::runtime_error("Too many values in row of columnar output");
+	if      (types[icol] == FLOAT64) dbuf[icol].push_back(v);
+	else if (types[icol] == FLOAT32) fbuf[icol].push_back(float(v));
+	else if (types[icol] == INT32)   ibuf[icol].push_back(int32_t(v));
+	else throw std::runtime_error("Numeric value given for string column " + names[icol]);
+	next_col();
+	return *this;
+}
+
+
+ColumnWriter& ColumnWriter::operator << (int v){
+	return (*this) << double(v);
+}
+
+
+ColumnWriter& ColumnWriter::operator << (const std::string &s){
+	if (icol >= names.size()) throw std::runtime_error("Too many values in row of columnar output");
+	if (types[icol] != STRING) throw std::runtime_error("String value given for numeric column " + names[icol]);
+	auto& d = dicts[icol];
+	auto it = d.find(s);
+	int32_t id;
+	if (it == d.end()){
+		id = d.size();
+		d[s] = id;
+		new_dict_entries.push_back({icol, s});
+	}
+	else id = it->second;
+	ibuf[icol].push_back(id);
+	next_col();
+	return *this;
+}
+
+
+void ColumnWriter::end_row(){
+	if (icol != names.size()) throw std::runtime_error("Incomplete row in columnar output");
+	icol = 0;
+	if (++nrows >= chunk_rows) flush();
+}
+
+
+void ColumnWriter::flush(){
+	using namespace columnar;
+	if (!fout.is_open()) return;
+
+	for (auto& e : new_dict_entries){
+		write_le<uint8_t>(fout, 'D');
+		write_le<uint32_t>(fout, e.first);
+		write_le<uint32_t>(fout, e.second.size());
+		fout.write(e.second.data(), e.second.size());
+	}
+	new_dict_entries.clear();
+
+	if (nrows > 0){
+		write_le<uint8_t>(fout, 'C');
+		write_le<uint32_t>(fout, nrows);
+		for (int i=0; i<names.size(); ++i){
+			std::vector<uint8_t> b;
+			if      (types[i] == FLOAT64) b = encode_float64(dbuf[i]);
+			else if (types[i] == FLOAT32) b = encode_float32(fbuf[i]);
+			else                          b = encode_int32(ibuf[i]);
+			write_le<uint32_t>(fout, b.size());
+			fout.write((const char*)b.data(), b.size());
+			dbuf[i].clear();
+			fbuf[i].clear();
+			ibuf[i].clear();
+		}
+		nrows = 0;
+	}
+	fout.flush();
+}
+
+
+void ColumnWriter::close(){
+	if (!fout.is_open()) return;
+	flush();
+	fout.close();
+}
+
+
+// **********************************************************
+// ********** ColumnReader **********************************
+// **********************************************************
+
+void ColumnReader::read(const std::string &file){
+	using namespace columnar;
+	std::ifstream fin(file.c_str(), std::ios::in | std::ios::binary);
+	if (!fin) throw std::runtime_error("Could not open columnar file " + file);
+
+	char magic[8];
+	if (!fin.read(magic, 8) || std::memcmp(magic, MAGIC, 8) != 0) throw std::runtime_error(file + " is not a Plant-FATE columnar file");
+
+	int ncols = read_le<uint32_t>(fin);
+	names.resize(ncols);
+	types.resize(ncols);
+	for (int i=0; i<ncols; ++i){
+		int len = read_le<uint16_t>(fin);
+		names[i].resize(len);
+		if (!fin.read(&names[i][0], len)) throw std::runtime_error("Unexpected end of columnar file " + file);
+		types[i] = ColumnWriter::Type(read_le<uint8_t>(fin));
+		if (types[i] > ColumnWriter::FLOAT32) throw std::runtime_error("Unknown column type in " + file);
+	}
+
+	numeric.assign(ncols, {});
+	strings.assign(ncols, {});
+	std::vector<std::vector<std::string>> dicts(ncols);
+
+	while (true){
+		int tag = fin.get();
+		if (tag == EOF) break;
+		if (tag == 'D'){
+			int col = read_le<uint32_t>(fin);
+			int len = read_le<uint32_t>(fin);
+			std::string s(len, ' ');
+			if (!fin.read(&s[0], len)) throw std::runtime_error("Unexpected end of columnar file " + file);
+			if (col >= ncols) throw std::runtime_error("Corrupt dictionary entry in " + file);
+			dicts[col].push_back(s);
+		}
+		else if (tag == 'C'){
+			int n = read_le<uint32_t>(fin);
+			for (int i=0; i<ncols; ++i){
+				std::vector<uint8_t> b(read_le<uint32_t>(fin));
+				if (!fin.read((char*)b.data(), b.size())) throw std::runtime_error("Unexpected end of columnar file " + file);
+				if (types[i] == ColumnWriter::FLOAT64){
+					auto v = decode_float64(b, n);
+					numeric[i].insert(numeric[i].end(), v.begin(), v.end());
+				}
+				else if (types[i] == ColumnWriter::FLOAT32){
+					auto v = decode_float32(b, n);
+					numeric[i].insert(numeric[i].end(), v.begin(), v.end());
+				}
+				else if (types[i] == ColumnWriter::INT32){
+					auto v = decode_int32(b, n);
+					numeric[i].insert(numeric[i].end(), v.begin(), v.end());
+				}
+				else {
+					auto v = decode_int32(b, n);
+					for (auto id : v){
+						if (id < 0 || id >= dicts[i].size()) throw std::runtime_error("Corrupt string column in " + file);
+						strings[i].push_back(dicts[i][id]);
+					}
+				}
+			}
+		}
+		else throw std::runtime_error("Corrupt block in columnar file " + file);
+	}
+}
+
+
+int ColumnReader::col_index(const std::string &name) const {
+	auto it = std::find(names.begin(), names.end(), name);
+	if (it == names.end()) throw std::runtime_error("Column " + name + " not found");
+	return it - names.begin();
+}
+
+
+int ColumnReader::nrows() const {
+	if (names.empty()) return 0;
+	return (types[0] == ColumnWriter::STRING)? strings[0].size() : numeric[0].size();
+}
+
+
+const std::vector<double>& ColumnReader::get_numeric(const std::string &name) const {
+	int i = col_index(name);
+	if (types[i] == ColumnWriter::STRING) throw std::runtime_error("Column " + name + " is not numeric");
+	return numeric[i];
+}
+
+
+const std::vector<std::string>& ColumnReader::get_string(const std::string &name) const {
+	int i = col_index(name);
+	if (types[i] != ColumnWriter::STRING) throw std::runtime_error("Column " + name + " is not a string column");
+	return strings[i];
+}
+
+} // namespace io
+
@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include "community_properties.h"
 
 using namespace std;
@@ -75,127 +76,202 @@ bool SpeciesProps::isResident(Species_Base * spp){
 }
 
 void SpeciesProps::update(double t, Solver &S){
-		
-	n_ind_vec.clear();
-	n_ind_vec.resize(S.n_species(), 0);
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		n_ind_vec[k] = S.integrate_x([&S,k](int i, double t){
-											return 1;
-									}, t, k);
-	n_ind = std::accumulate(n_ind_vec.begin(), n_ind_vec.end(), 0.0);
+	CommunityIntegrals ci;
+	ci.compute(t, S);
+	update(t, S, ci);
+}
 
-	biomass_vec.clear();
-	biomass_vec.resize(S.n_species(), 0);
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		biomass_vec[k] = S.integrate_wudx_above([&S,k](int i, double t){
-											auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-											return p.get_biomass();
-									}, t, 0.1, k);
-	biomass = std::accumulate(biomass_vec.begin(), biomass_vec.end(), 0.0);
 
-	ba_vec.clear();
-	ba_vec.resize(S.n_species(), 0);
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		ba_vec[k] = S.integrate_wudx_above([&S,k](int i, double t){
-											auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-											double D = p.geometry.diameter_at_height(1.3, p.traits);
-											return M_PI*D*D/4;
-									}, t, 0.1, k);
-	ba = std::accumulate(ba_vec.begin(), ba_vec.end(), 0.0);
+void SpeciesProps::update(double t, Solver &S, const CommunityIntegrals &ci){
+	PF_PROFILE_SCOPE(SPECIES_PROPS);
+	typedef SpeciesIntegrals SI;
+	int n = S.n_species();
 
+	n_ind_vec.clear();
+	n_ind_vec.resize(n, 0);
+	biomass_vec.clear();
+	biomass_vec.resize(n, 0);
+	ba_vec.clear();
+	ba_vec.resize(n, 0);
 	canopy_area_vec.clear();
-	canopy_area_vec.resize(S.n_species(), 0);
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		canopy_area_vec[k] = S.integrate_x([&S,k](int i, double t){
-											auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i).geometry;
-											return p.crown_area;
-									}, t, k);
-	canopy_area = std::accumulate(canopy_area_vec.begin(), canopy_area_vec.end(), 0.0);
-	
-
+	canopy_area_vec.resize(n, 0);
 	height_vec.clear();
-	height_vec.resize(S.n_species(), 0);
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		height_vec[k] = S.integrate_x([&S,k](int i, double t){
-											auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-											return p.geometry.height;
-									}, t, k);
-									
-	for (int k=0; k<S.n_species(); ++k) height_vec[k] /= n_ind_vec[k];
+	height_vec.resize(n, 0);
+	vcmax_vec.clear();
+	vcmax_vec.resize(n, 0);
 
+	gs = 0;
+	for (int k=0; k<n; ++k){
+		auto& I = ci.species[k];
+		if (!I.resident) continue;
+		n_ind_vec[k]       = I.all[SI::N_IND];
+		biomass_vec[k]     = I.above[SI::BIOMASS];
+		ba_vec[k]          = I.above[SI::BA];
+		canopy_area_vec[k] = I.all[SI::CROWN_AREA];
+		height_vec[k]      = I.all[SI::HEIGHT];
+		vcmax_vec[k]       = I.above[SI::VCMAX];
+		gs                += I.all[SI::GS];
+	}
 
+	n_ind = std::accumulate(n_ind_vec.begin(), n_ind_vec.end(), 0.0);
+	biomass = std::accumulate(biomass_vec.begin(), biomass_vec.end(), 0.0);
+	ba = std::accumulate(ba_vec.begin(), ba_vec.end(), 0.0);
+	canopy_area = std::accumulate(canopy_area_vec.begin(), canopy_area_vec.end(), 0.0);
+	for (int k=0; k<n; ++k) height_vec[k] /= n_ind_vec[k];
+
+	// Species-mean traits are currently not calculated
 	hmat = 0;
-	// for (int k=0; k<S.n_species(); ++k)
-	// 	hmat += S.integrate_x([&S,k](int i, double t){
-	// 								      auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-	// 								      return p.traits.hmat;
-	// 								}, t, k);
-	// hmat /= n_ind;
 	hmat_vec.clear();
-	hmat_vec.resize(S.n_species(), 0);
-	// for (int k=0; k<S.n_species(); ++k) hmat_vec[k] = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(-1).traits.hmat;
-
-
+	hmat_vec.resize(n, 0);
 	lma = 0;
-	// for (int k=0; k<S.n_species(); ++k)
-	// 	lma += S.integrate_x([&S,k](int i, double t){
-	// 								      auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-	// 								      return p.traits.lma;
-	// 								}, t, k);
-	// lma /= n_ind;
 	lma_vec.clear();
-	lma_vec.resize(S.n_species(), 0);
-	// for (int k=0; k<S.n_species(); ++k) lma_vec[k] = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(-1).traits.lma;
-
+	lma_vec.resize(n, 0);
 	wd = 0;
-	// for (int k=0; k<S.n_species(); ++k)
-	// 	wd += S.integrate_x([&S,k](int i, double t){
-	// 								      auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-	// 								      return p.traits.wood_density;
-	// 								}, t, k);
-	// wd /= n_ind;
 	wd_vec.clear();
-	wd_vec.resize(S.n_species(), 0);
-	// for (int k=0; k<S.n_species(); ++k) wd_vec[k] = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(-1).traits.wood_density;
-
+	wd_vec.resize(n, 0);
 	p50 = 0;
-	// for (int k=0; k<S.n_species(); ++k)
-	// 	p50 += S.integrate_x([&S,k](int i, double t){
-	// 								      auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-	// 								      return p.traits.p50_xylem;
-	// 								}, t, k);
-	// p50 /= n_ind;
 	p50_vec.clear();
-	p50_vec.resize(S.n_species(), 0);
-	// for (int k=0; k<S.n_species(); ++k) p50_vec[k] = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(-1).traits.p50_xylem;
+	p50_vec.resize(n, 0);
 
-	gs = 0;
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		gs += S.integrate_x([&S,k](int i, double t){
-											auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-											return p.res.gs_avg * p.geometry.crown_area;
-									}, t, k);
 	gs /= canopy_area;
-
-	vcmax_vec.clear();
-	vcmax_vec.resize(S.n_species(), 0);
-	for (int k=0; k<S.n_species(); ++k)
-		if (isResident(S.species_vec[k]))
-		vcmax_vec[k] = S.integrate_wudx_above([&S,k](int i, double t){
-											auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-											return p.res.vcmax_avg * p.geometry.crown_area;
-									}, t, 0.1, k);
 	vcmax = std::accumulate(vcmax_vec.begin(), vcmax_vec.end(), 0.0);
 	vcmax /= canopy_area;
 }
 
 
+// **********************************************************
+// ********** CommunityIntegrals ****************************
+// **********************************************************
+
+/// @brief      Compute integrals of all diagnostics for all species.
+/// @param t    Current time
+/// @param S    Solver
+/// @details    Refreshes the cohort geometry cache of this object, since cohorts may have changed 
+///             since the environment was last computed.
+void CommunityIntegrals::compute(double t, Solver &S){
+	auto E = static_cast<PSPM_Dynamic_Environment*>(S.env);
+	PSPM_Dynamic_Environment::fill_cohort_cache(&S, cache);
+
+	int n = S.n_species();
+	species.clear();
+	species.resize(n);
+	values.resize(n);
+	u_above.assign(n, 0);
+	for (int k=0; k<n; ++k){
+		species[k].resident = cache.species[k].resident;
+		species[k].lai_vert.resize(n_lai_vert, 0);
+	}
+
+	auto sweep = [this, &S](int k){
+		if (species[k].resident) sweep_fused(S, k);
+	};
+	ThreadPool * pool = E->get_thread_pool();
+	if (pool) pool->parallel_for(n, sweep);
+	else for (int k=0; k<n; ++k) sweep(k);
+
+	// Check weights serially, since the solver's integrals may not be thread-safe
+	for (int k=0; k<n; ++k){
+		auto& I = species[k];
+		if (!I.resident) continue;
+		I.fused = weights_match(t, S, k);
+		if (!I.fused) sweep_solver(t, S, k);
+	}
+}
+
+
+/// Number of values per cohort: quantities integrated over all sizes, above x_above, and the LAI profile
+int CommunityIntegrals::n_values() const {
+	return SpeciesIntegrals::N_ALL + SpeciesIntegrals::N_ABOVE + n_lai_vert;
+}
+
+/// Values of cohort i of species k
+double* CommunityIntegrals::row(int k, int i){
+	return &values[k][(i+1)*n_values()];
+}
+
+
+bool CommunityIntegrals::weights_match(double t, Solver &S, int k){
+	typedef SpeciesIntegrals SI;
+	auto& I = species[k];
+	auto match = [](double a, double b){ return fabs(a-b) <= 1e-10*std::max(1.0, fabs(b)); };
+
+	double I_all     = S.integrate_x([this,k](int i, double t){ return row(k,i)[SI::N_IND]; }, t, k);
+	double I_ca      = S.integrate_x([this,k](int i, double t){ return row(k,i)[SI::CROWN_AREA]; }, t, k);
+	double I_above   = S.integrate_wudx_above([](int i, double t){ return 1; }, t, x_above, k);
+	double I_biomass = S.integrate_wudx_above([this,k](int i, double t){ return row(k,i)[SI::N_ALL+SI::BIOMASS]; }, t, x_above, k);
+
+	return match(I.all[SI::N_IND], I_all) && match(I.all[SI::CROWN_AREA], I_ca) 
+	    && match(u_above[k], I_above) && match(I.above[SI::BIOMASS], I_biomass);
+}
+
+
+/// @param all       Output: values of quantities integrated over all sizes
+/// @param above     Output: values of quantities integrated over sizes above x_above
+/// @param lai_vert  Output: leaf area above each height of the LAI profile
+void CommunityIntegrals::cohort_values(PSPM_Plant &p, const env::CohortGeometryCache::Columns &c, int j, double * all, double * above, double * lai_vert){
+	typedef SpeciesIntegrals SI;
+	all[SI::N_IND]      = 1;
+	all[SI::CROWN_AREA] = p.geometry.crown_area;
+	all[SI::HEIGHT]     = p.geometry.height;
+	all[SI::GS]         = p.res.gs_avg * p.geometry.crown_area;
+	all[SI::GPP]        = p.res.gpp;
+	all[SI::NPP]        = p.res.npp;
+	all[SI::TRANS]      = p.res.trans;
+	all[SI::RESP_AUTO]  = p.res.rleaf + p.res.rroot + p.res.rstem;
+	all[SI::LAI]        = c.crown_area[j]*c.lai[j];
+	all[SI::LEAF_MASS]  = p.geometry.leaf_mass(p.traits);
+	all[SI::STEM_MASS]  = p.geometry.stem_mass(p.traits);
+	all[SI::CROOT_MASS] = p.geometry.coarse_root_mass(p.traits);
+	all[SI::FROOT_MASS] = p.geometry.root_mass(p.traits);
+	all[SI::TLEAF]      = p.res.tleaf;
+	all[SI::TROOT]      = p.res.troot;
+
+	double D = p.geometry.diameter_at_height(1.3, p.traits);
+	above[SI::BIOMASS]  = p.get_biomass();
+	above[SI::BA]       = M_PI*D*D/4;
+	above[SI::VCMAX]    = p.res.vcmax_avg * p.geometry.crown_area;
+
+	for (int iz=0; iz<n_lai_vert; ++iz) lai_vert[iz] = c.crown_area_above(j, iz)*c.lai[j];
+}
+
+
+// Evaluate all quantities once per cohort, and accumulate them weighted by cohort density
+void CommunityIntegrals::sweep_fused(Solver &S, int k){
+	typedef SpeciesIntegrals SI;
+	auto spp = static_cast<MySpecies<PSPM_Plant>*>(S.species_vec[k]);
+	auto& c = cache.species[k];
+	auto& I = species[k];
+	values[k].resize((spp->xsize()+1)*n_values());
+
+	for (int i=-1; i<spp->xsize(); ++i){
+		auto& p = spp->getCohort(i);
+		double u = spp->getU(i);
+		double * all = row(k,i), * above = all + SI::N_ALL, * lv = above + SI::N_ABOVE;
+		cohort_values(p, c, c.col(i), all, above, lv);
+		for (int m=0; m<SI::N_ALL; ++m) I.all[m] += u*all[m];
+		if (p.x >= x_above){
+			for (int m=0; m<SI::N_ABOVE; ++m) I.above[m] += u*above[m];
+			u_above[k] += u;
+		}
+		for (int iz=0; iz<n_lai_vert; ++iz) I.lai_vert[iz] += u*lv[iz];
+	}
+}
+
+
+// One solver integral per quantity, used when cohort densities do not reproduce the solver's integrals.
+// Cohort values are taken from sweep_fused().
+void CommunityIntegrals::sweep_solver(double t, Solver &S, int k){
+	typedef SpeciesIntegrals SI;
+	auto& I = species[k];
+	for (int m=0; m<SI::N_ALL; ++m)
+		I.all[m] = S.integrate_x([this, k, m](int i, double t){ return row(k,i)[m]; }, t, k);
+	for (int m=0; m<SI::N_ABOVE; ++m)
+		I.above[m] = S.integrate_wudx_above([this, k, m](int i, double t){ return row(k,i)[SI::N_ALL+m]; }, t, x_above, k);
+	for (int iz=0; iz<n_lai_vert; ++iz)
+		I.lai_vert[iz] = S.integrate_x([this, k, iz](int i, double t){ return row(k,i)[SI::N_ALL+SI::N_ABOVE+iz]; }, t, k);
+}
+
+
 SpeciesProps operator + (SpeciesProps lhs, SpeciesProps &rhs){
 	lhs += rhs;
 	return lhs;
@@ -244,33 +320,39 @@ bool EmergentProps::isResident(Species_Base * spp){
 
 
 void EmergentProps::update(double t, Solver &S){
-	gpp = integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.gpp;});
-	npp = integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.npp;});
-	trans = integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.trans;});
-	resp_auto = integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.rleaf + p->res.rroot + p->res.rstem;});
-	lai = integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.crown_area*p->geometry.lai;});
-	leaf_mass = integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.leaf_mass(p->traits);});
-	stem_mass = integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.stem_mass(p->traits);});
-	croot_mass = integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.coarse_root_mass(p->traits);});
-	froot_mass = integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.root_mass(p->traits);});
-	gs = (trans*55.55/365/86400)/1.6/(static_cast<PSPM_Dynamic_Environment*>(S.env)->clim.vpd/1.0325e5);
-	//     ^ convert kg/m2/yr --> mol/m2/s
+	CommunityIntegrals ci;
+	ci.compute(t, S);
+	update(t, S, ci);
+}
 
-	double tleaf_comm = integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.tleaf;});
-	double troot_comm = integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.troot;});
-	cc_est = (tleaf_comm + troot_comm + resp_auto)/tleaf_comm;
 
-	// LAI vertical profile
+void EmergentProps::update(double t, Solver &S, const CommunityIntegrals &ci){
+	PF_PROFILE_SCOPE(EMERGENT_PROPS);
+	typedef SpeciesIntegrals SI;
+	std::array<double, SI::N_ALL> x{};
 	lai_vert.clear();
-	lai_vert.resize(25, 0);
-	for (int iz=0; iz<25; ++iz)
-		for (int k=0; k<S.n_species(); ++k)
-			if (isResident(S.species_vec[k]))
-			lai_vert[iz] += S.integrate_x([&S,k,iz](int i, double t){
-									auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
-									return p.geometry.crown_area_above(iz,p.traits)*p.geometry.lai;
-							}, t, k);
+	lai_vert.resize(ci.n_lai_vert, 0);
+	for (auto& I : ci.species){
+		if (!I.resident) continue;
+		for (int j=0; j<SI::N_ALL; ++j) x[j] += I.all[j];
+		for (int iz=0; iz<ci.n_lai_vert; ++iz) lai_vert[iz] += I.lai_vert[iz];
+	}
+
+	gpp = x[SI::GPP];
+	npp = x[SI::NPP];
+	trans = x[SI::TRANS];
+	resp_auto = x[SI::RESP_AUTO];
+	lai = x[SI::LAI];
+	leaf_mass = x[SI::LEAF_MASS];
+	stem_mass = x[SI::STEM_MASS];
+	croot_mass = x[SI::CROOT_MASS];
+	froot_mass = x[SI::FROOT_MASS];
+	gs = (trans*55.55/365/86400)/1.6/(static_cast<PSPM_Dynamic_Environment*>(S.env)->clim.vpd/1.0325e5);
+	//     ^ convert kg/m2/yr --> mol/m2/s
 
+	double tleaf_comm = x[SI::TLEAF];
+	double troot_comm = x[SI::TROOT];
+	cc_est = (tleaf_comm + troot_comm + resp_auto)/tleaf_comm;
 }
 
 
@@ -282,14 +364,96 @@ EmergentProps operator + (EmergentProps lhs, EmergentProps &rhs){
 
 
 
+const std::string SolverIO::emergent_props_header = "YEAR\tDOY\tGPP\tNPP\tRAU\tCL\tCW\tCCR\tCFR\tCR\tGS\tET\tLAI\tVCMAX\tCCEST\n";
+const std::string SolverIO::cwm_header = "YEAR\tPID\tDE\tOC\tPH\tMH\tCA\tBA\tTB\tWD\tMO\tSLA\tP50\n";
+
+
+void SolverIO::write_emergent_props(std::ostream &fout, double t, const SpeciesProps &cwm, const EmergentProps &props){
+	fout << int(t) << "\t"
+			<< (t-int(t))*365 << "\t"
+			<< props.gpp*0.5/365*1000 << "\t"
+			<< props.npp*0.5/365*1000 << "\t"
+			<< props.resp_auto*0.5/365*1000 << "\t"  // gC/m2/d
+			<< props.leaf_mass*1000*0.5 << "\t"     
+			<< props.stem_mass*1000*0.5 << "\t"
+			<< props.croot_mass*1000*0.5 << "\t"
+			<< props.froot_mass*1000*0.5 << "\t"
+			<< (props.croot_mass+props.froot_mass)*1000*0.5 << "\t" // gC/m2
+			<< cwm.gs << "\t"
+			<< props.trans/365 << "\t"   // kg/m2/yr --> 1e-3 m3/m2/yr --> 1e-3*1e3 mm/yr --> 1/365 mm/day  
+			<< props.lai << "\t"
+			<< cwm.vcmax << "\t"
+			<< props.cc_est << std::endl;
+}
+
+
+void SolverIO::write_cwm(std::ostream &fout, double t, const SpeciesProps &cwm){
+	fout << int(t) << "\t"
+			<< -9999  << "\t"
+			<< cwm.n_ind << "\t"
+			<< -9999  << "\t"
+			<< cwm.height  << "\t"
+			<< cwm.hmat  << "\t"
+			<< cwm.canopy_area  << "\t"   // m2/m2
+			<< cwm.ba  << "\t"            // m2/m2
+			<< cwm.biomass  << "\t"       // kg/m2
+			<< cwm.wd  << "\t"
+			<< -9999  << "\t"
+			<< 1/cwm.lma  << "\t"
+			<< cwm.p50  << std::endl;
+}
+
+
+/// @brief   Open a text output file. Returns true if the file is new, and its header must be written.
+/// @details If `resume_output` is set and the file exists, rows with time (first column) later than `resume_time`,
+///          and an incomplete last line, are dropped, and the file is opened for appending.
+bool SolverIO::open_text(std::ofstream &fout, const std::string &file){
+	if (resume_output){
+		std::ifstream fin(file.c_str());
+		if (fin){
+			std::vector<std::string> lines;
+			std::string line;
+			while (std::getline(fin, line)){
+				if (fin.eof()) break;  // no newline: line was not completely written
+				const char * begin = line.c_str();
+				char * end;
+				double t = std::strtod(begin, &end);
+				if (end == begin || t <= resume_time) lines.push_back(line);  // headers are kept
+			}
+			fin.close();
+
+			std::ofstream ftrunc(file.c_str());
+			for (auto& l : lines) ftrunc << l << "\n";
+			ftrunc.close();
+
+			fout.open(file.c_str(), std::ios::app);
+			return false;
+		}
+	}
+	fout.open(file.c_str());
+	return true;
+}
+
+
+void SolverIO::open_binary(io::ColumnWriter &fout, const std::string &file, const std::vector<std::pair<std::string, io::ColumnWriter::Type>> &schema){
+	if (resume_output) fout.reopen(file, schema, resume_time);
+	else fout.open(file, schema);
+}
+
+
 void SolverIO::openStreams(std::string dir, io::Initializer &I){
+	if (binary_output){
+		openStreams_binary(dir, I);
+		return;
+	}
 
-	cohort_props_out.open(dir + "/cohort_props.txt");
-	cohort_props_out << "t\tspeciesID\tcohortID\t";
-	for (auto vname : varnames) cohort_props_out << vname << "\t";
-	cohort_props_out << std::endl;
+	if (open_text(cohort_props_out, dir + "/cohort_props.txt")){
+		cohort_props_out << "t\tspeciesID\tcohortID\t";
+		for (auto vname : varnames) cohort_props_out << vname << "\t";
+		cohort_props_out << std::endl;
+	}
 
-	size_dists_out.open(dir + "/size_distributions.txt");
+	open_text(size_dists_out, dir + "/size_distributions.txt");
 
 	// varnames.insert(varnames.begin(), "u");
 	// varnames.insert(varnames.begin(), "X");
@@ -309,24 +473,21 @@ void SolverIO::openStreams(std::string dir, io::Initializer &I){
 	// 	streams.push_back(std::move(spp_streams));
 	// }
 
-	fzst.open(std::string(dir + "/z_star.txt").c_str());
-	fco.open(std::string(dir + "/canopy_openness.txt").c_str());
+	open_text(fzst, dir + "/z_star.txt");
+	open_text(fco, dir + "/canopy_openness.txt");
 	// fseed.open(std::string(dir + "/seeds.txt").c_str());
 	// fabase.open(std::string(dir + "/basal_area.txt").c_str());
-	flai.open(std::string(dir + "/lai_profile.txt").c_str());
-	foutd.open(std::string(dir + "/" + I.get<std::string>("emgProps")).c_str());
-	fouty.open(std::string(dir + "/" + I.get<std::string>("cwmAvg")).c_str());
-	fouty_spp.open(std::string(dir + "/" + I.get<std::string>("cwmperSpecies")).c_str());
-	ftraits.open(std::string(dir + "/" + I.get<std::string>("traits")).c_str());
-
-	foutd << "YEAR\tDOY\tGPP\tNPP\tRAU\tCL\tCW\tCCR\tCFR\tCR\tGS\tET\tLAI\tVCMAX\tCCEST\n";
-	fouty << "YEAR\tPID\tDE\tOC\tPH\tMH\tCA\tBA\tTB\tWD\tMO\tSLA\tP50\n";
-	fouty_spp << "YEAR\tPID\tDE\tOC\tPH\tMH\tCA\tBA\tTB\tWD\tMO\tSLA\tP50\tSEEDS\n";
-	ftraits << "YEAR\tSPP\tRES\tLMA\tWD\tr0_last\tr0_avg\tr0_exp\tr0_cesaro\n";
+	open_text(flai, dir + "/lai_profile.txt");
+	if (open_text(foutd, dir + "/" + I.get<std::string>("emgProps"))) foutd << emergent_props_header;
+	if (open_text(fouty, dir + "/" + I.get<std::string>("cwmAvg"))) fouty << cwm_header;
+	if (open_text(fouty_spp, dir + "/" + I.get<std::string>("cwmperSpecies"))) fouty_spp << "YEAR\tPID\tDE\tOC\tPH\tMH\tCA\tBA\tTB\tWD\tMO\tSLA\tP50\tSEEDS\n";
+	if (open_text(ftraits, dir + "/" + I.get<std::string>("traits"))) ftraits << "YEAR\tSPP\tRES\tLMA\tWD\tr0_last\tr0_avg\tr0_exp\tr0_cesaro\n";
 
 }
 
 void SolverIO::closeStreams(){
+	stop_writer();  // writes all pending snapshots
+
 	// for (int s=0; s<streams.size(); ++s){
 	// 	for (int j=0; j<streams[s].size(); ++j){
 	// 		streams[s][j].close();
@@ -345,96 +506,158 @@ void SolverIO::closeStreams(){
 	fouty_spp.close();
 	ftraits.close();
 
+	cohort_props_bin.close();
+	size_dists_bin.close();
+	zst_bin.close();
+	co_bin.close();
+	lai_bin.close();
+	emg_bin.close();
+	cwm_bin.close();
+	cwm_spp_bin.close();
+	traits_bin.close();
+
+	if (writer_error) std::rethrow_exception(writer_error);
 }
 
-void SolverIO::writeState(double t, SpeciesProps& cwm, EmergentProps& props){
-	for (int s=0; s < S->species_vec.size(); ++s){
-		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[s]);
 
-		// for (int i=0; i<streams[s].size(); ++i) streams[s][i] << t << "\t";
+/// @brief   Copy everything that is written to the output files at time t.
+/// @details This reads the solver and the environment, so it must be called from the simulation thread.
+OutputSnapshot SolverIO::snapshot(double t, const SpeciesProps& cwm, const EmergentProps& props){
+	OutputSnapshot o;
+	o.t = t;
+	o.cwm = cwm;
+	o.props = props;
 
-		std::vector<double> breaks = my_log_seq(0.01, 10, 100);
-		std::vector<double> dist = S->getDensitySpecies(s, breaks);
-		//cout << "here: " << breaks.size() << " " << dist.size() << endl;
+	std::vector<double> breaks = my_log_seq(0.01, 10, 100);
+	for (int s=0; s < S->species_vec.size(); ++s){
+		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[s]);
+		OutputSnapshot::Species os;
+		os.name = spp->species_name;
+		os.resident = spp->isResident;
+		os.traits = spp->get_traits();
+		os.trait_names = spp->trait_names;
+		os.r0_last = spp->r0_hist.get_last();
+		os.r0_avg = spp->r0_hist.get();
+		os.r0_exp = spp->r0_hist.get_exp(0.02);
+		os.seeds = spp->seeds_hist.get();
 
 		if (spp->isResident){
-			size_dists_out << t << "\t" << spp->species_name << "\t";
-			for (int i=0; i<100; ++i){
-				// streams[s][0] << breaks[i] << "\t";
-				// streams[s][1] << dist[i] << "\t";
-				size_dists_out << dist[i] << "\t";
+			os.size_dist = S->getDensitySpecies(s, breaks);
+			for (int j=0; j<spp->xsize()-1; ++j){
+				auto& C = spp->getCohort(j);
+				os.cohorts.push_back({C.geometry.height, C.geometry.lai, C.rates.dmort_dt, C.rates.dseeds_dt, C.rates.rgr, C.res.gpp/C.geometry.crown_area});
 			}
-			size_dists_out << "\n";
 		}
+		o.species.push_back(std::move(os));
+	}
 
-		// for (int j=0; j<spp->xsize(); ++j){
-		// 	auto& C = spp->getCohort(j);
-		// 	int is = 2;
-		// 	//streams[s][is++] << C.x << "\t";
-		// 	//streams[s][is++] << C.u << "\t";
-		// 	streams[s][is++] << C.geometry.height << "\t";
-		// 	streams[s][is++] << C.geometry.lai << "\t";
-		// 	streams[s][is++] << C.rates.dmort_dt << "\t";
-		// 	streams[s][is++] << C.state.seed_pool << "\t";
-		// 	streams[s][is++] << C.rates.rgr << "\t";
-		// 	streams[s][is++] << C.res.gpp/C.geometry.crown_area << "\t";
-
-		// }
-		
-		// for (int i=0; i<streams[s].size(); ++i) streams[s][i] << endl; //"\n";
-	
-		if (spp->isResident){
-			for (int j=0; j<spp->xsize()-1; ++j){
-				auto& C = spp->getCohort(j);
-				cohort_props_out << t << "\t" 
-								<< spp->species_name << "\t"  // use name instead of index s becuase it is unique and order-insensitive
-								<< j << "\t"
-								<< C.geometry.height << "\t"
-								<< C.geometry.lai << "\t"
-								<< C.rates.dmort_dt << "\t"
-								<< C.rates.dseeds_dt << "\t"
-								<< C.rates.rgr << "\t"
-								<< C.res.gpp/C.geometry.crown_area << "\t";
-				cohort_props_out << "\n";
+	auto E = static_cast<PSPM_Dynamic_Environment*>(S->env);
+	o.z_star = E->z_star;
+	o.canopy_openness = E->canopy_openness;
+	return o;
+}
+
+
+/// @details If async_output is set, the state is written by a background thread. In this case, 
+///          the call blocks only if `queue_capacity` snapshots are already waiting to be written.
+void SolverIO::writeState(double t, SpeciesProps& cwm, EmergentProps& props){
+	PF_PROFILE_SCOPE(WRITE_STATE);
+	auto o = std::make_shared<const OutputSnapshot>(snapshot(t, cwm, props));
+	if (!async_output){
+		write(*o);
+		return;
+	}
+
+	if (!writer.joinable()) start_writer();
+	std::unique_lock<std::mutex> lock(queue_mtx);
+	cv_not_full.wait(lock, [this]{ return queue.size() < std::max(queue_capacity, 1) || writer_error; });
+	if (writer_error) std::rethrow_exception(writer_error);
+	queue.push_back(o);
+	cv_not_empty.notify_one();
+}
+
+
+void SolverIO::start_writer(){
+	writer_stop = false;
+	writer = std::thread([this](){
+		while (true){
+			std::shared_ptr<const OutputSnapshot> o;
+			{
+				std::unique_lock<std::mutex> lock(queue_mtx);
+				cv_not_empty.wait(lock, [this]{ return !queue.empty() || writer_stop; });
+				if (queue.empty()) return;  // stopped, and all snapshots written
+				o = queue.front();
+			}
+			try{
+				write(*o);
+			}
+			catch(...){
+				std::lock_guard<std::mutex> lock(queue_mtx);
+				writer_error = std::current_exception();
+				queue.clear();
+				cv_not_full.notify_all();
+				return;
 			}
+			std::lock_guard<std::mutex> lock(queue_mtx);
+			queue.pop_front();  // removed only after writing, so that the queue size bounds memory use
+			cv_not_full.notify_all();
 		}
+	});
+}
+
+
+void SolverIO::stop_writer(){
+	if (!writer.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(queue_mtx);
+		writer_stop = true;
 	}
+	cv_not_empty.notify_all();
+	writer.join();
+}
 
-	foutd << int(t) << "\t"
-			<< (t-int(t))*365 << "\t"
-			<< props.gpp*0.5/365*1000 << "\t"
-			<< props.npp*0.5/365*1000 << "\t"
-			<< props.resp_auto*0.5/365*1000 << "\t"  // gC/m2/d
-			<< props.leaf_mass*1000*0.5 << "\t"     
-			<< props.stem_mass*1000*0.5 << "\t"
-			<< props.croot_mass*1000*0.5 << "\t"
-			<< props.froot_mass*1000*0.5 << "\t"
-			<< (props.croot_mass+props.froot_mass)*1000*0.5 << "\t" // gC/m2
-			<< cwm.gs << "\t"
-			<< props.trans/365 << "\t"   // kg/m2/yr --> 1e-3 m3/m2/yr --> 1e-3*1e3 mm/yr --> 1/365 mm/day  
-			<< props.lai << "\t"
-			<< cwm.vcmax << "\t"
-			<< props.cc_est << std::endl;
-	
-	fouty << int(t) << "\t"
-			<< -9999  << "\t"
-			<< cwm.n_ind << "\t"
-			<< -9999  << "\t"
-			<< cwm.height  << "\t"
-			<< cwm.hmat  << "\t"
-			<< cwm.canopy_area  << "\t"   // m2/m2
-			<< cwm.ba  << "\t"            // m2/m2
-			<< cwm.biomass  << "\t"       // kg/m2
-			<< cwm.wd  << "\t"
-			<< -9999  << "\t"
-			<< 1/cwm.lma  << "\t"
-			<< cwm.p50  << std::endl;
+
+void SolverIO::write(const OutputSnapshot &o){
+	if (binary_output) write_binary(o);
+	else write_text(o);
+}
+
+
+void SolverIO::write_text(const OutputSnapshot &o){
+	double t = o.t;
+	const SpeciesProps& cwm = o.cwm;
+	const EmergentProps& props = o.props;
+
+	for (auto& os : o.species){
+		if (!os.resident) continue;
+
+		size_dists_out << t << "\t" << os.name << "\t";
+		for (int i=0; i<100; ++i) size_dists_out << os.size_dist[i] << "\t";
+		size_dists_out << "\n";
+
+		for (int j=0; j<os.cohorts.size(); ++j){
+			auto& C = os.cohorts[j];
+			cohort_props_out << t << "\t" 
+			                 << os.name << "\t"  // use name instead of index s becuase it is unique and order-insensitive
+			                 << j << "\t"
+			                 << C.height << "\t"
+			                 << C.lai << "\t"
+			                 << C.mort << "\t"
+			                 << C.fec << "\t"
+			                 << C.rgr << "\t"
+			                 << C.gpp << "\t";
+			cohort_props_out << "\n";
+		}
+	}
+
+	write_emergent_props(foutd, t, cwm, props);
+	write_cwm(fouty, t, cwm);
 	
-	for (int k=0; k<S->species_vec.size(); ++k){
-		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[k]);
+	for (int k=0; k<o.species.size(); ++k){
+		auto& os = o.species[k];
 		fouty_spp 
 				<< int(t) << "\t"
-				<< spp->species_name  << "\t" // use name instead of index k becuase it is unique and order-insensitive
+				<< os.name  << "\t" // use name instead of index k becuase it is unique and order-insensitive
 				<< cwm.n_ind_vec[k] << "\t"
 				<< -9999  << "\t"
 				<< cwm.height_vec[k]  << "\t"
@@ -446,21 +669,19 @@ void SolverIO::writeState(double t, SpeciesProps& cwm, EmergentProps& props){
 				<< -9999  << "\t"
 				<< 1/cwm.lma_vec[k]  << "\t"
 				<< cwm.p50_vec[k]  << "\t"
-				<< spp->seeds_hist.get()  << "\n";
+				<< os.seeds  << "\n";
 	}
 
-	for (int k=0; k<S->species_vec.size(); ++k){
-		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[k]);
+	for (auto& os : o.species){
 		ftraits 
 				<< t << "\t"
-				<< spp->species_name  << "\t" // use name instead of index k becuase it is unique and order-insensitive
-				<< spp->isResident << "\t";
-		std::vector<double> v = spp->get_traits();
-		for (auto vv : v)
+				<< os.name  << "\t" // use name instead of index k becuase it is unique and order-insensitive
+				<< os.resident << "\t";
+		for (auto vv : os.traits)
 		ftraits << vv << "\t";
-		ftraits << spp->r0_hist.get_last() << "\t"
-				<< spp->r0_hist.get() << "\t"
-				<< spp->r0_hist.get_exp(0.02) << "\t"
+		ftraits << os.r0_last << "\t"
+				<< os.r0_avg << "\t"
+				<< os.r0_exp << "\t"
 				<< 0 << "\n"; //spp->r0_hist.get_cesaro() << "\n";
 	}
 
@@ -471,24 +692,132 @@ void SolverIO::writeState(double t, SpeciesProps& cwm, EmergentProps& props){
 	for (int i=0; i<props.lai_vert.size(); ++i) flai << props.lai_vert[i] << "\t";
 	flai << std::endl;
 
-	// // FIXME: Delete this
-	// fseed << t << "\t";
-	// for (int i=0; i<S->n_species(); ++i) fseed << static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[i])->seeds_hist.get() << "\t";
-	// fseed << endl;
-	
-	// fabase << t << "\t";
-	// for (int i=0; i<S->n_species(); ++i) fabase << cwm.ba_vec[i] << "\t";
-	// fabase << endl;
-	
-
 	fzst << t << "\t";
-	for (auto z : static_cast<PSPM_Dynamic_Environment*>(S->env)->z_star) fzst << z << "\t";
+	for (auto z : o.z_star) fzst << z << "\t";
 	fzst << std::endl;
 	
 	fco << t << "\t";
-	for (auto z : static_cast<PSPM_Dynamic_Environment*>(S->env)->canopy_openness) fco << z << "\t";
+	for (auto z : o.canopy_openness) fco << z << "\t";
 	fco << std::endl;
 
 }
 
 
+// Name of binary file corresponding to a text output file
+static std::string binary_filename(std::string name){
+	if (name.size() > 4 && name.substr(name.size()-4) == ".txt") name = name.substr(0, name.size()-4);
+	return name + ".pfc";
+}
+
+
+/// @details Binary files contain the same columns as the text files. Outputs with a variable number 
+///          of values per row (z_star, canopy_openness) are written in long format, with one row per layer.
+///          The large per-cohort and size-distribution outputs are stored in single precision.
+void SolverIO::openStreams_binary(std::string dir, io::Initializer &I){
+	typedef io::ColumnWriter CW;
+
+	std::vector<std::pair<std::string, CW::Type>> schema = {{"t", CW::FLOAT64}, {"speciesID", CW::STRING}, {"cohortID", CW::INT32}};
+	for (auto vname : varnames) schema.push_back({vname, CW::FLOAT32});
+	open_binary(cohort_props_bin, dir + "/cohort_props.pfc", schema);
+
+	schema = {{"t", CW::FLOAT64}, {"speciesID", CW::STRING}};
+	for (int i=0; i<100; ++i) schema.push_back({"d" + std::to_string(i), CW::FLOAT32});
+	open_binary(size_dists_bin, dir + "/size_distributions.pfc", schema);
+
+	open_binary(zst_bin, dir + "/z_star.pfc", {{"t", CW::FLOAT64}, {"layer", CW::INT32}, {"z_star", CW::FLOAT64}});
+	open_binary(co_bin, dir + "/canopy_openness.pfc", {{"t", CW::FLOAT64}, {"layer", CW::INT32}, {"canopy_openness", CW::FLOAT64}});
+
+	schema = {{"t", CW::FLOAT64}};
+	for (int i=0; i<25; ++i) schema.push_back({"z" + std::to_string(i), CW::FLOAT64});
+	open_binary(lai_bin, dir + "/lai_profile.pfc", schema);
+
+	schema = {{"YEAR", CW::INT32}};
+	for (std::string v : {"DOY", "GPP", "NPP", "RAU", "CL", "CW", "CCR", "CFR", "CR", "GS", "ET", "LAI", "VCMAX", "CCEST"}) schema.push_back({v, CW::FLOAT64});
+	open_binary(emg_bin, dir + "/" + binary_filename(I.get<std::string>("emgProps")), schema);
+
+	schema = {{"YEAR", CW::INT32}, {"PID", CW::INT32}};
+	for (std::string v : {"DE", "OC", "PH", "MH", "CA", "BA", "TB", "WD", "MO", "SLA", "P50"}) schema.push_back({v, CW::FLOAT64});
+	open_binary(cwm_bin, dir + "/" + binary_filename(I.get<std::string>("cwmAvg")), schema);
+
+	schema = {{"YEAR", CW::INT32}, {"PID", CW::STRING}};
+	for (std::string v : {"DE", "OC", "PH", "MH", "CA", "BA", "TB", "WD", "MO", "SLA", "P50", "SEEDS"}) schema.push_back({v, CW::FLOAT64});
+	open_binary(cwm_spp_bin, dir + "/" + binary_filename(I.get<std::string>("cwmperSpecies")), schema);
+
+	traits_bin_file = dir + "/" + binary_filename(I.get<std::string>("traits"));
+}
+
+
+void SolverIO::write_binary(const OutputSnapshot &o){
+	typedef io::ColumnWriter CW;
+	double t = o.t;
+	const SpeciesProps& cwm = o.cwm;
+	const EmergentProps& props = o.props;
+
+	for (auto& os : o.species){
+		if (!os.resident) continue;
+
+		size_dists_bin << t << os.name;
+		for (int i=0; i<100; ++i) size_dists_bin << os.size_dist[i];
+		size_dists_bin.end_row();
+
+		for (int j=0; j<os.cohorts.size(); ++j){
+			auto& C = os.cohorts[j];
+			cohort_props_bin << t << os.name << j << C.height << C.lai << C.mort << C.fec << C.rgr << C.gpp;
+			cohort_props_bin.end_row();
+		}
+	}
+
+	emg_bin << int(t)
+	        << (t-int(t))*365
+	        << props.gpp*0.5/365*1000
+	        << props.npp*0.5/365*1000
+	        << props.resp_auto*0.5/365*1000
+	        << props.leaf_mass*1000*0.5
+	        << props.stem_mass*1000*0.5
+	        << props.croot_mass*1000*0.5
+	        << props.froot_mass*1000*0.5
+	        << (props.croot_mass+props.froot_mass)*1000*0.5
+	        << cwm.gs
+	        << props.trans/365
+	        << props.lai
+	        << cwm.vcmax
+	        << props.cc_est;
+	emg_bin.end_row();
+
+	cwm_bin << int(t) << -9999 << cwm.n_ind << -9999.0 << cwm.height << cwm.hmat << cwm.canopy_area << cwm.ba << cwm.biomass << cwm.wd << -9999.0 << 1/cwm.lma << cwm.p50;
+	cwm_bin.end_row();
+
+	for (int k=0; k<o.species.size(); ++k){
+		auto& os = o.species[k];
+		cwm_spp_bin << int(t) << os.name << cwm.n_ind_vec[k] << -9999.0 << cwm.height_vec[k] << cwm.hmat_vec[k] << cwm.canopy_area_vec[k] 
+		            << cwm.ba_vec[k] << cwm.biomass_vec[k] << cwm.wd_vec[k] << -9999.0 << 1/cwm.lma_vec[k] << cwm.p50_vec[k] << os.seeds;
+		cwm_spp_bin.end_row();
+	}
+
+	for (auto& os : o.species){
+		if (!traits_bin.is_open()){
+			std::vector<std::pair<std::string, CW::Type>> schema = {{"YEAR", CW::FLOAT64}, {"SPP", CW::STRING}, {"RES", CW::INT32}};
+			for (int i=0; i<os.traits.size(); ++i) schema.push_back({(i < os.trait_names.size())? os.trait_names[i] : "T"+std::to_string(i), CW::FLOAT64});
+			for (std::string n : {"r0_last", "r0_avg", "r0_exp", "r0_cesaro"}) schema.push_back({n, CW::FLOAT64});
+			open_binary(traits_bin, traits_bin_file, schema);
+		}
+		traits_bin << t << os.name << int(os.resident);
+		for (auto vv : os.traits) traits_bin << vv;
+		traits_bin << os.r0_last << os.r0_avg << os.r0_exp << 0.0;
+		traits_bin.end_row();
+	}
+
+	lai_bin << t;
+	for (int i=0; i<props.lai_vert.size(); ++i) lai_bin << props.lai_vert[i];
+	lai_bin.end_row();
+	
+	for (int i=0; i<o.z_star.size(); ++i){
+		zst_bin << t << i << o.z_star[i];
+		zst_bin.end_row();
+	}
+	for (int i=0; i<o.canopy_openness.size(); ++i){
+		co_bin << t << i << o.canopy_openness[i];
+		co_bin.end_row();
+	}
+}
+
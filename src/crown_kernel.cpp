@@ -0,0 +1,207 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cfloat>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "crown_kernel.h"
+
+namespace env{
+namespace crown_kernel{
+
+static const double LN2   = 0.69314718055994530942;
+static const double SQRT2 = 1.41421356237309504880;
+
+// Coefficients of ln(x) = 2t (1 + t^2/3 + t^4/5 + ...), where t = (x-1)/(x+1).
+// For x in [1/sqrt(2), sqrt(2)), |t| < 0.1716, and truncating after t^16/17 gives an error < 2e-14
+static const double LOG_C[] = {1.0/17, 1.0/15, 1.0/13, 1.0/11, 1.0/9, 1.0/7, 1.0/5, 1.0/3, 1.0};
+static const int    LOG_NC  = 9;
+
+// Taylor coefficients of exp(g) (highest degree first). For |g| < ln(2)/2, truncating after g^11 gives a relative error < 7e-15
+static const double EXP_C[] = {1.0/39916800, 1.0/3628800, 1.0/362880, 1.0/40320, 1.0/5040, 1.0/720, 1.0/120, 1.0/24, 1.0/6, 1.0/2, 1.0, 1.0};
+static const int    EXP_NC  = 12;
+
+
+// log2(x) for positive, normal x
+static inline double fast_log2(double x){
+	uint64_t bits;
+	std::memcpy(&bits, &x, sizeof(double));
+	double e = double(bits >> 52) - 1023;
+	bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+	double mant;
+	std::memcpy(&mant, &bits, sizeof(double));
+	if (mant > SQRT2){
+		mant *= 0.5;
+		e += 1;
+	}
+	double t = (mant-1)/(mant+1);
+	double t2 = t*t;
+	double p = LOG_C[0];
+	for (int k=1; k<LOG_NC; ++k) p = p*t2 + LOG_C[k];
+	return e + 2*t*p/LN2;
+}
+
+// 2^w
+static inline double fast_exp2(double w){
+	if (w < -1022) return 0;
+	if (w > 1023) w = 1023;
+	double k = std::nearbyint(w);
+	double g = (w-k)*LN2;
+	double p = EXP_C[0];
+	for (int i=1; i<EXP_NC; ++i) p = p*g + EXP_C[i];
+	uint64_t bits = uint64_t(int64_t(k) + 1023) << 52;
+	double scale;
+	std::memcpy(&scale, &bits, sizeof(double));
+	return p*scale;
+}
+
+
+double fast_pow(double x, double y){
+	if (x < DBL_MIN) return (y == 0)? 1 : 0;
+	return fast_exp2(y*fast_log2(x));
+}
+
+
+// Scalar version for the non-AVX2 build and the remainder of the AVX2 loop. This uses std::pow, 
+// which is faster than fast_pow() in scalar code, and agrees with the vectorized version to within the error bound.
+static inline double crown_area_above_1(double z, double H, double ca, double zm, double qm, double m, double n, double fg){
+	if (z < zm && fg == 0) return ca;  // full crown, shape is not needed
+	double q = 0;
+	if (z <= H && z >= 0){
+		double r = z/H;
+		double zHn_1 = pow(r, n-1);
+		double zHn   = zHn_1 * r;
+		q = m*n * pow(1 - zHn, m-1) * zHn_1;
+	}
+	double fq = q/qm;
+	double f2 = fq*fq;
+	return (z >= zm)? ca*f2*(1-fg) : ca*(1-f2*fg);
+}
+
+
+#ifdef __AVX2__
+
+bool simd_enabled(){
+	return true;
+}
+
+static inline __m256d poly_pd(__m256d x, const double * c, int nc){
+	__m256d p = _mm256_set1_pd(c[0]);
+#ifdef __FMA__
+	for (int k=1; k<nc; ++k) p = _mm256_fmadd_pd(p, x, _mm256_set1_pd(c[k]));
+#else
+	for (int k=1; k<nc; ++k) p = _mm256_add_pd(_mm256_mul_pd(p, x), _mm256_set1_pd(c[k]));
+#endif
+	return p;
+}
+
+// Same as fast_log2()
+static inline __m256d fast_log2_pd(__m256d x){
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d two52 = _mm256_set1_pd(4503599627370496.0);  // 2^52
+	__m256i bits = _mm256_castpd_si256(x);
+
+	// exponent, converted to double by placing it in the mantissa of 2^52
+	__m256i ebits = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_castpd_si256(two52));
+	__m256d e = _mm256_sub_pd(_mm256_sub_pd(_mm256_castsi256_pd(ebits), two52), _mm256_set1_pd(1023));
+
+	__m256i mbits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm256_castpd_si256(one));
+	__m256d mant = _mm256_castsi256_pd(mbits);
+	__m256d big  = _mm256_cmp_pd(mant, _mm256_set1_pd(SQRT2), _CMP_GT_OQ);
+	mant = _mm256_blendv_pd(mant, _mm256_mul_pd(mant, _mm256_set1_pd(0.5)), big);
+	e    = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+	__m256d t  = _mm256_div_pd(_mm256_sub_pd(mant, one), _mm256_add_pd(mant, one));
+	__m256d t2 = _mm256_mul_pd(t, t);
+	__m256d p  = poly_pd(t2, LOG_C, LOG_NC);
+	return _mm256_add_pd(e, _mm256_mul_pd(_mm256_mul_pd(t, p), _mm256_set1_pd(2/LN2)));
+}
+
+// Same as fast_exp2()
+static inline __m256d fast_exp2_pd(__m256d w){
+	const __m256d lo = _mm256_set1_pd(-1022);
+	__m256d underflow = _mm256_cmp_pd(w, lo, _CMP_LT_OQ);
+	w = _mm256_min_pd(_mm256_max_pd(w, lo), _mm256_set1_pd(1023));
+
+	__m256d k = _mm256_round_pd(w, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d g = _mm256_mul_pd(_mm256_sub_pd(w, k), _mm256_set1_pd(LN2));
+	__m256d p = poly_pd(g, EXP_C, EXP_NC);
+
+	// biased exponent k+1023 is placed in the low bits by adding 2^52, then shifted into the exponent field
+	__m256i kb = _mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(4503599627370496.0 + 1023)));
+	kb = _mm256_slli_epi64(_mm256_and_si256(kb, _mm256_set1_epi64x(0x7FF)), 52);
+	__m256d r = _mm256_mul_pd(p, _mm256_castsi256_pd(kb));
+	return _mm256_andnot_pd(underflow, r);
+}
+
+// Same as fast_pow()
+static inline __m256d fast_pow_pd(__m256d x, __m256d y){
+	const __m256d zero = _mm256_setzero_pd();
+	__m256d small = _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_LT_OQ);
+	__m256d r = fast_exp2_pd(_mm256_mul_pd(y, fast_log2_pd(_mm256_max_pd(x, _mm256_set1_pd(DBL_MIN)))));
+	__m256d r_small = _mm256_and_pd(_mm256_cmp_pd(y, zero, _CMP_EQ_OQ), _mm256_set1_pd(1.0));
+	return _mm256_blendv_pd(r, r_small, small);
+}
+
+void crown_area_above(int N, double z, const double * height, const double * crown_area, const double * zm,
+                      const double * qm, const double * m, const double * n, const double * fg, double * out){
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d zv  = _mm256_set1_pd(z);
+
+	int i=0;
+	for (; i+4<=N; i+=4){
+		__m256d H  = _mm256_loadu_pd(height+i);
+		__m256d g  = (fg)? _mm256_loadu_pd(fg+i) : _mm256_setzero_pd();
+		__m256d ca = _mm256_loadu_pd(crown_area+i);
+		__m256d is_above = _mm256_cmp_pd(zv, _mm256_loadu_pd(zm+i), _CMP_GE_OQ);
+
+		// The crown shape is needed only within the crown, and below z_m only if there are gaps.
+		// Cohorts are typically sorted by size, so all 4 lanes often skip it together.
+		__m256d inside = _mm256_and_pd(_mm256_cmp_pd(zv, H, _CMP_LE_OQ), _mm256_cmp_pd(zv, _mm256_setzero_pd(), _CMP_GE_OQ));
+		__m256d need_q = _mm256_and_pd(inside, _mm256_or_pd(is_above, _mm256_cmp_pd(g, _mm256_setzero_pd(), _CMP_NEQ_OQ)));
+
+		__m256d f2 = _mm256_setzero_pd();
+		if (_mm256_movemask_pd(need_q)){
+			__m256d mv = _mm256_loadu_pd(m+i);
+			__m256d nv = _mm256_loadu_pd(n+i);
+
+			__m256d r     = _mm256_div_pd(zv, H);
+			__m256d zHn_1 = fast_pow_pd(r, _mm256_sub_pd(nv, one));
+			__m256d zHn   = _mm256_mul_pd(zHn_1, r);
+			__m256d q     = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(mv, nv), fast_pow_pd(_mm256_sub_pd(one, zHn), _mm256_sub_pd(mv, one))), zHn_1);
+			q = _mm256_and_pd(inside, q);
+
+			__m256d fq = _mm256_div_pd(q, _mm256_loadu_pd(qm+i));
+			f2 = _mm256_mul_pd(fq, fq);
+		}
+
+		__m256d above_zm = _mm256_mul_pd(_mm256_mul_pd(ca, f2), _mm256_sub_pd(one, g));
+		__m256d below_zm = _mm256_mul_pd(ca, _mm256_sub_pd(one, _mm256_mul_pd(f2, g)));
+		_mm256_storeu_pd(out+i, _mm256_blendv_pd(below_zm, above_zm, is_above));
+	}
+	for (; i<N; ++i){
+		out[i] = crown_area_above_1(z, height[i], crown_area[i], zm[i], qm[i], m[i], n[i], (fg)? fg[i] : 0);
+	}
+}
+
+#else
+
+bool simd_enabled(){
+	return false;
+}
+
+void crown_area_above(int N, double z, const double * height, const double * crown_area, const double * zm,
+                      const double * qm, const double * m, const double * n, const double * fg, double * out){
+	for (int i=0; i<N; ++i){
+		out[i] = crown_area_above_1(z, height[i], crown_area[i], zm[i], qm[i], m[i], n[i], (fg)? fg[i] : 0);
+	}
+}
+
+#endif
+
+} // namespace crown_kernel
+} // namespace env
+
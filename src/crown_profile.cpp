@@ -0,0 +1,151 @@
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "crown_profile.h"
+
+namespace env{
+
+void CrownAreaProfile::clear(){
+	crowns.clear();
+	zm_desc.clear();
+	wca_cumm.clear();
+	breaks.clear();
+	zm_H_min = 1;
+}
+
+
+void CrownAreaProfile::add_crown(double w, double crown_area, double height, double zm, double m, double n, double qm){
+	crowns.push_back({w*crown_area, height, zm, m, n, qm});
+}
+
+
+void CrownAreaProfile::build(){
+	// tallest crowns first
+	std::sort(crowns.begin(), crowns.end(), [](const Crown& a, const Crown& b){ return a.height > b.height; });
+
+	// crowns with the highest z_m first, and cumulative area of full (non-tapering) crowns
+	std::vector<std::pair<double,double>> zm_wca;
+	zm_wca.reserve(crowns.size());
+	for (auto& c : crowns) zm_wca.push_back({c.zm, c.wca});
+	std::sort(zm_wca.begin(), zm_wca.end(), [](const std::pair<double,double>& a, const std::pair<double,double>& b){ return a.first > b.first; });
+
+	zm_desc.resize(zm_wca.size());
+	wca_cumm.resize(zm_wca.size()+1);
+	wca_cumm[0] = 0;
+	for (int j=0; j<zm_wca.size(); ++j){
+		zm_desc[j] = zm_wca[j].first;
+		wca_cumm[j+1] = wca_cumm[j] + zm_wca[j].second;
+	}
+
+	// breakpoints of the profile: the profile is smooth between any two consecutive breakpoints
+	breaks.clear();
+	breaks.reserve(2*crowns.size()+1);
+	breaks.push_back(0);
+	zm_H_min = 1;
+	for (auto& c : crowns){
+		breaks.push_back(c.zm);
+		breaks.push_back(c.height);
+		if (c.height > 0) zm_H_min = std::min(zm_H_min, c.zm/c.height);
+	}
+	std::sort(breaks.begin(), breaks.end());
+	breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+}
+
+
+/// @details Same as plant::PlantGeometry::crown_area_extent_projected() above z_m, scaled by the cohort weight
+double CrownAreaProfile::crown_shape_area(const Crown &c, double z) const {
+	if (z > c.height || z < 0) return 0;
+	double zHn_1 = pow(z/c.height, c.n-1);
+	double zHn   = zHn_1 * z/c.height;
+	double q = c.m*c.n * pow(1 - zHn, c.m-1) * zHn_1;
+	double fq = q/c.qm;
+	return c.wca * fq*fq;
+}
+
+
+double CrownAreaProfile::area_above(double z) const {
+	// crowns that are still full at z (z < z_m)
+	int n_full = std::partition_point(zm_desc.begin(), zm_desc.end(), [z](double zm){ return zm > z; }) - zm_desc.begin();
+	double ca = wca_cumm[n_full];
+
+	// crowns that are tapering at z (z_m <= z <= H). These must have z <= H <= z/min(z_m/H)
+	auto it_end   = std::partition_point(crowns.begin(), crowns.end(), [z](const Crown& c){ return c.height >= z; });
+	auto it_begin = crowns.begin();
+	if (zm_H_min > 0) it_begin = std::partition_point(crowns.begin(), it_end, [h=z/zm_H_min](const Crown& c){ return c.height > h; });
+	for (auto it = it_begin; it != it_end; ++it){
+		if (it->zm <= z) ca += crown_shape_area(*it, z);
+	}
+
+	return ca;
+}
+
+
+double CrownAreaProfile::total() const {
+	return area_above(0);
+}
+
+
+/// @param n_layers  Number of layers to solve for
+/// @param fG        Area of each layer (total crown area above \f$z^*_l\f$ is \f$l f_G\f$)
+/// @param tol       Tolerance on z
+/// @return          Vector of layer heights, from the top layer to the bottom layer
+/// @details Since the profile is monotonically decreasing in z, the bracketing breakpoints for
+///          successive layers move monotonically downwards, so the search range shrinks with each layer.
+///          Within a bracket, the set of tapering crowns is fixed, and the root is found by bisection
+///          over those crowns alone.
+std::vector<double> CrownAreaProfile::solve_z_star(int n_layers, double fG, double tol) const {
+	std::vector<double> z_star;
+	z_star.reserve(n_layers);
+
+	int jmax = breaks.size()-1;
+	for (int layer=1; layer<=n_layers; ++layer){
+		double target = layer*fG;
+
+		// largest breakpoint index j with area_above(breaks[j]) >= target
+		int lo = 0, hi = jmax;
+		while (lo < hi){
+			int mid = (lo+hi+1)/2;
+			if (area_above(breaks[mid]) >= target) lo = mid;
+			else hi = mid-1;
+		}
+		jmax = lo;
+		if (lo == breaks.size()-1){
+			z_star.push_back(breaks[lo]);
+			continue;
+		}
+
+		double za = breaks[lo], zb = breaks[lo+1];
+
+		// Within (za, zb), crowns with z_m >= zb are full, crowns with z_m <= za and H >= zb are tapering
+		int n_full = std::partition_point(zm_desc.begin(), zm_desc.end(), [zb](double zm){ return zm >= zb; }) - zm_desc.begin();
+		double ca_full = wca_cumm[n_full];
+
+		std::vector<const Crown*> tapering;
+		auto it_end   = std::partition_point(crowns.begin(), crowns.end(), [zb](const Crown& c){ return c.height >= zb; });
+		auto it_begin = crowns.begin();
+		if (zm_H_min > 0) it_begin = std::partition_point(crowns.begin(), it_end, [h=za/zm_H_min](const Crown& c){ return c.height > h; });
+		for (auto it = it_begin; it != it_end; ++it){
+			if (it->zm <= za) tapering.push_back(&(*it));
+		}
+
+		auto f = [&](double z){
+			double ca = ca_full;
+			for (auto c : tapering) ca += crown_shape_area(*c, z);
+			return ca - target;
+		};
+
+		while (zb - za > tol){
+			double zmid = (za+zb)/2;
+			if (f(zmid) >= 0) za = zmid;
+			else zb = zmid;
+		}
+		z_star.push_back((za+zb)/2);
+	}
+
+	return z_star;
+}
+
+
+} // namespace env
+
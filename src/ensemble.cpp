@@ -0,0 +1,140 @@
+#include "ensemble.h"
+#include "utils/thread_pool.h"
+#include <set>
+#include <mutex>
+#include <thread>
+#include <filesystem>
+using namespace std;
+
+EnsembleRunner::EnsembleRunner(std::string params_file){
+	paramsFile = params_file;
+
+	io::Initializer I(params_file);
+	I.readFile();
+	parent_dir = I.get<string>("outDir");
+	expt_dir   = I.get<string>("exptName");
+
+	n_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+void EnsembleRunner::add_member(std::string name, std::vector<std::string> names, std::vector<std::string> values){
+	if (names.size() != values.size()) throw std::runtime_error("Ensemble member " + name + ": number of parameter names and values differ");
+	for (auto& m : members) if (m.name == name) throw std::runtime_error("Duplicate ensemble member " + name);
+
+	Member m;
+	m.name = name;
+	for (int i=0; i<names.size(); ++i){
+		if (names[i] == "outDir" || names[i] == "exptName") throw std::runtime_error("Ensemble member " + name + ": " + names[i] + " cannot be set per member");
+		m.overrides[names[i]] = values[i];
+	}
+	members.push_back(m);
+}
+
+
+void EnsembleRunner::read_members(std::string file){
+	ifstream fin(file);
+	if (!fin) throw std::runtime_error("Could not open file " + file);
+
+	vector<string> header;
+	string line;
+	while (getline(fin, line)){
+		stringstream sin(line);
+		vector<string> cells;
+		string cell;
+		while (sin >> cell) cells.push_back(cell);
+		if (cells.empty() || cells[0][0] == '#') continue;
+
+		if (header.empty()){
+			header = cells;
+			if (header[0] != "name") throw std::runtime_error("First column of " + file + " must be name");
+			continue;
+		}
+		if (cells.size() != header.size()) throw std::runtime_error("Wrong number of values for member " + cells[0] + " in " + file);
+
+		add_member(cells[0], vector<string>(header.begin()+1, header.end()), vector<string>(cells.begin()+1, cells.end()));
+	}
+}
+
+
+// Copy the base parameter file, replacing the values of overridden parameters (comments are kept)
+void EnsembleRunner::write_params(const Member &m, std::string file){
+	ifstream fin(paramsFile);
+	if (!fin) throw std::runtime_error("Could not open file " + paramsFile);
+	ofstream fout(file);
+
+	set<string> found;
+	string line;
+	while (getline(fin, line)){
+		stringstream sin(line);
+		string key;
+		sin >> key;
+		auto it = m.overrides.find(key);
+		if (it != m.overrides.end()){
+			size_t pos = line.find('#', line.find(key) + key.size());
+			fout << key << "\t" << it->second;
+			if (pos != string::npos) fout << "\t" << line.substr(pos);
+			fout << "\n";
+			found.insert(key);
+		}
+		else fout << line << "\n";
+	}
+
+	for (auto& p : m.overrides){
+		if (found.count(p.first) == 0) throw std::runtime_error("Parameter " + p.first + " not found in " + paramsFile);
+	}
+}
+
+
+std::shared_ptr<const env::ClimateForcing> EnsembleRunner::run_member(Member &m, double tstart, double tend){
+	string dir = parent_dir + "/" + expt_dir;
+	string member_params = dir + "/" + m.name + ".ini";
+	write_params(m, member_params);
+
+	Simulator sim(member_params);
+	sim.parent_dir = parent_dir;
+	sim.expt_dir = expt_dir + "/" + m.name;
+	sim.n_threads = 1;   // parallelism is over members
+	sim.verbose = false; // members run concurrently, so per-step progress would interleave
+	sim.init(tstart, tend);
+	sim.simulate();
+	sim.close();
+
+	// the member's parameter file is not used again
+	plant::Plant::clear_params_cache(member_params);
+	return sim.E.forcing;
+}
+
+
+int EnsembleRunner::run(double tstart, double tend){
+	std::filesystem::create_directories(parent_dir + "/" + expt_dir);
+
+	// Forcing is cached only while it is in use, so keep it for later members until the run ends
+	std::mutex forcing_mtx;
+	std::set<std::shared_ptr<const env::ClimateForcing>> forcing_used;
+
+	ThreadPool pool(std::max(1, std::min(n_threads, int(members.size()))));
+	pool.parallel_for(members.size(), [&](int i){
+		members[i].error.clear();
+		try{
+			auto f = run_member(members[i], tstart, tend);
+			std::lock_guard<std::mutex> lock(forcing_mtx);
+			forcing_used.insert(f);
+		}
+		catch(const std::exception &e){
+			members[i].error = e.what();
+		}
+	});
+
+	int n_failed = 0;
+	for (auto& m : members) if (!m.error.empty()) ++n_failed;
+	return n_failed;
+}
+
+
+std::vector<std::string> EnsembleRunner::get_errors(){
+	vector<string> errors;
+	for (auto& m : members) errors.push_back(m.error);
+	return errors;
+}
+
@@ -0,0 +1,89 @@
+#include "multipatch.h"
+#include <filesystem>
+using namespace std;
+
+MultiPatchSimulator::MultiPatchSimulator(std::string params_file) : I(params_file) {
+	paramsFile = params_file;
+	I.readFile();
+
+	parent_dir = I.get<string>("outDir");
+	expt_dir   = I.get<string>("exptName");
+
+	n_patches = I.getScalarOrDefault("n_patches", 1);
+	n_threads = I.getScalarOrDefault("n_threads", 1);
+	seed      = I.getScalarOrDefault("randomSeed", 1);
+	delta_T   = I.getScalar("delta_T");
+}
+
+
+void MultiPatchSimulator::init(double tstart, double tend){
+	if (n_patches < 1) throw std::runtime_error("MultiPatchSimulator: n_patches must be at least 1");
+
+	y0 = tstart;
+	yf = tend;
+
+	string out_dir = parent_dir + "/" + expt_dir;
+	std::filesystem::create_directories(out_dir);
+
+	patches.clear();
+	for (int i=0; i<n_patches; ++i){
+		auto sim = make_unique<Simulator>(I, paramsFile);
+		sim->parent_dir = parent_dir;
+		sim->expt_dir = expt_dir + "/patch_" + to_string(i);
+		sim->n_threads = 1;          // parallelism is over patches
+		sim->verbose = false;        // patches are stepped concurrently, so progress is printed here
+		sim->set_random_seed(seed + i);
+		sim->init(tstart, tend);
+		sim->draw_next_disturbance(tstart);
+		patches.push_back(std::move(sim));
+	}
+
+	pool = make_unique<ThreadPool>(std::max(1, std::min(n_threads, n_patches)));
+
+	foutd.open(out_dir + "/" + I.get<string>("emgProps"));
+	fouty.open(out_dir + "/" + I.get<string>("cwmAvg"));
+	foutd << SolverIO::emergent_props_header;
+	fouty << SolverIO::cwm_header;
+}
+
+
+void MultiPatchSimulator::simulate(){
+	for (double t=y0; t <= yf; t=t+delta_T) {
+		step_to(t);
+	}
+}
+
+
+void MultiPatchSimulator::step_to(double t){
+	cout << "stepping = " << setprecision(6) << patches[0]->S.current_time << " --> " << t << "\t(" << n_patches << " patches)" << endl;
+
+	pool->parallel_for(n_patches, [this, t](int i){
+		patches[i]->step_to(t);
+	});
+
+	average_patches();
+	SolverIO::write_emergent_props(foutd, t, cwm, props);
+	SolverIO::write_cwm(fouty, t, cwm);
+}
+
+
+void MultiPatchSimulator::average_patches(){
+	cwm   = patches[0]->cwm;
+	props = patches[0]->props;
+	for (int i=1; i<n_patches; ++i){
+		cwm   += patches[i]->cwm;
+		props += patches[i]->props;
+	}
+	cwm   /= n_patches;
+	props /= n_patches;
+}
+
+
+void MultiPatchSimulator::close(){
+	pool->parallel_for(n_patches, [this](int i){
+		patches[i]->close();
+	});
+	foutd.close();
+	fouty.close();
+}
+
@@ -0,0 +1,133 @@
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "phydro_cache.h"
+
+namespace plant{
+
+const std::array<double phydro::PHydroResult::*, 7> PhydroCache::interpolated_fields = {
+	&phydro::PHydroResult::a,
+	&phydro::PHydroResult::e,
+	&phydro::PHydroResult::gs,
+	&phydro::PHydroResult::vcmax,
+	&phydro::PHydroResult::vcmax25,
+	&phydro::PHydroResult::dpsi,
+	&phydro::PHydroResult::mc
+};
+
+
+PhydroCache::PhydroCache(double _tol, int _nI, int _nf){
+	tol = _tol;
+	nI = std::max(_nI, 2);
+	nf_2d = std::max(_nf, 2);
+	nf = nf_2d;
+	I_max = 0;
+}
+
+
+void PhydroCache::clear(){
+	std::lock_guard<std::mutex> lock(mtx);
+	key_valid = false;
+	++generation;
+	nodes.clear();
+	node_ok.clear();
+	cell_state.clear();
+}
+
+
+bool PhydroCache::is_1d() const {
+	return iabs_only;
+}
+
+
+bool PhydroCache::results_match(const phydro::PHydroResult &r1, const phydro::PHydroResult &r2) const {
+	for (auto f : interpolated_fields){
+		double scale = std::max(std::fabs(r1.*f), std::fabs(r2.*f));
+		if (!(std::fabs(r1.*f - r2.*f) <= tol*scale)) return false;
+	}
+	return true;
+}
+
+
+double PhydroCache::light_at(int i) const {
+	double s = double(i)/(nI-1);
+	return I_max*s*s;
+}
+
+
+double PhydroCache::node_light(int id) const {
+	return light_at(id/nf);
+}
+
+
+double PhydroCache::node_fapar(int id) const {
+	return (iabs_only)? 1.0 : double(id%nf)/(nf-1);
+}
+
+
+// called with mtx held
+void PhydroCache::reset(const Key &k, double _I_max, bool _iabs_only){
+	key = k;
+	key_valid = true;
+	I_max = _I_max;
+	++n_resets;
+	++generation;
+
+	iabs_only = _iabs_only;
+	nf = (iabs_only)? 1 : nf_2d;
+
+	nodes.resize(nI*nf);
+	node_ok.assign(nI*nf, 0);
+	cell_state.assign((nI-1)*std::max(nf-1, 1), CELL_UNCHECKED);
+}
+
+
+// called with mtx held, once all corners of the cell are in the table
+void PhydroCache::check_cell(int i, int j, const phydro::PHydroResult &mid_exact){
+	std::vector<const phydro::PHydroResult*> corners = {&nodes[i*nf+j], &nodes[(i+1)*nf+j]};
+	if (!iabs_only){
+		corners.push_back(&nodes[i*nf+j+1]);
+		corners.push_back(&nodes[(i+1)*nf+j+1]);
+	}
+	phydro::PHydroResult mid_interp = interpolate(i, j, 0.5, (iabs_only)? 0 : 0.5);
+
+	bool ok = true;
+	for (auto f : interpolated_fields){
+		double scale = std::fabs(mid_exact.*f);
+		for (auto r : corners) scale = std::max(scale, std::fabs(r->*f));
+		double err = std::fabs(mid_interp.*f - mid_exact.*f);
+		if (!(err <= tol*scale)) ok = false;  // also catches NaNs
+	}
+	cell_state[i*std::max(nf-1, 1)+j] = (ok)? CELL_INTERP : CELL_EXACT;
+}
+
+
+phydro::PHydroResult PhydroCache::interpolate(int i, int j, double wi, double wf){
+	if (iabs_only){
+		const phydro::PHydroResult &r0 = nodes[i], &r1 = nodes[i+1];
+		phydro::PHydroResult res = (wi < 0.5)? r0 : r1;
+		for (auto f : interpolated_fields){
+			res.*f = (1-wi)*(r0.*f) + wi*(r1.*f);
+		}
+		return res;
+	}
+
+	const phydro::PHydroResult &r00 = nodes[i*nf+j],     &r01 = nodes[i*nf+j+1];
+	const phydro::PHydroResult &r10 = nodes[(i+1)*nf+j], &r11 = nodes[(i+1)*nf+j+1];
+
+	// nearest node for outputs that are not interpolated
+	phydro::PHydroResult res = (wi < 0.5)? ((wf < 0.5)? r00 : r01) : ((wf < 0.5)? r10 : r11);
+	for (auto f : interpolated_fields){
+		res.*f = (1-wi)*(1-wf)*(r00.*f) + (1-wi)*wf*(r01.*f) + wi*(1-wf)*(r10.*f) + wi*wf*(r11.*f);
+	}
+	return res;
+}
+
+
+void PhydroCache::print_stats(){
+	std::cout << "Phydro cache (" << ((iabs_only)? "1D" : "2D") << "): " << n_queries << " queries, " << n_phydro_calls << " Phydro calls, " << n_resets << " resets\n";
+}
+
+} // namespace plant
+
@@ -0,0 +1,83 @@
+#include <cmath>
+#include <algorithm>
+
+namespace plant{
+
+// Phydro is never called while mtx is held: results are computed first, and published to the table under the lock
+// only if the table has not been reset in the meantime. Tabulated values depend only on the key and the node, so 
+// it does not matter which thread computes them.
+template<class _Climate, class Func>
+phydro::PHydroResult PhydroCache::get(double I0, double fapar, _Climate &clim, PlantParameters &par, PlantTraits &traits, Func exact){
+	std::unique_lock<std::mutex> lock(mtx);
+	++n_queries;
+
+	Key k = {clim.tc, clim.vpd, clim.co2, clim.elv, clim.swp, clim.ppfd_max, 
+	         par.kphio, par.alpha, par.gamma, par.rd, 
+	         traits.K_leaf, traits.p50_leaf, traits.b_leaf};
+	if (!key_valid || k != key){
+		lock.unlock();
+		// Check whether Phydro responds to absorbed light only
+		auto r1 = exact(0.5*clim.ppfd_max, 0.8);
+		auto r2 = exact(0.8*clim.ppfd_max, 0.5);
+		bool iabs = results_match(r1, r2);
+		lock.lock();
+		n_phydro_calls += 2;
+		if (!key_valid || k != key) reset(k, clim.ppfd_max, iabs);
+	}
+
+	// position in table. Points outside the table (including NaNs) are calculated exactly
+	double I  = (iabs_only)? I0*fapar : I0;
+	double xi = std::sqrt(I/I_max)*(nI-1);
+	double xf = (iabs_only)? 0 : fapar*(nf-1);
+	if (!(xi >= 0 && xi <= nI-1 && xf >= 0 && xf <= nf-1)){
+		++n_phydro_calls;
+		lock.unlock();
+		return exact(I0, fapar);
+	}
+	int i = std::min(int(xi), nI-2);
+	int j = (iabs_only)? 0 : std::min(int(xf), nf-2);
+
+	int c = i*std::max(nf-1, 1) + j;
+	if (cell_state[c] == CELL_UNCHECKED){
+		// compute the missing corners and the cell centre without holding the lock
+		long gen = generation;
+		std::vector<int> ids = {i*nf+j, (i+1)*nf+j};
+		if (!iabs_only){
+			ids.push_back(i*nf+j+1);
+			ids.push_back((i+1)*nf+j+1);
+		}
+		std::vector<std::pair<int, phydro::PHydroResult>> computed;
+		std::vector<int> missing;
+		for (int id : ids) if (!node_ok[id]) missing.push_back(id);
+		double I_mid = I_max * std::pow((i+0.5)/(nI-1), 2);
+		double f_mid = (iabs_only)? 1.0 : (j+0.5)/(nf-1);
+		lock.unlock();
+
+		for (int id : missing) computed.push_back({id, exact(node_light(id), node_fapar(id))});
+		phydro::PHydroResult mid_exact = exact(I_mid, f_mid);
+
+		lock.lock();
+		n_phydro_calls += computed.size() + 1;
+		if (gen != generation){  // the table was reset meanwhile
+			++n_phydro_calls;
+			lock.unlock();
+			return exact(I0, fapar);
+		}
+		for (auto& r : computed){
+			if (!node_ok[r.first]){
+				nodes[r.first] = r.second;
+				node_ok[r.first] = 1;
+			}
+		}
+		if (cell_state[c] == CELL_UNCHECKED) check_cell(i, j, mid_exact);
+	}
+	if (cell_state[c] == CELL_EXACT){
+		++n_phydro_calls;
+		lock.unlock();
+		return exact(I0, fapar);
+	}
+	return interpolate(i, j, xi-i, xf-j);
+}
+
+} // namespace plant
+
@@ -1,17 +1,97 @@
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <filesystem>
+#include <chrono>
 #include "plant.h"
 using namespace std;
 
 namespace plant{
 
+// Prototypes of parsed parameter files, with the modification time, size and a hash of the file when it was parsed
+struct PrototypeEntry{
+	std::filesystem::file_time_type mtime;
+	std::uintmax_t size;
+	size_t hash;
+	std::filesystem::file_time_type checked;  // time at which the contents were last read
+	std::shared_ptr<const Plant::ParamsPrototype> proto;
+};
+static std::mutex prototypes_mtx;
+static std::map<std::string, PrototypeEntry> prototypes;
+
+// Rewrites within this interval of the last read may not change the modification time (e.g. FAT has 2 s resolution)
+static const auto mtime_resolution = std::chrono::seconds(2);
+
+static std::string canonical_path(const std::string& file){
+	std::error_code ec;
+	auto path = std::filesystem::weakly_canonical(file, ec);
+	return (ec)? file : path.string();
+}
+
+static std::string read_contents(const std::string& file){
+	std::ifstream fin(file, std::ios::binary);
+	if (!fin) throw std::runtime_error("Could not open file " + file);
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+
+std::shared_ptr<const Plant::ParamsPrototype> Plant::params_prototype(std::string file){
+	std::string key = canonical_path(file);
+	std::error_code ec1, ec2;
+	auto mtime = std::filesystem::last_write_time(file, ec1);
+	auto size = std::filesystem::file_size(file, ec2);
+	if (ec1 || ec2) throw std::runtime_error("Could not open file " + file);
+
+	std::lock_guard<std::mutex> lock(prototypes_mtx);
+	auto it = prototypes.find(key);
+	bool same_stamp = (it != prototypes.end() && it->second.mtime == mtime && it->second.size == size);
+	// A file whose stamp has not changed is read again only if it was modified close to the last read, 
+	// when a rewrite could have kept the same modification time
+	if (same_stamp && mtime + mtime_resolution < it->second.checked) return it->second.proto;
+
+	auto now = std::filesystem::file_time_type::clock::now();
+	std::string contents = read_contents(file);
+	size_t hash = std::hash<std::string>{}(contents);
+	if (same_stamp && it->second.hash == hash){
+		it->second.checked = now;
+		return it->second.proto;
+	}
+
+	io::Initializer I(file);
+	I.readFile();
+	auto proto = std::make_shared<ParamsPrototype>();
+	proto->par.initFromInitializer(I);
+	proto->traits.initFromInitializer(I);
+
+	prototypes[key] = {mtime, size, hash, now, proto};
+	return proto;
+}
+
+
+void Plant::clear_params_cache(std::string file){
+	std::lock_guard<std::mutex> lock(prototypes_mtx);
+	if (file.empty()) prototypes.clear();
+	else prototypes.erase(canonical_path(file));
+}
+
 
 void Plant::initParamsFromFile(std::string file){
-	par.initFromFile(file);
-	traits.initFromFile(file);
+	auto proto = params_prototype(file);
+	par = proto->par;
+	traits = proto->traits;
 
 	//seeds_hist.set_interval(par.T_seed_rain_avg);
 
 	coordinateTraits();
 
+	// Each plant initialized from file starts a new table, which is then shared by all its copies (e.g. cohorts of a species)
+	if (par.phydro_cache_tol > 0) assimilator.phydro_cache = std::make_shared<PhydroCache>(par.phydro_cache_tol);
+	else assimilator.phydro_cache.reset();
+
 	//geometry.init(par, traits);
 }
 
@@ -31,7 +111,8 @@ void Plant::coordinateTraits(){
 	par.a = exp(5.886 - 1.4952*traits.hmat/50.876);
 
 	geometry.init(par, traits);
-	
+
+	++traits_revision;
 }
 
 
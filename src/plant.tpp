@@ -1,24 +1,54 @@
 #include <cmath>
+#include <string>
+#include <stdexcept>
 
 namespace plant{
 
 
+// LAI derivatives
+/// @param res     Result of net_production() at the current LAI
+/// @param method  0: finite difference, with a full call to net_production() at `lai + par.dl`. 
+///                1: finite difference, reusing the canopy openness from `res`, which does not depend on LAI. 
+///                   This skips the traversal of the canopy layers, but still makes a second Phydro call, 
+///                   since fapar changes with LAI. 
+/// @return        Derivatives of gpp, npp, and trans, per unit crown area (other fields are not set)
+template<class Env>
+PlantAssimilationResult Plant::lai_derivatives(PlantAssimilationResult& res, Env &env, int method){
+	PlantAssimilationResult d;
+	if (method == 0 || method == 1){
+		double lai_curr = geometry.lai;
+		geometry.set_lai(lai_curr + par.dl);
+		auto res_plus = (method == 0)? assimilator.net_production(env, &geometry, par, traits) 
+		                             : assimilator.net_production(env, &geometry, par, traits, res.c_open_avg);
+		geometry.set_lai(lai_curr);
+
+		d.npp   = (res_plus.npp - res.npp)/geometry.crown_area/par.dl;
+		d.gpp   = (res_plus.gpp - res.gpp)/geometry.crown_area/par.dl;
+		d.trans = (res_plus.trans - res.trans)/geometry.crown_area/par.dl;
+	}
+	else {
+		throw std::runtime_error("Unknown lai_deriv_method " + std::to_string(method));
+	}
+	return d;
+}
+
+
 // LAI model
 template<class Env>
 double Plant::lai_model(PlantAssimilationResult& res, double _dmass_dt_tot, Env &env){
 	double lai_curr = geometry.lai;
-	geometry.set_lai(lai_curr + par.dl);
-	auto res_plus = assimilator.net_production(env, &geometry, par, traits);
-	geometry.set_lai(lai_curr);
-	
-	double dnpp_dL = (res_plus.npp - res.npp)/geometry.crown_area/par.dl;
-	double dgpp_dL = (res_plus.gpp - res.gpp)/geometry.crown_area/par.dl;
-	double dE_dL = (res_plus.trans - res.trans)/geometry.crown_area/par.dl;
-//	double ddpsi_dL = dE_dL * viscosity / (traits.K_xylem * phydro::P(env.clim.swp, traits.p50_xylem, traits.b_xylem)); // FIXME: Need proper unit conversion
 
 	double dL_dt = 0;
-	if (par.optimize_lai) dL_dt = par.response_intensity*(dnpp_dL - par.Chyd*dE_dL - par.Cc*traits.lma); // FIXME: This condition can be applied to the whole block
-	//std::cout << "dnpp_dL = " << dnpp_dL << ", dE_dL = " << 0.001*dE_dL << ", Cc = " << traits.K_leaf << "\n";
+	if (par.optimize_lai){  // derivatives are not needed otherwise
+		auto d = lai_derivatives(res, env, par.lai_deriv_method);
+		double dnpp_dL = d.npp;
+		double dgpp_dL = d.gpp;
+		double dE_dL = d.trans;
+//		double ddpsi_dL = dE_dL * viscosity / (traits.K_xylem * phydro::P(env.clim.swp, traits.p50_xylem, traits.b_xylem)); // FIXME: Need proper unit conversion
+
+		dL_dt = par.response_intensity*(dnpp_dL - par.Chyd*dE_dL - par.Cc*traits.lma);
+		//std::cout << "dnpp_dL = " << dnpp_dL << ", dE_dL = " << 0.001*dE_dL << ", Cc = " << traits.K_leaf << "\n";
+	}
 	
 	if (lai_curr < 0.1) dL_dt = 0;  // limit to prevent LAI going negative
 	
@@ -34,6 +64,10 @@ double Plant::lai_model(PlantAssimilationResult& res, double _dmass_dt_tot, Env
 template<class Env>
 double Plant::p_survival_germination(Env &env){
 	auto res = assimilator.net_production(env, &geometry, par, traits);
+	return p_survival_germination_from_result(res);
+}
+
+inline double Plant::p_survival_germination_from_result(const PlantAssimilationResult &res){
 	double P = std::max(res.npp, 0.0)/geometry.crown_area;
 	double P2 = P*P;
 	double P2_half = par.npp_Sghalf * par.npp_Sghalf;
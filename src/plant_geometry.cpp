@@ -191,7 +191,7 @@ std::vector<double>::iterator PlantGeometry::set_state(std::vector<double>::iter
 // ** 
 void PlantGeometry::grow_for_dt(double t, double dt, double &prod, double &litter_pool, double A, PlantTraits &traits){
 
-	auto derivs = [A, &traits, &litter_pool, this](double t, std::vector<double>&S, std::vector<double>&dSdt){
+	auto derivs = [A, &traits, &litter_pool, this](double t, std::array<double,7>&S, std::array<double,7>&dSdt){
 		set_lai(S[5]);
 		set_size(S[1], traits);
 		litter_pool = S[6];
@@ -226,9 +226,10 @@ void PlantGeometry::grow_for_dt(double t, double dt, double &prod, double &litte
 		k_sap = dSdt[3]/sapwood_mass(traits)*dSdt[1];
 	};
 
-	std::vector<double> S = {prod, get_size(), sap_frac_ode, sapwood_mass_ode, heart_mass_ode, lai, litter_pool};
-	RK4(t, dt, S, derivs);
-	//Euler(t, dt, S, derivs);
+	std::array<double,7> S = {prod, get_size(), sap_frac_ode, sapwood_mass_ode, heart_mass_ode, lai, litter_pool};
+	RK4Integrator<std::array<double,7>> rk4;
+	rk4.step(t, dt, S, derivs);
+	//rk4.euler_step(t, dt, S, derivs);
 	litter_pool = S[6];
 	heart_mass_ode = S[4];
 	sapwood_mass_ode = S[3];
@@ -5,18 +5,33 @@ using namespace std;
 Simulator::Simulator(std::string params_file) : I(params_file), S("IEBT", "rk45ck") {
 	paramsFile = params_file; // = "tests/params/p.ini";
 	I.readFile();
+	configure();
+}
+
+Simulator::Simulator(const io::Initializer &config, std::string params_file) : I(config), S("IEBT", "rk45ck") {
+	paramsFile = params_file;
+	configure();
+}
 
+void Simulator::configure(){
 	parent_dir = I.get<string>("outDir");
 	expt_dir   = I.get<string>("exptName");
 	
 	save_state = (I.get<string>("saveState") == "yes")? true : false;
+	binary_state = (I.getStringOrDefault("stateFormat", "text") == "binary");
 
 	state_outfile  = I.get<string>("savedStateFile");
 	config_outfile = I.get<string>("savedConfigFile");
 
 	continueFrom_stateFile = I.get<string>("continueFromState");
 	continueFrom_configFile = I.get<string>("continueFromConfig");
-	continuePrevious = (continueFrom_configFile != "null") && (continueFrom_stateFile != "null");
+	continuePrevious = (continueFrom_stateFile == "latest") || ((continueFrom_configFile != "null") && (continueFrom_stateFile != "null"));
+
+	if (save_state){
+		checkpoints.interval_years   = std::stod(I.getStringOrDefault("saveStateInterval", "0"));
+		checkpoints.interval_seconds = std::stod(I.getStringOrDefault("saveStateWallInterval", "0"));
+		checkpoints.keep             = std::stoi(I.getStringOrDefault("checkpointsToKeep", "3"));
+	}
 
 	evolve_traits = (I.get<string>("evolveTraits") == "yes")? true : false;
 
@@ -27,6 +42,9 @@ Simulator::Simulator(std::string params_file) : I(params_file), S("IEBT", "rk45c
 	co2_file = I.get<string>("co2File");
 
 	solver_method = I.get<string>("solver");
+	n_threads = I.getScalarOrDefault("n_threads", 1);
+
+	rng.seed(I.getScalarOrDefault("randomSeed", 1));
 }
 
 void Simulator::init(double tstart, double tend){
@@ -46,14 +64,25 @@ void Simulator::init(double tstart, double tend){
 	yf = tend;   //I.getScalar("yearf");
 	ye = y0 + 120;  // year in which trait evolution starts (need to allow this period because r0 is averaged over previous time)
 
+#ifdef PLANTFATE_PROFILE
+	profile.open(out_dir + "/" + I.getStringOrDefault("profileFile", "profile.txt"));
+#endif
+
 	// ~~~~~~~ Set up environment ~~~~~~~~~~~~~~~
 	E.metFile = met_file;
 	E.co2File = co2_file;
+	string met_mode = I.getStringOrDefault("metFileMode", "csv");
+	if      (met_mode == "csv")    E.met_mode = env::ClimateForcing::MET_CSV;
+	else if (met_mode == "cache")  E.met_mode = env::ClimateForcing::MET_CACHE;
+	else if (met_mode == "stream") E.met_mode = env::ClimateForcing::MET_STREAM;
+	else throw std::runtime_error("Unknown metFileMode " + met_mode + " (use csv, cache or stream)");
 	E.init();
+	E.interpolate = (I.getStringOrDefault("interpolateClimate", "no") == "yes");
 	E.print(0);
 	E.use_ppa = true;
 	E.update_met = true;
 	E.update_co2 = true;
+	E.set_n_threads(n_threads);
 
 	// ~~~~~~~~~~ Create solver ~~~~~~~~~~~~~~~~~~~~~~~~~
 	S = Solver(solver_method, "rk45ck");
@@ -67,6 +96,10 @@ void Simulator::init(double tstart, double tend){
 
 	// Add species
 	if (continuePrevious){
+		if (continueFrom_stateFile == "latest"){
+			if (!Checkpointer::find_latest(out_dir + "/checkpoints", continueFrom_stateFile, continueFrom_configFile)) 
+				throw std::runtime_error("No checkpoint found in " + out_dir + "/checkpoints");
+		}
 		restoreState(&S, continueFrom_stateFile, continueFrom_configFile);
 		y0 = S.current_time; // replace y0
 	}
@@ -98,18 +131,31 @@ void Simulator::init(double tstart, double tend){
 	S.print();	
 
 	sio.S = &S;
+	sio.binary_output = (I.getStringOrDefault("outputFormat", "text") == "binary");
+	sio.async_output = (I.getStringOrDefault("asyncOutput", "no") == "yes");
+	sio.queue_capacity = I.getScalarOrDefault("outputQueueSize", 16);
+	sio.resume_output = continuePrevious;  // output up to the restored state is kept
+	sio.resume_time = y0;
 	sio.openStreams(out_dir, I);
+
+	checkpoints.dir = out_dir + "/checkpoints";
+	checkpoints.params_file = paramsFile;
+	checkpoints.binary = binary_state;
+	checkpoints.start(y0);
 }
 
 
 void Simulator::close(){
 	//S.print();
-	sio.closeStreams();
+	sio.closeStreams();  // waits for pending output to be written
+	profile.close();
+	checkpoints.wait();
 
 	saveState(&S, 
 	          out_dir + "/" + state_outfile, 
 			  out_dir + "/" + config_outfile, 
-			  paramsFile);
+			  paramsFile,
+			  binary_state);
 
 	// free memory associated
 	for (auto s : S.species_vec) delete static_cast<MySpecies<PSPM_Plant>*>(s); 
@@ -118,7 +164,7 @@ void Simulator::close(){
 
 
 double Simulator::runif(double rmin, double rmax){
-	double r = double(rand())/RAND_MAX; 
+	double r = double(rng() - rng.min())/(rng.max() - rng.min()); 
 	return rmin + (rmax-rmin)*r;
 }
 
@@ -203,6 +249,10 @@ void Simulator::addSpeciesAndProbes(Solver *S, string params_file, io::Initializ
 
 	spp->seeds_hist.set_interval(T_seed_rain_avg);
 
+	// histories get one point per step, so preallocate for the whole averaging interval
+	spp->r0_hist.set_capacity(int(spp->r0_hist.T/delta_T) + 2);
+	spp->seeds_hist.set_capacity(int(spp->seeds_hist.T/delta_T) + 2);
+
 	if (evolve_traits) spp->createVariants(p1);
 
 	// Add resident species to solver
@@ -220,84 +270,108 @@ void Simulator::addSpeciesAndProbes(Solver *S, string params_file, io::Initializ
 
 
 void Simulator::simulate(){
+	for (double t=y0; t <= yf; t=t+delta_T) {
+		step_to(t);
+	}
+}
+
+
+void Simulator::step_to(double t){
+	// A resumed run starts from the state saved at the end of step y0, so that step has already been taken and written
+	if (continuePrevious && t == y0) return;
 
 	auto after_step = [this](double t){
 		calc_seed_output(t, S);
 		calc_r0(t, timestep, S);
 	};
 
-	for (double t=y0; t <= yf; t=t+delta_T) {
+	if (verbose){
 		cout << "stepping = " << setprecision(6) << S.current_time << " --> " << t << "\t(";
 		for (auto spp : S.species_vec) cout << spp->xsize() << ", ";
 		cout << ")" << endl;
+	}
 
-		S.step_to(t, after_step);
+	S.step_to(t, after_step);
 
-		// debug: r0 calc can be done here, it should give approx identical result compared to when r0_calc is dont in preCompute
-		// S.step_to(t); //, after_step);
-		// if (t > y0) after_step(t);
-		// if (t > y0) calc_r0(t, delta_T, S);
-		// //S.print(); cout.flush();
+	// debug: r0 calc can be done here, it should give approx identical result compared to when r0_calc is dont in preCompute
+	// S.step_to(t); //, after_step);
+	// if (t > y0) after_step(t);
+	// if (t > y0) calc_r0(t, delta_T, S);
+	// //S.print(); cout.flush();
 
-		cwm.update(t, S);
-		props.update(t, S);
-			
-		sio.writeState(t, cwm, props);
-	
-		// evolve traits
-		if (evolve_traits){
-			if (t > ye){
-				for (auto spp : S.species_vec) static_cast<MySpecies<PSPM_Plant>*>(spp)->calcFitnessGradient();
-				for (auto spp : S.species_vec) static_cast<MySpecies<PSPM_Plant>*>(spp)->evolveTraits(delta_T);
-			}
+	integrals.compute(t, S);
+	cwm.update(t, S, integrals);
+	props.update(t, S, integrals);
+		
+	sio.writeState(t, cwm, props);
+
+	// evolve traits
+	if (evolve_traits){
+		if (t > ye){
+			PF_PROFILE_SCOPE(TRAIT_EVOLUTION);
+			for (auto spp : S.species_vec) static_cast<MySpecies<PSPM_Plant>*>(spp)->calcFitnessGradient();
+			for (auto spp : S.species_vec) static_cast<MySpecies<PSPM_Plant>*>(spp)->evolveTraits(delta_T);
 		}
+	}
 
-		// // Remove dead species
-		// vector<MySpecies<PSPM_Plant>*> toRemove;
-		// for (int k=0; k<S.species_vec.size(); ++k){
-		// 	auto spp = static_cast<MySpecies<PSPM_Plant>*>(S.species_vec[k]);
-		// 	if (spp->isResident){
-		// 		if (cwm.n_ind_vec[k] < 1e-6 && (t-spp->t_introduction) > 50) toRemove.push_back(spp);
-		// 	}
-		// }
-		// for (auto spp : toRemove) removeSpeciesAndProbes(&S, spp);
-
-		// // Shuffle species in the species vector -- just for debugging
-		// if (int(t) % 10 == 0){
-		// 	cout << "shuffling...\n";
-		// 	std::random_shuffle(S.species_vec.begin(), S.species_vec.end());
-		// 	S.copyCohortsToState();
-		// }
-
-		// // Invasion by a random new species
-		// if (int(t) % 300 == 0){
-		// 	cout << "**** Invasion ****\n";
-		// 	addSpeciesAndProbes(&S, paramsFile, I,
-		// 	                    t, 
-		// 	                    "spp_t"+to_string(t), 
-		// 	                    runif(0.05, 0.25),    //Tr.species[i].lma, 
-		// 	                    runif(300, 900),   //Tr.species[i].wood_density, 
-		// 	                    runif(2, 35),      //Tr.species[i].hmat, 
-		// 	                    runif(-6, -0.5)   //Tr.species[i].p50_xylem);
-		// 	);
-		// }
-
-		// clear patch after 50 year	
-		if (t >= t_clear){
-			for (auto spp : S.species_vec){
-				for (int i=0; i<spp->xsize(); ++i){
-					auto& p = (static_cast<MySpecies<PSPM_Plant>*>(spp))->getCohort(i);
-					p.geometry.lai = p.par.lai0;
-					double u_new = spp->getU(i) * 0 * double(rand())/RAND_MAX;
-					spp->setU(i, u_new);
-				}
-				spp->setX(spp->xsize()-1, 0);
+	// // Remove dead species
+	// vector<MySpecies<PSPM_Plant>*> toRemove;
+	// for (int k=0; k<S.species_vec.size(); ++k){
+	// 	auto spp = static_cast<MySpecies<PSPM_Plant>*>(S.species_vec[k]);
+	// 	if (spp->isResident){
+	// 		if (cwm.n_ind_vec[k] < 1e-6 && (t-spp->t_introduction) > 50) toRemove.push_back(spp);
+	// 	}
+	// }
+	// for (auto spp : toRemove) removeSpeciesAndProbes(&S, spp);
+
+	// // Shuffle species in the species vector -- just for debugging
+	// if (int(t) % 10 == 0){
+	// 	cout << "shuffling...\n";
+	// 	std::random_shuffle(S.species_vec.begin(), S.species_vec.end());
+	// 	S.copyCohortsToState();
+	// }
+
+	// // Invasion by a random new species
+	// if (int(t) % 300 == 0){
+	// 	cout << "**** Invasion ****\n";
+	// 	addSpeciesAndProbes(&S, paramsFile, I,
+	// 	                    t, 
+	// 	                    "spp_t"+to_string(t), 
+	// 	                    runif(0.05, 0.25),    //Tr.species[i].lma, 
+	// 	                    runif(300, 900),   //Tr.species[i].wood_density, 
+	// 	                    runif(2, 35),      //Tr.species[i].hmat, 
+	// 	                    runif(-6, -0.5)   //Tr.species[i].p50_xylem);
+	// 	);
+	// }
+
+	// clear patch after 50 year	
+	if (t >= t_clear){
+		for (auto spp : S.species_vec){
+			for (int i=0; i<spp->xsize(); ++i){
+				auto& p = (static_cast<MySpecies<PSPM_Plant>*>(spp))->getCohort(i);
+				p.geometry.lai = p.par.lai0;
+				double u_new = spp->getU(i) * 0;
+				spp->setU(i, u_new);
 			}
-			S.copyCohortsToState();
-			double t_int = -log(double(rand())/RAND_MAX) * I.getScalar("T_return");
-			t_clear = t + fmin(t_int, 1000);
+			spp->setX(spp->xsize()-1, 0);
 		}
-		
+		S.copyCohortsToState();
+		draw_next_disturbance(t);
 	}
-	
+
+	// checkpoints hold the state at the end of the step, like the state saved by close()
+	if (checkpoints.enabled() && checkpoints.due(t)) checkpoints.save(t, &S);
+
+	profile.record(t);
+}
+
+
+void Simulator::set_random_seed(unsigned seed){
+	rng.seed(seed);
+}
+
+
+void Simulator::draw_next_disturbance(double t){
+	double t_int = -log(runif()) * I.getScalar("T_return");
+	t_clear = t + fmin(t_int, 1000);
 }
\ No newline at end of file
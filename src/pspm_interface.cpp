@@ -39,8 +39,16 @@ double PSPM_Plant::init_density(double x, void * _env, double input_seed_rain){
 
 
 void PSPM_Plant::preCompute(double x, double t, void * _env){
+	PF_PROFILE_SCOPE(PRECOMPUTE);
+#ifdef PLANTFATE_PROFILE
+	++nrc;
+#endif
 	EnvUsed * env = (EnvUsed*)_env;
 	calc_demographic_rates(*env, t);
+	rates_env_update = env->n_env_updates;
+	rates_x = geometry.get_size();
+	rates_lai = geometry.lai;
+	rates_traits_revision = traits_revision;
 //	double p_plant_survival = exp(-vars.mortality);
 //	//viable_seeds_dt = vars.fecundity_dt; // only for single-plant testrun
 //	viable_seeds_dt = vars.fecundity_dt * p_plant_survival * env->patch_survival(t) / env->patch_survival(t_birth);
@@ -54,8 +62,13 @@ void PSPM_Plant::afterStep(double x, double t, void * _env){
 }
 
 // Probability that a fresh seed survives to become a seedling
+// If the rates of this plant were precomputed in the current environment and state (as they are for the 
+// boundary cohort before the solver asks for its birth flux), the assimilation result is reused.
 double PSPM_Plant::establishmentProbability(double t, void * _env){
 	EnvUsed * env = (EnvUsed*)_env;
+	if (rates_env_update == env->n_env_updates && rates_x == geometry.get_size() && rates_lai == geometry.lai && rates_traits_revision == traits_revision){
+		return p_survival_dispersal(env) * p_survival_germination_from_result(res);
+	}
 	return p_survival_dispersal(env) * p_survival_germination(*env);
 }
 
@@ -65,12 +78,18 @@ double PSPM_Plant::growthRate(double x, double t, void * _env){
 }
 
 double PSPM_Plant::mortalityRate(double x, double t, void * _env){
+#ifdef PLANTFATE_PROFILE
+	++ndc;
+#endif
 	double mort = rates.dmort_dt;
 //	double mort_cndd = 
 	return mort;
 }
 
 double PSPM_Plant::birthRate(double x, double t, void * _env){
+#ifdef PLANTFATE_PROFILE
+	++nbc;
+#endif
 //	if (par.T_seed_rain_avg > 0){ 
 //		return seeds_hist.get(); // birth rate is moving average of rate of germinating seeds over successional cycles
 //	}          
@@ -150,6 +169,50 @@ void PSPM_Plant::restore(std::istream &fin){
 // ********** PSPM_Dynamic_Environment **********************
 // **********************************************************
 
+/// @ingroup    ppa_module
+/// @brief      Gather the properties of all cohorts of resident species into the cohort geometry cache.
+/// @param S    Pointer to the Solver being used.
+/// @details    Called at the beginning of computeEnv(), since cohorts may have changed since the last call.
+void PSPM_Dynamic_Environment::refresh_cohort_cache(Solver *S){
+	fill_cohort_cache(S, cohort_cache);
+}
+
+/// @ingroup    ppa_module
+/// @brief      Gather the properties of all cohorts of resident species into the given cache.
+/// @param S      Pointer to the Solver being used.
+/// @param cache  Cache to fill, e.g. a copy owned by a diagnostics calculation
+void PSPM_Dynamic_Environment::fill_cohort_cache(Solver *S, env::CohortGeometryCache &cache){
+	cache.resize(S->species_vec.size());
+	for (int k=0; k<S->species_vec.size(); ++k){
+		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[k]);
+		auto& c = cache.species[k];
+		
+		// mutants are not part of the light environment
+		c.resident = spp->isResident;
+		if (!c.resident){
+			c.resize(-1);
+			continue;
+		}
+
+		c.resize(spp->xsize());
+		for (int i=-1; i<spp->xsize(); ++i){
+			auto& p = spp->getCohort(i);
+			int j = c.col(i);
+			c.u[j]          = spp->getU(i);
+			c.height[j]     = p.geometry.height;
+			c.crown_area[j] = p.geometry.crown_area;
+			c.lai[j]        = p.geometry.lai;
+			c.zm[j]         = p.geometry.zm();
+			c.qm[j]         = p.geometry.geom.qm;
+			c.m[j]          = p.geometry.geom.m;
+			c.n[j]          = p.geometry.geom.n;
+			c.fg[j]         = p.geometry.geom.fg;
+			c.k_light[j]    = p.par.k_light;
+		}
+	}
+}
+
+
 /// @ingroup    ppa_module
 /// @brief      Calculate the total crown area above height z, contributed by all individuals of the resident species.
 /// @param t    Time in current timestep.
@@ -160,57 +223,137 @@ void PSPM_Plant::restore(std::istream &fin){
 ///             where \f$A_{cp}\f$ is the projected crown area at height z, including area covered by gaps. This is
 ///             calculated by the function plant::PlantGeometry::crown_area_extent_projected.  
 ///             The total crown area above z is the \f[A = \sum_k {A_k}\f]
+///             Cohort properties are read from the cohort geometry cache.
 double PSPM_Dynamic_Environment::projected_crown_area_above_z(double t, double z, Solver *S){
 	double ca_above_z = 0;
 	// Loop over resident species --->
 	for (int k=0; k<S->species_vec.size(); ++k){
 
 		// skip mutants
-		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[k]);
-		if (!spp->isResident) continue;
+		auto& c = cohort_cache.species[k];
+		if (!c.resident) continue;
 
-		auto ca_above = [z,spp](int i, double t){
-			auto& p = spp->getCohort(i);
-//				double a = p.area_leaf_above(z, p.vars.height, p.vars.area_leaf);
-			double ca_p = p.geometry.crown_area_extent_projected(z, p.traits);
-//				std::cout << "(" << i << "," << p.geometry.get_size() << ", " << p.geometry.diameter << ", " << p.geometry.height << ", " << p.u << ", " << p.geometry.crown_area << " | " << ca_p << ")" << "\n";
-			return ca_p;	
+		if (use_crown_kernel){
+			c.crown_area_extent_projected(z, crown_area_buffer);
+			ca_above_z += S->integrate_x([&c,this](int i, double t){ return crown_area_buffer[c.col(i)]; }, t, k);
+			continue;
+		}
+
+		auto ca_above = [z,&c](int i, double t){
+			return c.crown_area_extent_projected(c.col(i), z);
 		};
 //			ca_above_z += S->integrate_wudx_above(ca_above, t, z, k);
-//			std::cout << "\n";
 		ca_above_z += S->integrate_x(ca_above, t, k);
 	}
 	return ca_above_z;	
 }
 
+/// @ingroup    ppa_module
+/// @brief      Collect the crowns of all individuals of the resident species into the cumulative crown area profile.
+/// @param t    Time in current timestep.
+/// @param S    Pointer to the Solver being used.
+/// @details    The cohorts are collected by the solver's own integral over each species, so the profile contains
+///             exactly the cohorts that the solver integrates over (including the boundary cohort if the solver 
+///             counts it). Each cohort is weighted by its density, which assumes that the solver integrates over 
+///             cohorts as \f$\sum_i u_i f_i\f$ (as in the EBT family of methods). The caller should check that the 
+///             total area of the profile matches that calculated by projected_crown_area_above_z().
+///             The visited cohorts are also used by fapar_all_layers().
+void PSPM_Dynamic_Environment::build_crown_profile(double t, Solver *S){
+	crown_profile.clear();
+	profile_cols.resize(cohort_cache.species.size());
+	for (int k=0; k<cohort_cache.species.size(); ++k){
+		auto& c = cohort_cache.species[k];
+		profile_cols[k].clear();
+		if (!c.resident) continue;
+
+		auto add_cohort = [&c, k, this](int i, double t){
+			int j = c.col(i);
+			profile_cols[k].push_back(j);
+			crown_profile.add_crown(c.u[j], c.crown_area[j], c.height[j], c.zm[j], c.m[j], c.n[j], c.qm[j]);
+			return 0.0;
+		};
+		S->integrate_x(add_cohort, t, k);
+	}
+	crown_profile.build();
+}
+
 /// @ingroup    ppa_module
 double PSPM_Dynamic_Environment::fapar_layer(double t, int layer, Solver *S){
+	PF_PROFILE_SCOPE(FAPAR);
 
 	double photons_abs = 0;
 	for (int k=0; k<S->species_vec.size(); ++k){
 		
 		// skip mutants
-		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[k]);
-		if (!spp->isResident) continue;
+		auto& c = cohort_cache.species[k];
+		if (!c.resident) continue;
 
-		auto photons_absorbed_plant_layer = [layer,spp, this](int i, double t){
-			auto& p = spp->getCohort(i);
+		auto photons_absorbed_plant_layer = [layer, &c, this](int i, double t){
+			int j = c.col(i);
 
-			double cap_z    =            p.geometry.crown_area_above(z_star[layer], p.traits);
-			double cap_ztop = (layer>0)? p.geometry.crown_area_above(z_star[layer-1], p.traits) : 0;
+			double cap_z    =            c.crown_area_above(j, z_star[layer]);
+			double cap_ztop = (layer>0)? c.crown_area_above(j, z_star[layer-1]) : 0;
 			double cap_layer = cap_z - cap_ztop;
 			
-			double Iabs_plant_layer = cap_layer * (1 - exp(-p.par.k_light * p.geometry.lai));
-//				std::cout << "(" << i << "," << p.geometry.diameter << ", " << p.geometry.height << ", " << p.u << ", " << p.geometry.crown_area << ", " << cap_layer << ", " << p.geometry.lai << " | " << Iabs_plant_layer << ")" << "\n";
+			double Iabs_plant_layer = cap_layer * (1 - exp(-c.k_light[j] * c.lai[j]));
 			return Iabs_plant_layer;
 		};
-//			std::cout << "\n";
 		photons_abs += S->integrate_x(photons_absorbed_plant_layer, t, k);
 	}		
 	return photons_abs;
 }
 
 
+/// @ingroup    ppa_module
+/// @brief      Calculate the fraction of light absorbed in all layers in a single pass over cohorts.
+/// @param t    Time in current timestep.
+/// @param S    Pointer to the Solver being used.
+/// @details    Fused version of fapar_layer(). Each cohort is visited once: its crown area above each 
+///             layer boundary below its height is evaluated once, and the absorbed photons are added 
+///             to every layer spanned by the crown. Layers above the plant height receive nothing from it. 
+///             The cohorts and their weights are those of build_crown_profile(), which must be called first.
+///             Results are written to `fapar_tot`, which must be sized to `n_layers`.
+///             With `use_crown_kernel`, the crown areas of all cohorts are instead evaluated in batches, one layer at a time.
+void PSPM_Dynamic_Environment::fapar_all_layers(double t, Solver *S){
+	PF_PROFILE_SCOPE(FAPAR);
+	std::fill(fapar_tot.begin(), fapar_tot.end(), 0);
+
+	for (int k=0; k<cohort_cache.species.size(); ++k){
+		auto& c = cohort_cache.species[k];
+		if (!c.resident) continue;
+
+		if (use_crown_kernel){
+			auto& w = absorption_buffer;
+			auto& cap_ztop = crown_area_top_buffer;
+			w.resize(c.size());
+			cap_ztop.assign(c.size(), 0);
+			for (int j : profile_cols[k]) w[j] = c.u[j] * (1 - exp(-c.k_light[j] * c.lai[j]));
+			for (int layer = 0; layer < n_layers; ++layer){
+				c.crown_area_above(z_star[layer], crown_area_buffer);
+				for (int j : profile_cols[k]) fapar_tot[layer] += w[j] * (crown_area_buffer[j] - cap_ztop[j]);
+				cap_ztop.swap(crown_area_buffer);
+			}
+			continue;
+		}
+
+		for (int j : profile_cols[k]){
+			double w = c.u[j] * (1 - exp(-c.k_light[j] * c.lai[j]));
+			double H = c.height[j];
+
+			// top-most layer that the crown reaches (z_star is in decreasing order)
+			int layer0 = std::partition_point(z_star.begin(), z_star.begin()+n_layers, [H](double z){ return z >= H; }) - z_star.begin();
+
+			double cap_ztop = 0;  // crown area above the top of layer0 is zero
+			for (int layer = layer0; layer < n_layers; ++layer){
+				double cap_z = c.crown_area_above(j, z_star[layer]);
+				fapar_tot[layer] += w * (cap_z - cap_ztop);
+				cap_ztop = cap_z;
+			}
+		}
+	}
+}
+
+
 /// @brief        Solver interface for updating the environment from the given state.
 /// @param t      Time in current timestep.
 /// @param S      Pointer to the Solver being used, provided for computing state integrals. The Solver provides this via a `this` reference. 
@@ -231,6 +374,11 @@ double PSPM_Dynamic_Environment::fapar_layer(double t, int layer, Solver *S){
 /// variables if any such have been added as system variables - e.g., species-level seed pools can be implemented 
 /// through this mechanism. 
 void PSPM_Dynamic_Environment::computeEnv(double t, Solver *S, std::vector<double>::iterator _S, std::vector<double>::iterator _dSdt){
+	PF_PROFILE_SCOPE(COMPUTE_ENV);
+	++n_env_updates;
+	// rates computed in a previous environment must not be reused
+	for (auto s : S->species_vec) static_cast<MySpecies<PSPM_Plant>*>(s)->clear_precomputed();
+
 	updateClimate(t);
 
 	//            _xm 
@@ -239,6 +387,7 @@ void PSPM_Dynamic_Environment::computeEnv(double t, Solver *S, std::vector<doubl
 	if (use_ppa){
 		double fG = 0.99;
 		z_star.clear();
+		refresh_cohort_cache(S);
 		total_crown_area = projected_crown_area_above_z(t, 0, S);
 		n_layers = int(total_crown_area/fG); // Total crown projection area 
 
@@ -249,13 +398,31 @@ void PSPM_Dynamic_Environment::computeEnv(double t, Solver *S, std::vector<doubl
 //			if (n_layers > 5) n_layers = 5;
 		assert(n_layers >= 0 && n_layers < 50);
 
-		for (int layer = 1; layer <= n_layers; ++layer){
-			auto CA_above_zstar_layer = [t, S, layer, fG, this](double z) -> double {
-				return projected_crown_area_above_z(t, z, S) - layer*fG;
-			};
-			auto res = pn::zero(0, 100, CA_above_zstar_layer, 1e-4);
-			z_star.push_back(res.root);
-//				std::cout << "z*(" << layer << ") = " << res.root << ", CA(z*) = " << projected_crown_area_above_z(t, res.root, S) << ", " << "iter = " << res.nfnct << "\n";
+		// The crown area profile and the fused fapar kernel weight cohorts by their density. 
+		// This is only valid if these weights reproduce the solver's integral
+		bool cohort_sum_ok = false;
+		if (use_crown_profile || use_fused_fapar){
+			build_crown_profile(t, S);
+			cohort_sum_ok = fabs(crown_profile.total() - total_crown_area) <= 1e-8*std::max(1.0, total_crown_area);
+			if (!cohort_sum_ok){
+				if (n_crown_profile_fallbacks++ == 0) std::cerr << "Warning: t = " << t << ": crown area profile (" << crown_profile.total() << ") does not match solver integral (" << total_crown_area << "). Falling back to per-layer integration for z* and fapar (reported once, see n_crown_profile_fallbacks).\n";
+			}
+		}
+
+		if (use_crown_profile && cohort_sum_ok){
+			PF_PROFILE_SCOPE(Z_STAR);
+			z_star = crown_profile.solve_z_star(n_layers, fG);
+		}
+		else {
+			PF_PROFILE_SCOPE(Z_STAR);
+			for (int layer = 1; layer <= n_layers; ++layer){
+				auto CA_above_zstar_layer = [t, S, layer, fG, this](double z) -> double {
+					return projected_crown_area_above_z(t, z, S) - layer*fG;
+				};
+				auto res = pn::zero(0, 100, CA_above_zstar_layer, z_star_tol);
+				z_star.push_back(res.root);
+//					std::cout << "z*(" << layer << ") = " << res.root << ", CA(z*) = " << projected_crown_area_above_z(t, res.root, S) << ", " << "iter = " << res.nfnct << "\n";
+			}
 		}
 		z_star.push_back(0);
 		//std::cout << "z*_vec (" << z_star.size() << ") = "; for(auto z: z_star) std::cout << z << " "; cout << "\n"; cout.flush();
@@ -265,12 +432,18 @@ void PSPM_Dynamic_Environment::computeEnv(double t, Solver *S, std::vector<doubl
 		canopy_openness.resize(n_layers+1);  
 		fapar_tot.resize(n_layers);
 		canopy_openness[0] = 1; // top layer gets 100% light
+		if (use_fused_fapar && cohort_sum_ok){
+			fapar_all_layers(t, S);
+		}
+		else {
+			for (int layer = 0; layer < n_layers; ++layer) fapar_tot[layer] = fapar_layer(t, layer, S);
+		}
 		for (int layer = 0; layer < n_layers; ++layer){  
-			fapar_tot[layer] = fapar_layer(t, layer, S);
 			canopy_openness[layer+1] = canopy_openness[layer] * (1-fapar_tot[layer]);
 		}
 		
-		
+		// The light environment is now fixed, so rates of all cohorts can be computed in parallel
+		if (thread_pool) precompute_all_cohorts(t, S);
 	}
 	else{
 		throw std::runtime_error("Only PPA mode is implemented currently. Set use_ppa to true");
@@ -290,6 +463,53 @@ void PSPM_Dynamic_Environment::computeEnv(double t, Solver *S, std::vector<doubl
 }
 
 
+/// @brief      Set the number of threads used to compute demographic rates of cohorts. 
+/// @param n    Number of threads. With n <= 1, rates are computed serially by the solver.
+void PSPM_Dynamic_Environment::set_n_threads(int n){
+	if (n > 1) thread_pool = std::make_shared<ThreadPool>(n);
+	else thread_pool.reset();
+}
+
+int PSPM_Dynamic_Environment::get_n_threads(){
+	return (thread_pool)? thread_pool->size() : 1;
+}
+
+/// Thread pool set by set_n_threads(), or nullptr if running serially
+ThreadPool * PSPM_Dynamic_Environment::get_thread_pool(){
+	return thread_pool.get();
+}
+
+
+/// @brief      Compute demographic rates of all cohorts of all species (including mutants) in parallel.
+/// @param t    Current time
+/// @param S    Pointer to the Solver being used.
+/// @details    This calls PSPM_Plant::preCompute() for every cohort, as the solver does after computeEnv(). 
+///             Each task covers a chunk of cohorts of one species, and only writes to those cohorts, 
+///             so results are identical to a serial run. Species are marked as precomputed at t, together with
+///             their cohort states, so that the subsequent call to MySpecies::preComputeAllCohorts() by the solver
+///             is skipped if the cohorts have not changed in between.
+void PSPM_Dynamic_Environment::precompute_all_cohorts(double t, Solver *S){
+	struct Task {int k, begin, end;};
+	std::vector<Task> tasks;
+	int chunk = std::max(precompute_chunk_size, 1);
+	for (int k=0; k<S->species_vec.size(); ++k){
+		int n = S->species_vec[k]->xsize();
+		for (int i=-1; i<n; i += chunk) tasks.push_back({k, i, std::min(i+chunk, n)}); // i = -1 is the boundary cohort
+	}
+
+	thread_pool->parallel_for(tasks.size(), [&tasks, t, S, this](int id){
+		auto& task = tasks[id];
+		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[task.k]);
+		for (int i=task.begin; i<task.end; ++i){
+			auto& p = spp->getCohort(i);
+			p.preCompute(p.x, t, this);
+		}
+	});
+
+	for (auto s : S->species_vec) static_cast<MySpecies<PSPM_Plant>*>(s)->set_precomputed(t);
+}
+
+
 void PSPM_Dynamic_Environment::print(double t){
 	Climate::print(t);
 	LightEnvironment::print();
@@ -6,6 +6,12 @@ using namespace Rcpp;
 RCPP_MODULE(treelife_module){
 	class_ <LifeHistoryOptimizer>("LifeHistoryOptimizer")
 		.field("params_file", &LifeHistoryOptimizer::params_file)
+		.field("n_threads", &LifeHistoryOptimizer::n_threads)
+		.field("integrator", &LifeHistoryOptimizer::integrator)
+		.field("rtol", &LifeHistoryOptimizer::rtol)
+		.field("atol", &LifeHistoryOptimizer::atol)
+		.field_readonly("n_derivs", &LifeHistoryOptimizer::n_derivs)
+		.field_readonly("n_derivs_saved", &LifeHistoryOptimizer::n_derivs_saved)
 		
 		.constructor()
 		.method("set_traits", &LifeHistoryOptimizer::set_traits)
@@ -13,12 +19,15 @@ RCPP_MODULE(treelife_module){
 		.method("init", &LifeHistoryOptimizer::init)
 		.method("printPlant", &LifeHistoryOptimizer::printPlant)
 		.method("calcFitness", &LifeHistoryOptimizer::calcFitness)
+		.method("calcFitness_batch", &LifeHistoryOptimizer::calcFitness_batch)
 
 		.method("grow_for_dt", &LifeHistoryOptimizer::grow_for_dt)
 	;
 }
 
 #include "plantfate.h"
+#include "multipatch.h"
+#include "ensemble.h"
 
 RCPP_MODULE(plantfate_module){
 	class_ <Simulator>("Simulator")
@@ -43,5 +52,51 @@ RCPP_MODULE(plantfate_module){
 		.field("yf", &Simulator::yf)
 		.field("ye", &Simulator::ye)
 	;
+
+	class_ <MultiPatchSimulator>("MultiPatchSimulator")
+		.constructor<std::string>()
+		.method("init", &MultiPatchSimulator::init)
+		.method("simulate", &MultiPatchSimulator::simulate)
+		.method("close", &MultiPatchSimulator::close)
+
+		.field("paramsFile", &MultiPatchSimulator::paramsFile)
+		.field("parent_dir", &MultiPatchSimulator::parent_dir)
+		.field("expt_dir", &MultiPatchSimulator::expt_dir)
+		.field("n_patches", &MultiPatchSimulator::n_patches)
+		.field("n_threads", &MultiPatchSimulator::n_threads)
+		.field("seed", &MultiPatchSimulator::seed)
+	;
+
+	class_ <EnsembleRunner>("EnsembleRunner")
+		.constructor<std::string>()
+		.method("add_member", &EnsembleRunner::add_member)
+		.method("read_members", &EnsembleRunner::read_members)
+		.method("run", &EnsembleRunner::run)
+		.method("get_errors", &EnsembleRunner::get_errors)
+
+		.field("paramsFile", &EnsembleRunner::paramsFile)
+		.field("parent_dir", &EnsembleRunner::parent_dir)
+		.field("expt_dir", &EnsembleRunner::expt_dir)
+		.field("n_threads", &EnsembleRunner::n_threads)
+	;
+}
+
+
+#include "columnar_io.h"
+
+/// Read a binary columnar output file (.pfc) into a data.frame
+Rcpp::DataFrame read_columnar(std::string file){
+	io::ColumnReader reader;
+	reader.read(file);
+	Rcpp::List cols;
+	for (int i=0; i<reader.names.size(); ++i){
+		if (reader.types[i] == io::ColumnWriter::STRING) cols.push_back(Rcpp::CharacterVector(reader.strings[i].begin(), reader.strings[i].end()), reader.names[i]);
+		else cols.push_back(Rcpp::NumericVector(reader.numeric[i].begin(), reader.numeric[i].end()), reader.names[i]);
+	}
+	return Rcpp::DataFrame(cols);
+}
+
+RCPP_MODULE(output_module){
+	function("read_columnar", &read_columnar);
 }
 
@@ -1,8 +1,34 @@
 #include "state_restore.h"
 #include <filesystem>
+#include <sstream>
+#include <algorithm>
+#include <utils/binary_io.h>
 using namespace std;
 
-void saveState(Solver *S, string state_outfile, string config_outfile, string params_file){
+// Header of binary state files. The format version follows as a uint32.
+static const char STATE_MAGIC[8] = {'P','F','S','T','A','T','E','\0'};
+static const uint32_t STATE_VERSION = 2;
+
+static string serializeState_binary(Solver *S);
+static void restoreState_binary(Solver *S, string state_infile, string config_infile);
+
+
+// Solver::save() and Solver::restore() are declared by libpspm with std::ofstream/std::ifstream arguments,
+// so the in-memory buffer is attached to an unopened file stream only for these calls.
+static void save_solver(Solver *S, std::stringbuf &buf, int precision){
+	ofstream fout;
+	fout.std::ios::rdbuf(&buf);
+	fout << setprecision(precision);
+	S->save(fout);
+}
+
+static void restore_solver(Solver *S, std::stringbuf &buf, vector<Species_Base*> &spp_proto){
+	ifstream fin;
+	fin.std::ios::rdbuf(&buf);
+	S->restore(fin, spp_proto);
+}
+
+void saveState(Solver *S, string state_outfile, string config_outfile, string params_file, bool binary){
 
 	cout << "Saving state to: " << state_outfile << '\n';
 	cout << "Saving config to: " << config_outfile << '\n';
@@ -13,9 +39,23 @@ void saveState(Solver *S, string state_outfile, string config_outfile, string pa
 	if (std::filesystem::exists(config_outfile)) std::filesystem::remove(config_outfile); // use this because the overwrite flag in below command does not work!
 	std::filesystem::copy(params_file, config_outfile, std::filesystem::copy_options::overwrite_existing);
 
+	string state = serializeState(S, binary);
+
 	// open file for writing state
-	ofstream fout(state_outfile.c_str());
+	ofstream fout(state_outfile.c_str(), ios::binary);
 	if (!fout) throw runtime_error("Could not open file for saving state: "+state_outfile);
+	fout.write(state.data(), state.size());
+	if (!fout) throw runtime_error("Could not write state to file: "+state_outfile);
+
+	fout.close();
+}
+
+
+string serializeState(Solver *S, bool binary){
+	if (binary) return serializeState_binary(S);
+
+	stringbuf buf;
+	ostream fout(&buf);
 
 	fout << setprecision(12);
 	// core state writing
@@ -39,9 +79,9 @@ void saveState(Solver *S, string state_outfile, string config_outfile, string pa
 	}
 
 	// save Solver
-	S->save(fout);
+	save_solver(S, buf, 12);
 
-	fout.close();
+	return buf.str();
 }
 
 
@@ -50,9 +90,20 @@ void restoreState(Solver * S, string state_infile, string config_infile){
 	cout << "Restoring state from: " << state_infile << '\n';
 	cout << "Restoring config from: " << config_infile << '\n';
 
-	ifstream fin(state_infile.c_str());
+	ifstream fin(state_infile.c_str(), ios::binary);
 	if (!fin) throw runtime_error("Could not open file for restoring state: "+state_infile);
 
+	// detect binary checkpoints from the file header
+	char magic[sizeof(STATE_MAGIC)] = {};
+	fin.read(magic, sizeof(magic));
+	if (fin && std::equal(magic, magic+sizeof(magic), STATE_MAGIC)){
+		fin.close();
+		restoreState_binary(S, state_infile, config_infile);
+		return;
+	}
+	fin.clear();
+	fin.seekg(0);
+
 	string s; fin >> s;  // discard version number
 
 	// Read species associations (probes)
@@ -116,3 +167,233 @@ void restoreState(Solver * S, string state_infile, string config_infile){
 	fin.close();
 }
 
+
+// Binary state file layout (native byte order):
+//   "PFSTATE\0" version:u32  { tag:char[4] length:u64 crc32:u32 payload } x nsections
+// Sections:
+//   "SPPS": number of species, and the name and probe names of each species
+//   "MYSP": binary record of species-level data and cohorts (x, u, birth time, state variables) for each species
+//           (see MySpecies::save(io::BinaryWriter&))
+//   "SOLV": Solver::save() output without cohorts, i.e. solver-level data and species skeletons. This format is 
+//           defined by libpspm, and is written as text with 17 significant digits, which restores doubles exactly.
+//   "END ": empty, marks a complete file
+static void write_section(io::BinaryWriter &fout, const char * tag, const string &payload){
+	fout.write_bytes(tag, 4);
+	fout.write(uint64_t(payload.size()));
+	fout.write(io::crc32(payload.data(), payload.size()));
+	fout.write_bytes(payload.data(), payload.size());
+}
+
+
+static string serializeState_binary(Solver *S){
+	io::BinaryWriter spps, mysp;
+	spps.write(uint64_t(S->species_vec.size()));
+	for (auto s : S->species_vec){
+		auto spp = static_cast<MySpecies<PSPM_Plant>*>(s);
+		spps.write(spp->species_name);
+		vector<string> probe_names;
+		for (auto p : spp->probes) probe_names.push_back(p->species_name);
+		spps.write(probe_names);
+
+		io::BinaryWriter rec;
+		spp->save(rec);
+		mysp.write(rec.data());
+	}
+
+	stringbuf solver_buf;
+	for (auto s : S->species_vec) static_cast<MySpecies<PSPM_Plant>*>(s)->binary_state = true;
+	try{
+		save_solver(S, solver_buf, 17);
+	}
+	catch(...){
+		for (auto s : S->species_vec) static_cast<MySpecies<PSPM_Plant>*>(s)->binary_state = false;
+		throw;
+	}
+	for (auto s : S->species_vec) static_cast<MySpecies<PSPM_Plant>*>(s)->binary_state = false;
+
+	io::BinaryWriter file;
+	file.write_bytes(STATE_MAGIC, sizeof(STATE_MAGIC));
+	file.write(STATE_VERSION);
+	write_section(file, "SPPS", spps.data());
+	write_section(file, "MYSP", mysp.data());
+	write_section(file, "SOLV", solver_buf.str());
+	write_section(file, "END ", "");
+
+	return file.data();
+}
+
+
+static void restoreState_binary(Solver *S, string state_infile, string config_infile){
+	ifstream fin(state_infile.c_str(), ios::binary);
+	if (!fin) throw runtime_error("Could not open file for restoring state: "+state_infile);
+	string data((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+	fin.close();
+
+	// read and verify all sections
+	io::BinaryReader file(data);
+	char magic[sizeof(STATE_MAGIC)];
+	file.read_bytes(magic, sizeof(magic));
+	uint32_t version = file.get<uint32_t>();
+	if (version != STATE_VERSION) throw runtime_error("Unsupported binary state version " + to_string(version) + " in " + state_infile);
+
+	map<string, string> sections;
+	while (sections.find("END ") == sections.end()){
+		char tag[4];
+		file.read_bytes(tag, 4);  // throws if the file is truncated
+		uint64_t len = file.get<uint64_t>();
+		uint32_t crc = file.get<uint32_t>();
+		string payload(len, '\0');
+		file.read_bytes(&payload[0], len);
+		if (io::crc32(payload.data(), payload.size()) != crc) throw runtime_error("Checksum mismatch in section " + string(tag, 4) + " of " + state_infile);
+		sections[string(tag, 4)] = payload;
+	}
+	for (string tag : {"SPPS", "MYSP", "SOLV"}){
+		if (sections.find(tag) == sections.end()) throw runtime_error("Section " + tag + " missing in " + state_infile);
+	}
+
+	// species names and associations (probes)
+	io::BinaryReader spps(sections["SPPS"]);
+	int n = spps.get<uint64_t>();
+	vector<string> spp_names(n);
+	vector<vector<string>> probe_names(n);
+	map<string, int> indices; // name --> index in the species vector
+	for (int i=0; i<n; ++i){
+		spps.read(spp_names[i]);
+		spps.read(probe_names[i]);
+		indices[spp_names[i]] = i;
+	}
+
+	io::BinaryReader mysp(sections["MYSP"]);
+	PSPM_Plant p;
+	vector<Species_Base*> spp_proto;
+	for (int i=0; i<n; ++i){
+		auto spp = new MySpecies<PSPM_Plant>(p);
+		spp->configfile_for_restore = config_infile;
+		mysp.read(spp->binary_state_for_restore);
+		spp_proto.push_back(static_cast<Species_Base*>(spp));
+	}
+
+	// restore solver (cohorts are recreated from the MYSP records by MySpecies::restore())
+	stringbuf solver_buf(sections["SOLV"], ios::in);
+	restore_solver(S, solver_buf, spp_proto);
+	S->copyCohortsToState();
+
+	// the binary records are no longer needed
+	for (auto s : S->species_vec) string().swap(static_cast<MySpecies<PSPM_Plant>*>(s)->binary_state_for_restore);
+
+	// recreate species associations
+	for (int i=0; i<n; ++i){
+		auto spp = static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[i]);
+		for (auto& name : probe_names[i]){
+			if (indices.find(name) == indices.end()) throw runtime_error("Unknown probe species " + name + " in " + state_infile);
+			spp->probes.push_back(static_cast<MySpecies<PSPM_Plant>*>(S->species_vec[indices[name]]));
+		}
+	}
+}
+
+
+// ~~~~~~~~~~~~~~~~~~~ Checkpointer ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Checkpoint files are named ckpt_<t>.state / ckpt_<t>.ini
+static string checkpoint_name(double t){
+	stringstream ss;
+	ss << "ckpt_" << fixed << setprecision(4) << t;
+	return ss.str();
+}
+
+// All complete checkpoints in dir, as (t, name) sorted by t
+static vector<pair<double, string>> list_checkpoints(string dir){
+	vector<pair<double, string>> ckpts;
+	if (!std::filesystem::is_directory(dir)) return ckpts;
+	for (auto& entry : std::filesystem::directory_iterator(dir)){
+		string file = entry.path().filename().string();
+		if (file.rfind("ckpt_", 0) != 0 || entry.path().extension() != ".state") continue;
+		string name = entry.path().stem().string();
+		try{
+			ckpts.push_back({stod(name.substr(5)), name});
+		}
+		catch(const std::exception&){}  // not a checkpoint file
+	}
+	sort(ckpts.begin(), ckpts.end());
+	return ckpts;
+}
+
+
+Checkpointer::~Checkpointer(){
+	if (writer.joinable()) writer.join();
+}
+
+
+bool Checkpointer::enabled() const {
+	return interval_years > 0 || interval_seconds > 0;
+}
+
+
+void Checkpointer::start(double t){
+	t_last = t;
+	wall_last = std::chrono::steady_clock::now();
+}
+
+
+bool Checkpointer::due(double t) const {
+	if (interval_years > 0 && t - t_last >= interval_years*(1-1e-9)) return true;
+	if (interval_seconds > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_last).count() >= interval_seconds) return true;
+	return false;
+}
+
+
+void Checkpointer::save(double t, Solver * S){
+	wait();
+	start(t);
+
+	string state = serializeState(S, binary);
+	string name = checkpoint_name(t);
+
+	writer = std::thread([this, state = std::move(state), name](){
+		try{
+			std::filesystem::create_directories(dir);
+			string state_file  = dir + "/" + name + ".state";
+			string config_file = dir + "/" + name + ".ini";
+
+			{
+				ofstream fout(state_file + ".tmp", ios::binary);
+				fout.write(state.data(), state.size());
+				fout.close();
+				if (!fout) throw runtime_error("Could not write checkpoint: " + state_file);
+			}
+			std::filesystem::copy_file(params_file, config_file + ".tmp", std::filesystem::copy_options::overwrite_existing);
+
+			// config first, so that a complete .state file always has its config
+			std::filesystem::rename(config_file + ".tmp", config_file);
+			std::filesystem::rename(state_file + ".tmp", state_file);
+
+			auto ckpts = list_checkpoints(dir);
+			for (int i=0; i < int(ckpts.size()) - std::max(keep, 1); ++i){
+				std::filesystem::remove(dir + "/" + ckpts[i].second + ".state");
+				std::filesystem::remove(dir + "/" + ckpts[i].second + ".ini");
+			}
+		}
+		catch(...){
+			writer_error = std::current_exception();
+		}
+	});
+}
+
+
+void Checkpointer::wait(){
+	if (writer.joinable()) writer.join();
+	if (writer_error){
+		auto e = writer_error;
+		writer_error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+
+bool Checkpointer::find_latest(string dir, string &state_file, string &config_file){
+	auto ckpts = list_checkpoints(dir);
+	if (ckpts.empty()) return false;
+	state_file  = dir + "/" + ckpts.back().second + ".state";
+	config_file = dir + "/" + ckpts.back().second + ".ini";
+	return true;
+}
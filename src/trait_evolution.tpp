@@ -42,6 +42,53 @@ void MySpecies<Model>::createVariants(Model M){
 }
 
 
+/// @brief  Cohort state variables and evolvable traits on which cohort rates depend, for all cohorts (including the boundary cohort)
+template <class Model>
+void MySpecies<Model>::get_rate_inputs(std::vector<double> &v){
+	v.clear();  // keeps capacity, so that a reused buffer is not reallocated
+	for (int i=-1; i<this->xsize(); ++i){
+		auto& c = this->getCohort(i);
+		v.push_back(c.x);
+		v.push_back(c.geometry.lai);
+		v.push_back(c.state.mortality);
+		for (double tr : c.get_evolvableTraits()) v.push_back(tr);
+	}
+}
+
+
+/// @brief  Mark the rates of all cohorts as already computed at time t, from the current cohort states
+template <class Model>
+void MySpecies<Model>::set_precomputed(double t){
+	precomputed = true;
+	t_precomputed = t;
+	get_rate_inputs(precomputed_inputs);
+}
+
+
+/// @brief  Discard the precomputed mark, e.g. because the environment is about to change
+template <class Model>
+void MySpecies<Model>::clear_precomputed(){
+	precomputed = false;
+}
+
+
+/// @brief  Compute rates of all cohorts, unless this has already been done at time t from the same cohort states. 
+/// @details The precomputed mark is used only once. It is also discarded by every call to computeEnv() 
+///          (see PSPM_Dynamic_Environment::computeEnv()), so the environment is the one the rates were computed in. 
+///          Cohorts that have been added, removed or changed since then (e.g. by the solver between computeEnv() and
+///          this call) do not match the recorded states, and all rates are recomputed.
+template <class Model>
+void MySpecies<Model>::preComputeAllCohorts(double t, void * env){
+	bool skip = precomputed && t == t_precomputed;
+	precomputed = false;
+	if (skip){
+		get_rate_inputs(rate_inputs_buffer);
+		skip = (rate_inputs_buffer == precomputed_inputs);
+	}
+	if (!skip) Species<Model>::preComputeAllCohorts(t, env);
+}
+
+
 template <class Model>
 void MySpecies<Model>::evolveTraits(double dt){
 	if (!isResident) return;
@@ -98,6 +145,23 @@ void MySpecies<Model>::print_extra(){
 
 template <class Model>
 void MySpecies<Model>::save(std::ofstream &fout){
+	if (binary_state){
+		// species-level data and cohorts are in the binary record written by save(io::BinaryWriter&),
+		// so only the species skeleton (boundary cohort) goes through Species::save()
+		fout << "MySpecies<T>::bin\n";
+		auto cohorts = std::move(this->cohorts);
+		this->cohorts.clear();
+		try{
+			Species<Model>::save(fout);
+		}
+		catch(...){
+			this->cohorts = std::move(cohorts);
+			throw;
+		}
+		this->cohorts = std::move(cohorts);
+		return;
+	}
+
 	fout << "MySpecies<T>::v1\n";
 	
 	// save species-level data
@@ -130,10 +194,19 @@ template <class Model>
 void MySpecies<Model>::restore(std::ifstream &fin){
 	std::cout << "Restoring MySpecies<Model>...\n";
 	std::string s; fin >> s; // discard version number
-	assert(s == "MySpecies<T>::v1");
 
 	if (configfile_for_restore == "") throw std::runtime_error("Config file has not been set");
 
+	if (s == "MySpecies<T>::bin"){
+		if (binary_state_for_restore == "") throw std::runtime_error("Binary species record has not been set");
+		io::BinaryReader bin(binary_state_for_restore);
+		restore(bin);
+		Species<Model>::restore(fin);
+		restore_cohorts(bin);
+		return;
+	}
+	assert(s == "MySpecies<T>::v1");
+
 	// restore species-level data
 	fin >> fg_dx
 		>> std::quoted(species_name)
@@ -162,3 +235,106 @@ void MySpecies<Model>::restore(std::ifstream &fin){
 	Species<Model>::restore(fin);
 }
 
+
+/// @brief  Save species-level data, traits and cohorts in binary form (used by binary checkpoints). 
+///         The species skeleton is saved by save(std::ofstream&).
+template <class Model>
+void MySpecies<Model>::save(io::BinaryWriter &fout){
+	fout.write(std::string("MySpecies<T>::v1"));
+	fout.write(fg_dx);
+	fout.write(species_name);
+	fout.write(isResident);
+	fout.write(t_introduction);
+	fout.write(invasion_fitness);
+	fout.write(r0);
+
+	fout.write(fitness_gradient);
+	fout.write(trait_variance);
+	fout.write(trait_scalars);
+	fout.write(trait_names);
+
+	seeds_hist.save(fout);
+	r0_hist.save(fout);
+
+	this->getCohort(-1).traits.save(fout);
+
+	save_cohorts(fout);
+}
+
+
+template <class Model>
+void MySpecies<Model>::restore(io::BinaryReader &fin){
+	if (fin.get<std::string>() != "MySpecies<T>::v1") throw std::runtime_error("MySpecies: unsupported binary version");
+	fin.read(fg_dx);
+	fin.read(species_name);
+	fin.read(isResident);
+	fin.read(t_introduction);
+	fin.read(invasion_fitness);
+	fin.read(r0);
+
+	fin.read(fitness_gradient);
+	fin.read(trait_variance);
+	fin.read(trait_scalars);
+	fin.read(trait_names);
+
+	seeds_hist.restore(fin);
+	r0_hist.restore(fin);
+
+	auto& C = this->getCohort(-1);
+	C.initParamsFromFile(configfile_for_restore);  
+	C.traits.restore(fin);
+	C.coordinateTraits();
+	// cohorts follow, and are read by restore_cohorts() once the species skeleton has been restored
+}
+
+
+/// @brief  Save size, density, birth time and state variables of all cohorts. 
+///         Cohorts share parameters and traits with the boundary cohort, so these are not saved per cohort.
+template <class Model>
+void MySpecies<Model>::save_cohorts(io::BinaryWriter &fout){
+	int n = this->xsize();
+	int nv = this->getCohort(-1).statevarnames.size();
+	std::vector<double> x(n), u(n), t_birth(n), state(n*nv);
+	auto it = state.begin();
+	for (int i=0; i<n; ++i){
+		auto& c = this->getCohort(i);
+		x[i] = this->getX(i);
+		u[i] = this->getU(i);
+		t_birth[i] = c.t_birth;
+		c.get_state(it);
+	}
+
+	fout.write(uint64_t(n));
+	fout.write(uint64_t(nv));
+	fout.write(x);
+	fout.write(u);
+	fout.write(t_birth);
+	fout.write(state);
+}
+
+
+/// @brief  Recreate cohorts from the boundary cohort and the record written by save_cohorts().
+///         Cohort bookkeeping internal to libpspm (e.g. cohort ids) is not saved, and is reassigned.
+template <class Model>
+void MySpecies<Model>::restore_cohorts(io::BinaryReader &fin){
+	int n  = fin.get<uint64_t>();
+	int nv = fin.get<uint64_t>();
+	if (nv != int(this->getCohort(-1).statevarnames.size())) throw std::runtime_error("MySpecies: number of cohort state variables does not match");
+	std::vector<double> x, u, t_birth, state;
+	fin.read(x);
+	fin.read(u);
+	fin.read(t_birth);
+	fin.read(state);
+	if (x.size() != n || u.size() != n || t_birth.size() != n || state.size() != n*nv) throw std::runtime_error("MySpecies: inconsistent cohort record");
+
+	this->cohorts.assign(n, this->boundaryCohort);
+	auto it = state.begin();
+	for (int i=0; i<n; ++i){
+		auto& c = this->getCohort(i);
+		this->setX(i, x[i]);
+		this->setU(i, u[i]);
+		c.t_birth = t_birth[i];
+		c.set_state(it);
+		c.set_size(x[i]);
+	}
+}
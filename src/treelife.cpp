@@ -1,4 +1,5 @@
 #include "treelife.h"
+#include "utils/thread_pool.h"
 using namespace std;
 
 void ErgodicEnvironment::print(double t){
@@ -144,34 +145,102 @@ void LifeHistoryOptimizer::get_rates(vector<double>::iterator it){
 	*it++ = P.rates.dmort_dt;
 }
 
+std::vector<double> LifeHistoryOptimizer::get_state(){
+	return {P.geometry.lai, P.geometry.get_size(), prod, litter_pool, rep, seeds, P.state.mortality};
+}
+
+
+void LifeHistoryOptimizer::calc_rates(double t, std::vector<double>&S, std::vector<double>&dSdt){
+	//if (fabs(t - 2050) < 1e-5) 
+	//env.updateClimate(t);
+	set_state(S.begin());
+	P.calc_demographic_rates(C, t);
+	++n_derivs;
+	
+	// Override Plant-FATE fecundity calculations 
+	// We need to explicitly include plant mortality here for fitness calcs
+	double fec = P.fecundity_rate(P.bp.dmass_dt_rep, C);
+	P.rates.dseeds_dt =  fec * exp(-P.state.mortality);  // Fresh seeds produced = fecundity rate * p{plant is alive}
+	// P.rates.dseeds_dt_germ =   P.state.seed_pool/P.par.ll_seed;   // seeds that leave seed pool proceed for germincation
+
+	get_rates(dSdt.begin());
+}
+
+
 void LifeHistoryOptimizer::grow_for_dt(double t, double dt){
 
 	auto derivs = [this](double t, std::vector<double>&S, std::vector<double>&dSdt){
-		//if (fabs(t - 2050) < 1e-5) 
-		//env.updateClimate(t);
-		set_state(S.begin());
-		P.calc_demographic_rates(C, t);
-		
-		// Override Plant-FATE fecundity calculations 
-		// We need to explicitly include plant mortality here for fitness calcs
-		double fec = P.fecundity_rate(P.bp.dmass_dt_rep, C);
-		P.rates.dseeds_dt =  fec * exp(-P.state.mortality);  // Fresh seeds produced = fecundity rate * p{plant is alive}
-		// P.rates.dseeds_dt_germ =   P.state.seed_pool/P.par.ll_seed;   // seeds that leave seed pool proceed for germincation
-
-		get_rates(dSdt.begin());
+		calc_rates(t, S, dSdt);
 	};
 
-	std::vector<double> S = {P.geometry.lai, P.geometry.get_size(), prod, litter_pool, rep, seeds, P.state.mortality};
-	RK4(t, dt, S, derivs);
-	//Euler(t, dt, S, derivs);
+	std::vector<double> S = get_state();
+	rk4.step(t, dt, S, derivs);
+	//rk4.euler_step(t, dt, S, derivs);
 	set_state(S.begin());
 }	
 
 
 double LifeHistoryOptimizer::calcFitness(){
 	// lho_set_traits(tvec);
-	for (double t=2000; t<=2500; t=t+dt){
-		grow_for_dt(t, dt);
+	n_derivs = 0;
+	n_derivs_saved = 0;
+
+	if (integrator == "rk4"){
+		for (double t=2000; t<=2500; t=t+dt){
+			grow_for_dt(t, dt);
+		}
 	}
+	else if (integrator == "rk45"){
+		// integrate over the same time span as the fixed-step loop above
+		double t_end = 2000;
+		int n_fixed = 0;
+		for (double t=2000; t<=2500; t=t+dt){
+			t_end = t+dt;
+			++n_fixed;
+		}
+
+		auto derivs = [this](double t, std::vector<double>&S, std::vector<double>&dSdt){
+			calc_rates(t, S, dSdt);
+		};
+
+		RK45Integrator<> rk45;
+		rk45.rtol = rtol;
+		rk45.atol = atol;
+		rk45.h = dt;
+		std::vector<double> S = get_state();
+		rk45.integrate(2000, t_end, S, derivs);
+		set_state(S.begin());
+
+		n_derivs_saved = 4*n_fixed - n_derivs;
+	}
+	else {
+		throw std::runtime_error("Unknown integrator " + integrator + ". Must be rk4 or rk45");
+	}
+
 	return seeds;
 }
+
+
+std::vector<double> LifeHistoryOptimizer::calcFitness_batch(std::vector<std::vector<double>> trait_matrix){
+	int n = trait_matrix.size();
+
+	std::vector<LifeHistoryOptimizer> lhos(n);
+	for (int i=0; i<n; ++i){
+		lhos[i].params_file = params_file;
+		lhos[i].dt = dt;
+		lhos[i].integrator = integrator;
+		lhos[i].rtol = rtol;
+		lhos[i].atol = atol;
+		lhos[i].init();
+		lhos[i].set_traits(trait_matrix[i]);
+	}
+
+	// Plants are independent, so each is integrated on its own, by whichever thread picks it up
+	std::vector<double> fitness(n);
+	ThreadPool pool(std::max(1, std::min(n_threads, n)));
+	pool.parallel_for(n, [&](int i){
+		fitness[i] = lhos[i].calcFitness();
+	});
+
+	return fitness;
+}
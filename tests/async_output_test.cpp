@@ -0,0 +1,50 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "plantfate.h"
+
+using namespace std;
+
+static string read_file(const string& file){
+	ifstream fin(file, ios::binary);
+	stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+static void run(string expt, bool async){
+	Simulator sim("tests/params/p.ini");
+	sim.expt_dir = expt;
+	sim.init(1000, 1030);
+	sim.sio.async_output = async;
+	sim.sio.queue_capacity = 2;  // small queue, so that the simulation has to wait for the writer
+	sim.simulate();
+	sim.close();
+}
+
+// Output written on the background thread must be identical to output written synchronously
+int main(){
+
+	run("async_test_sync", false);
+	run("async_test_async", true);
+
+	Simulator sim("tests/params/p.ini");
+	string dir_sync  = sim.parent_dir + "/async_test_sync";
+	string dir_async = sim.parent_dir + "/async_test_async";
+
+	int n_files = 0, n_diff = 0;
+	for (auto& entry : filesystem::directory_iterator(dir_sync)){
+		if (!entry.is_regular_file()) continue;
+		string name = entry.path().filename().string();
+		bool same = (read_file(dir_sync + "/" + name) == read_file(dir_async + "/" + name));
+		cout << name << ": " << (same? "identical" : "DIFFERENT") << "\n";
+		++n_files;
+		if (!same) ++n_diff;
+	}
+
+	cout << n_files << " files compared, " << n_diff << " different" << endl;
+	if (n_files == 0 || n_diff > 0) return 1;
+	return 0;
+}
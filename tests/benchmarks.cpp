@@ -0,0 +1,171 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <filesystem>
+#include <memory>
+
+#include "plantfate.h"
+
+using namespace std;
+
+// Benchmarks of the main steps of a simulation, with fixed inputs (tests/params/p.ini, a fixed random seed,
+// serial runs). Each benchmark is run `warmup` times without timing, then `repeats` times. Times are reported
+// per operation (a repeat may consist of several operations, e.g. rates of all cohorts of a species).
+// Results are written as JSON, by default to bench_output.json.
+//
+// Usage: benchmarks [output_file]
+
+struct BenchResult{
+	string name;
+	int    ops_per_repeat, warmup, repeats;
+	double min, median, mean, stddev;   // seconds per operation
+};
+
+vector<BenchResult> results;
+
+void bench(string name, int warmup, int repeats, int ops_per_repeat, function<void()> f){
+	for (int i=0; i<warmup; ++i) f();
+
+	vector<double> t(repeats);
+	for (int i=0; i<repeats; ++i){
+		auto t0 = chrono::steady_clock::now();
+		f();
+		t[i] = chrono::duration<double>(chrono::steady_clock::now() - t0).count() / ops_per_repeat;
+	}
+
+	BenchResult r{name, ops_per_repeat, warmup, repeats, 0, 0, 0, 0};
+	sort(t.begin(), t.end());
+	r.min = t.front();
+	r.median = (repeats % 2)? t[repeats/2] : (t[repeats/2-1] + t[repeats/2])/2;
+	for (double x : t) r.mean += x/repeats;
+	for (double x : t) r.stddev += (x-r.mean)*(x-r.mean)/max(repeats-1, 1);
+	r.stddev = sqrt(r.stddev);
+	results.push_back(r);
+
+	cout << setw(32) << left << name << " median = " << setw(12) << r.median << " s, min = " << setw(12) << r.min << " s (" << repeats << " x " << ops_per_repeat << ")" << endl;
+}
+
+
+void write_json(string file){
+	ofstream fout(file);
+	if (!fout) throw std::runtime_error("Could not open file " + file);
+	fout << setprecision(6);
+	fout << "{\n";
+	fout << "  \"suite\": \"plantfate\",\n";
+	fout << "  \"params\": \"tests/params/p.ini\",\n";
+#ifdef __VERSION__
+	fout << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+#ifdef __OPTIMIZE__
+	fout << "  \"optimized\": true,\n";
+#else
+	fout << "  \"optimized\": false,\n";
+#endif
+#ifdef PLANTFATE_PROFILE
+	fout << "  \"profiling\": true,\n";
+#else
+	fout << "  \"profiling\": false,\n";
+#endif
+	fout << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+	fout << "  \"unit\": \"seconds per operation\",\n";
+	fout << "  \"benchmarks\": [\n";
+	for (int i=0; i<results.size(); ++i){
+		auto& r = results[i];
+		fout << "    {\"name\": \"" << r.name << "\", \"ops_per_repeat\": " << r.ops_per_repeat
+		     << ", \"warmup\": " << r.warmup << ", \"repeats\": " << r.repeats
+		     << ", \"min\": " << r.min << ", \"median\": " << r.median
+		     << ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev << "}"
+		     << ((i+1 < results.size())? "," : "") << "\n";
+	}
+	fout << "  ]\n";
+	fout << "}\n";
+}
+
+
+// A serial simulator with n_species species, run for `spinup` years so that the canopy has several layers
+unique_ptr<Simulator> make_simulator(int n_species, string name, double spinup){
+	io::Initializer I("tests/params/p.ini");
+	I.readFile();
+	I.setScalar("nSpecies", n_species);
+	I.setScalar("n_threads", 1);
+	I.setString("evolveTraits", "no");
+	I.setString("saveState", "no");
+	I.setString("asyncOutput", "no");
+
+	auto sim = make_unique<Simulator>(I, "tests/params/p.ini");
+	sim->expt_dir = "benchmarks/" + name;
+	sim->set_random_seed(1);
+	sim->init(1000, 1000 + spinup);
+	sim->simulate();
+	return sim;
+}
+
+
+int main(int argc, char ** argv){
+	string outfile = (argc > 1)? argv[1] : "bench_output.json";
+
+	// ~~~ Rates of one plant, and community-level steps, at 1, 10 and 100 species
+	for (int n : {1, 10, 100}){
+		auto sim = make_simulator(n, "spp" + to_string(n), 20);
+		double t = sim->S.current_time;
+		string suffix = "_" + to_string(n) + "spp";
+
+		if (n == 1){
+			auto spp = static_cast<MySpecies<PSPM_Plant>*>(sim->S.species_vec[0]);
+			int nc = spp->xsize();
+			bench("calc_demographic_rates", 2, 20, nc, [&](){
+				for (int i=0; i<nc; ++i) spp->getCohort(i).calc_demographic_rates(sim->E, t);
+			});
+		}
+
+		bench("computeEnv" + suffix, 3, 20, 1, [&](){
+			sim->E.computeEnv(t, &sim->S, sim->S.state.begin(), sim->S.state.begin());
+		});
+
+		bench("species_props_update" + suffix, 3, 20, 1, [&](){
+			sim->integrals.compute(t, sim->S);
+			sim->cwm.update(t, sim->S, sim->integrals);
+		});
+
+		bench("emergent_props_update" + suffix, 3, 20, 1, [&](){
+			sim->integrals.compute(t, sim->S);
+			sim->props.update(t, sim->S, sim->integrals);
+		});
+
+		if (n == 100){
+			bench("writeState" + suffix, 3, 20, 1, [&](){
+				sim->sio.writeState(t, sim->cwm, sim->props);
+			});
+
+			string dir = sim->parent_dir + "/" + sim->expt_dir;
+			for (bool binary : {false, true}){
+				bench(string("save_restore_") + ((binary)? "binary" : "text") + suffix, 1, 5, 1, [&](){
+					saveState(&sim->S, dir + "/bench.state", dir + "/bench.ini", sim->paramsFile, binary);
+					Solver S2(sim->solver_method, "rk45ck");
+					S2.setEnvironment(&sim->E);
+					restoreState(&S2, dir + "/bench.state", dir + "/bench.ini");
+					for (auto s : S2.species_vec) delete static_cast<MySpecies<PSPM_Plant>*>(s);
+				});
+			}
+		}
+
+		sim->close();
+	}
+
+	// ~~~ Full run
+	bench("simulate_100y", 0, 3, 1, [](){
+		auto sim = make_simulator(100, "run", 100);
+		sim->close();
+	});
+
+	write_json(outfile);
+	cout << "Results written to " << outfile << endl;
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <filesystem>
+
+#include "plantfate.h"
+
+using namespace std;
+
+static string read_file(const string& file){
+	ifstream fin(file, ios::binary);
+	stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+static bool same_bits(const vector<double>& a, const vector<double>& b){
+	return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()*sizeof(double)) == 0;
+}
+
+// Simulate from 1000 to 1050, either straight or with a stop at 1025, from which the run is continued with 
+// the binary state saved by close(). Returns the final solver state.
+static vector<double> run(string expt, bool split){
+	Simulator sim("tests/params/p.ini");
+	sim.expt_dir = expt;
+	sim.binary_state = true;
+	sim.checkpoints.interval_years = 0;
+	filesystem::remove_all(sim.parent_dir + "/" + expt);
+	sim.set_random_seed(1);
+	sim.init(1000, split? 1025 : 1050);
+	sim.simulate();
+	vector<double> state = sim.S.state;
+	sim.close();
+	if (!split) return state;
+
+	string dir = sim.parent_dir + "/" + expt;
+	Simulator sim1("tests/params/p.ini");
+	sim1.expt_dir = expt;
+	sim1.binary_state = true;
+	sim1.checkpoints.interval_years = 0;
+	sim1.continuePrevious = true;
+	sim1.continueFrom_stateFile = dir + "/" + sim.state_outfile;
+	sim1.continueFrom_configFile = dir + "/" + sim.config_outfile;
+	sim1.set_random_seed(1);
+	sim1.init(1000, 1050);
+	sim1.simulate();
+	state = sim1.S.state;
+	sim1.close();
+	return state;
+}
+
+// A binary checkpoint must restore the solver exactly: saving the restored solver must give the same file,
+// and a run continued from a checkpoint must give the same state and output as a run without a stop.
+// Corrupted checkpoints must be rejected.
+int main(){
+
+	int nerr = 0;
+	{
+		auto state_straight = run("binary_state_test_straight", false);
+		auto state_split    = run("binary_state_test_split", true);
+		if (!same_bits(state_straight, state_split)){ cout << "Continued run ends in a different state\n"; ++nerr; }
+
+		Simulator sim("tests/params/p.ini");
+		string dir_straight = sim.parent_dir + "/binary_state_test_straight";
+		string dir_split    = sim.parent_dir + "/binary_state_test_split";
+		int nfiles = 0;
+		for (auto& entry : filesystem::directory_iterator(dir_straight)){
+			string file = entry.path().filename().string();
+			if (!entry.is_regular_file() || file == "p.ini" || file == sim.config_outfile) continue;
+			++nfiles;
+			if (read_file(dir_straight + "/" + file) != read_file(dir_split + "/" + file)){ cout << "Continued run wrote different " << file << "\n"; ++nerr; }
+		}
+		cout << "Compared " << nfiles << " output files of straight and continued runs\n";
+	}
+
+	Simulator sim("tests/params/p.ini");
+	sim.expt_dir = "binary_state_test";
+	sim.init(1000, 1050);
+	sim.simulate();
+	sim.close();
+
+	string dir = sim.parent_dir + "/" + sim.expt_dir;
+	string config = dir + "/" + sim.config_outfile;
+
+	Simulator sim1("tests/params/p.ini");
+	sim1.expt_dir = sim.expt_dir;
+	sim1.continuePrevious = true;
+	sim1.continueFrom_stateFile = dir + "/" + sim.state_outfile;
+	sim1.continueFrom_configFile = config;
+	sim1.init(1000, 1050);  // restores the text state
+	saveState(&sim1.S, dir + "/state1.bin", dir + "/config1.ini", config, true);
+
+	Solver S2(sim1.solver_method, "rk45ck");
+	S2.setEnvironment(&sim1.E);
+	restoreState(&S2, dir + "/state1.bin", dir + "/config1.ini");
+	saveState(&S2, dir + "/state2.bin", dir + "/config2.ini", config, true);
+
+	string state1 = read_file(dir + "/state1.bin");
+	string state2 = read_file(dir + "/state2.bin");
+	cout << "Binary state: " << state1.size() << " bytes, text state: " << read_file(dir + "/" + sim.state_outfile).size() << " bytes\n";
+	if (state1 != state2){ cout << "Restored state differs from saved state\n"; ++nerr; }
+	if (S2.current_time != sim1.S.current_time){ cout << "Time differs\n"; ++nerr; }
+
+	// cohorts are recreated from the binary records, and must match the original ones exactly
+	if (S2.state != sim1.S.state){ cout << "Solver state differs\n"; ++nerr; }
+	for (int k=0; k<S2.species_vec.size(); ++k){
+		auto s1 = static_cast<MySpecies<PSPM_Plant>*>(sim1.S.species_vec[k]);
+		auto s2 = static_cast<MySpecies<PSPM_Plant>*>(S2.species_vec[k]);
+		bool same = (s1->xsize() == s2->xsize());
+		for (int i=0; same && i<s1->xsize(); ++i){
+			auto& c1 = s1->getCohort(i);
+			auto& c2 = s2->getCohort(i);
+			same = s1->getX(i) == s2->getX(i) && s1->getU(i) == s2->getU(i) && c1.t_birth == c2.t_birth
+			    && c1.geometry.lai == c2.geometry.lai && c1.state.mortality == c2.state.mortality
+			    && c1.geometry.height == c2.geometry.height;
+		}
+		if (!same){ cout << "Cohorts of species " << k << " differ\n"; ++nerr; }
+	}
+
+	// flip one byte in the middle of the file
+	state1[state1.size()/2] ^= 0x01;
+	ofstream(dir + "/state_corrupt.bin", ios::binary) << state1;
+	Solver S3(sim1.solver_method, "rk45ck");
+	S3.setEnvironment(&sim1.E);
+	try{
+		restoreState(&S3, dir + "/state_corrupt.bin", dir + "/config1.ini");
+		cout << "Corrupt state was not detected\n"; ++nerr;
+	}
+	catch(const std::runtime_error& e){
+		cout << "Corrupt state detected: " << e.what() << "\n";
+	}
+
+	for (auto s : S2.species_vec) delete static_cast<MySpecies<PSPM_Plant>*>(s);
+	for (auto s : sim1.S.species_vec) delete static_cast<MySpecies<PSPM_Plant>*>(s);
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "plantfate.h"
+
+using namespace std;
+
+static vector<string> read_lines(const string& file){
+	ifstream fin(file);
+	vector<string> lines;
+	string line;
+	while (getline(fin, line)) lines.push_back(line);
+	return lines;
+}
+
+// Checkpoints are taken at the configured interval, only the newest ones are kept,
+// and a run can be resumed from the newest checkpoint, continuing the output written before it
+int main(){
+
+	int nerr = 0;
+	string dir, emg_file;
+	vector<string> emg_before;
+	{
+		Simulator sim("tests/params/p.ini");
+		sim.expt_dir = "checkpoint_test";
+		sim.checkpoints.interval_years = 10;
+		sim.checkpoints.keep = 2;
+		dir = sim.parent_dir + "/" + sim.expt_dir + "/checkpoints";
+		filesystem::remove_all(dir);
+
+		sim.init(1000, 1055);  // last checkpoint at 1050, output written up to 1055
+		sim.simulate();
+		sim.close();
+		emg_file = sim.parent_dir + "/" + sim.expt_dir + "/" + sim.I.get<string>("emgProps");
+		emg_before = read_lines(emg_file);
+	}
+
+	int n = 0;
+	for (auto& entry : filesystem::directory_iterator(dir)){
+		cout << entry.path().filename().string() << "\n";
+		if (entry.path().extension() == ".state") ++n;
+		if (entry.path().extension() == ".tmp") { cout << "temporary file left behind\n"; ++nerr; }
+	}
+	if (n != 2) { cout << "Expected 2 checkpoints, found " << n << "\n"; ++nerr; }
+
+	string state_file, config_file;
+	if (!Checkpointer::find_latest(dir, state_file, config_file)) { cout << "No checkpoint found\n"; ++nerr; }
+	cout << "Latest: " << state_file << "\n";
+
+	Simulator sim2("tests/params/p.ini");
+	sim2.expt_dir = "checkpoint_test";
+	sim2.continueFrom_stateFile = "latest";
+	sim2.continuePrevious = true;
+	sim2.init(1000, 1060);
+	cout << "Resumed at t = " << sim2.S.current_time << "\n";
+	if (sim2.S.current_time != 1050) { cout << "Did not resume from the newest checkpoint\n"; ++nerr; }
+	sim2.simulate();
+	sim2.close();
+
+	// Output up to the checkpoint is kept, rows written after it are replaced, and no year is written twice
+	auto emg_after = read_lines(emg_file);
+	int n_kept = 1 + 51;  // header and years 1000-1050
+	if (emg_before.size() != 1 + 56 || emg_after.size() != 1 + 61){
+		cout << "Expected 56 and 61 rows of emergent properties, found " << emg_before.size()-1 << " and " << emg_after.size()-1 << "\n"; ++nerr;
+	}
+	else{
+		for (int i=0; i<n_kept; ++i){
+			if (emg_after[i] != emg_before[i]) { cout << "Output before the checkpoint was changed at line " << i << "\n"; ++nerr; break; }
+		}
+		for (int i=1; i<emg_after.size(); ++i){
+			int year;
+			stringstream(emg_after[i]) >> year;
+			if (year != 999+i) { cout << "Expected year " << 999+i << " at line " << i << ", found " << year << "\n"; ++nerr; break; }
+		}
+	}
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+
+#include "climate.h"
+
+using namespace std;
+
+// Reading the met file directly, through the binary cache, or streamed from the mapped cache must give the same records.
+// The cache must be recreated when the CSV file changes.
+int main(){
+	int nerr = 0;
+
+	string met = "climate_cache_test_met.csv", co2 = "climate_cache_test_co2.csv";
+	auto write_met = [&](double offset){
+		ofstream fmet(met);
+		fmet.precision(10);
+		fmet << "Year,Month,Temp,VPD,PAR,PAR_max,SWP\n";
+		for (int y=1500; y<2000; ++y) for (int m=1; m<=12; ++m){
+			fmet << y << "," << m << "," << 20+sin(y*12+m)+offset << "," << 10.37+m/7.0 << "," << 300.1+10*m << "," << 1000+10*m << "," << 0.01*m << "\n";
+		}
+	};
+	write_met(0);
+	{
+		ofstream fco2(co2);
+		fco2 << "Year,CO2\n";
+		for (int y=1500; y<=2100; ++y) fco2 << y << "," << 280+0.5*(y-1500) << "\n";
+	}
+	filesystem::remove(env::ClimateForcing::met_cache_file(met));
+
+	vector<env::ClimateForcing> F(3);
+	vector<double> secs(3);
+	for (int mode : {0, 1, 2}){
+		auto t0 = chrono::steady_clock::now();
+		F[mode].read(met, co2, mode);
+		secs[mode] = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	}
+	// read the cache again, now that it exists
+	env::ClimateForcing F1b;
+	auto t0 = chrono::steady_clock::now();
+	F1b.read(met, co2, env::ClimateForcing::MET_CACHE);
+	double secs_cached = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	cout << F[0].n_met() << " records: csv = " << secs[0] << " s, creating cache = " << secs[1] << " s, reading cache = " << secs_cached << " s\n";
+
+	if (!filesystem::exists(env::ClimateForcing::met_cache_file(met))){ cout << "cache not created\n"; ++nerr; }
+	if (!F[2].t_met.empty()){ cout << "streamed forcing holds records in memory\n"; ++nerr; }
+
+	for (int mode : {1, 2}){
+		if (F[mode].n_met() != F[0].n_met() || F[mode].delta != F[0].delta || F[mode].uniform != F[0].uniform){ cout << "mode " << mode << ": series differs\n"; ++nerr; continue; }
+		for (size_t i=0; i<F[0].n_met(); ++i){
+			auto a = F[0].met_record(i), b = F[mode].met_record(i);
+			if (F[0].met_time(i) != F[mode].met_time(i) || a.tc != b.tc || a.vpd != b.vpd || a.ppfd != b.ppfd || a.ppfd_max != b.ppfd_max || a.swp != b.swp){
+				cout << "mode " << mode << ": record " << i << " differs\n"; ++nerr; break;
+			}
+		}
+	}
+
+	// Parsed values match stream extraction
+	{
+		ifstream fin(met);
+		string line;
+		getline(fin, line);
+		getline(fin, line);
+		stringstream ss(line);
+		string cell;
+		for (int k=0; k<3; ++k) getline(ss, cell, ',');
+		double tc;
+		stringstream(cell) >> tc;
+		if (F[0].met_record(0).tc != tc){ cout << "parsed value differs: " << F[0].met_record(0).tc << " vs " << tc << "\n"; ++nerr; }
+	}
+
+	// a modified CSV file makes the cache stale
+	this_thread::sleep_for(chrono::milliseconds(20));
+	write_met(1);
+	env::ClimateForcing F2;
+	F2.read(met, co2, env::ClimateForcing::MET_STREAM);
+	if (F2.met_record(0).tc != F[0].met_record(0).tc + 1){ cout << "stale cache was used\n"; ++nerr; }
+
+	// Shared forcing is reused while in use, and read again if the file changes within the timestamp resolution
+	{
+		auto L1 = env::ClimateForcing::load(met, co2);
+		auto L2 = env::ClimateForcing::load(met, co2);
+		if (L1 != L2){ cout << "forcing in use was read again\n"; ++nerr; }
+
+		auto mtime = filesystem::last_write_time(met);
+		{
+			ofstream fmet(met, ios::app);
+			fmet << "2000,1,20,10,300,1000,0.01\n";
+		}
+		filesystem::last_write_time(met, mtime);
+		auto L3 = env::ClimateForcing::load(met, co2);
+		if (L3 == L1 || L3->n_met() != L1->n_met()+1){ cout << "modified met file not read again\n"; ++nerr; }
+	}
+
+	filesystem::remove(met);
+	filesystem::remove(co2);
+	filesystem::remove(env::ClimateForcing::met_cache_file(met));
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
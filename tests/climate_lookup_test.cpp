@@ -0,0 +1,116 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+
+#include "climate.h"
+
+using namespace std;
+
+// Lookup as it was done before the uniform table: shift t into the data by whole periods, and index by division
+int reference_index(const env::ClimateForcing& F, double t){
+	double tadj = t;
+	while (tadj < F.t_met[0]) tadj += F.delta;
+	int id = (tadj - F.t_met[0])/F.delta*F.t_met.size();
+	return id % F.t_met.size();
+}
+
+// Constant-time lookup must give the same records as the original search, and interpolation must be linear.
+// Daily and hourly records must be placed at the right times and found by lookup.
+int main(){
+	int nerr = 0;
+
+	string met = "climate_lookup_test_met.csv", co2 = "climate_lookup_test_co2.csv";
+	{
+		ofstream fmet(met), fco2(co2);
+		fmet << "Year,Month,Temp,VPD,PAR,PAR_max,SWP\n";
+		for (int y=2000; y<2016; ++y) for (int m=1; m<=12; ++m) fmet << y << "," << m << "," << 20+m+0.1*(y-2000) << "," << 10+m << "," << 300+10*m << "," << 1000+10*m << "," << 0.1*m << "\n";
+		fco2 << "Year,CO2\n";
+		for (int y=2000; y<=2100; ++y) fco2 << y << "," << 360+2*(y-2000) << "\n";
+	}
+
+	env::Climate C;
+	C.metFile = met;
+	C.co2File = co2;
+	C.init();
+	auto& F = *C.forcing;
+	cout << "records = " << F.t_met.size() << ", uniform = " << F.uniform << ", dt = " << F.dt_met << "\n";
+	if (!F.uniform) ++nerr;
+
+	mt19937 rng(1);
+	uniform_real_distribution<double> U(1000, 2200);
+	int nmismatch = 0;
+	for (int k=0; k<100000; ++k){
+		double t = (k % 2)? U(rng) : 1000 + (k/2)*0.1;  // random times, and times of a typical simulation
+		C.updateClimate(t);
+		int i = reference_index(F, t);
+		if (C.clim.tc != F.v_met[i].tc || C.clim.ppfd != F.v_met[i].ppfd) ++nmismatch;
+
+		if (t >= 2000 && t < 2016 && F.met_index_before(t) != int(upper_bound(F.t_met.begin(), F.t_met.end(), t) - F.t_met.begin()) - 1) ++nmismatch;
+	}
+	cout << "lookup mismatches = " << nmismatch << "\n";
+	if (nmismatch > 0) ++nerr;
+
+	// CO2 by year, and last value after the end
+	C.updateClimate(2050.5);
+	double co2_mid = C.clim.co2;
+	C.updateClimate(2150);
+	cout << "co2 = " << co2_mid << ", " << C.clim.co2 << "\n";
+	if (co2_mid != 460 || C.clim.co2 != 560) ++nerr;
+
+	// linear interpolation between monthly records
+	C.interpolate = true;
+	C.updateClimate(2003 + 4.5/12);
+	double expected = (F.v_met[40].tc + F.v_met[41].tc)/2;
+	cout << "interpolated tc = " << C.clim.tc << ", expected = " << expected << "\n";
+	if (fabs(C.clim.tc - expected) > 1e-6) ++nerr;
+
+	// daily records, with a leap year, and hourly records
+	{
+		ofstream fmet(met);
+		fmet << "Year,Month,Day,Temp,VPD,PAR,PAR_max,SWP\n";
+		int dm[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+		for (int y=2000; y<2004; ++y) for (int m=1; m<=12; ++m) for (int d=1; d<=dm[m-1] + (m == 2 && y % 4 == 0); ++d){
+			fmet << y << "," << m << "," << d << "," << 20+d*0.1 << ",10,300,1000,0.1\n";
+		}
+	}
+	env::Climate D;
+	D.metFile = met;
+	D.co2File = co2;
+	D.interpolate = true;
+	D.init();
+	auto& FD = *D.forcing;
+	cout << "daily records = " << FD.n_met() << ", uniform = " << FD.uniform << "\n";
+	if (FD.n_met() != 1461 || FD.uniform || FD.met_time(60) != 2000 + 60.0/366 || FD.met_time(366+59) != 2001 + 59.0/365) ++nerr;
+
+	nmismatch = 0;
+	for (int k=0; k<20000; ++k){
+		double t = U(rng);
+		int i; double w;
+		FD.met_position(t, i, w);
+		double tadj = fmod(t - 2000, FD.delta);
+		if (tadj < 0) tadj += FD.delta;
+		if (i != int(upper_bound(FD.t_met.begin(), FD.t_met.end(), 2000 + tadj) - FD.t_met.begin()) - 1 || w < 0 || w > 1) ++nmismatch;
+	}
+	D.updateClimate(2001 + (59 + 0.25)/365);  // 1 March 2001, 6 am
+	cout << "daily lookup mismatches = " << nmismatch << ", interpolated tc = " << D.clim.tc << "\n";
+	if (nmismatch > 0 || fabs(D.clim.tc - 20.125) > 1e-6) ++nerr;
+
+	{
+		ofstream fmet(met);
+		fmet << "Year,Month,Day,Hour,Temp,VPD,PAR,PAR_max,SWP\n";
+		for (int d=1; d<=31; ++d) for (int h=0; h<24; ++h) fmet << 2001 << "," << 3 << "," << d << "," << h << "," << h << ",10,300,1000,0.1\n";
+	}
+	env::ClimateForcing FH;
+	FH.read(met, co2);
+	cout << "hourly records = " << FH.n_met() << ", uniform = " << FH.uniform << "\n";
+	if (FH.n_met() != 744 || !FH.uniform || fabs(FH.dt_met - 1/(24*365.0)) > 1e-12 || FH.met_time(12) != 2001 + (59 + 0.5)/365) ++nerr;
+
+	filesystem::remove(met);
+	filesystem::remove(co2);
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
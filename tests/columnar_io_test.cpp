@@ -0,0 +1,126 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+#include "columnar_io.h"
+
+using namespace std;
+
+inline double runif(double rmin=0, double rmax=1){
+	double r = double(rand())/RAND_MAX;
+	return rmin + (rmax-rmin)*r;
+}
+
+int main(){
+
+	// Compression round trip, including edge cases
+	vector<double> vd = {0, -0.0, 1e-300, -1e300, NAN, INFINITY, 3.14159, 3.14159, 2.5};
+	for (int i=0; i<1000; ++i) vd.push_back(runif(-1e6, 1e6));
+	auto vd2 = io::columnar::decode_float64(io::columnar::encode_float64(vd), vd.size());
+	for (int i=0; i<vd.size(); ++i) if (memcmp(&vd[i], &vd2[i], 8) != 0) return 1;
+
+	vector<float> vf(vd.begin(), vd.end());
+	auto vf2 = io::columnar::decode_float32(io::columnar::encode_float32(vf), vf.size());
+	for (int i=0; i<vf.size(); ++i) if (memcmp(&vf[i], &vf2[i], 4) != 0) return 1;
+
+	vector<int32_t> vi = {0, 1, -1, INT32_MAX, INT32_MIN, INT32_MAX, 0, 0, 0, 5};
+	for (int i=0; i<1000; ++i) vi.push_back(rand() - RAND_MAX/2);
+	if (io::columnar::decode_int32(io::columnar::encode_int32(vi), vi.size()) != vi) return 1;
+
+	// Cohort-properties-like table, written as text and binary
+	std::filesystem::create_directories("tests/build");
+	string txt_file = "tests/build/columnar_test.txt", bin_file = "tests/build/columnar_test.pfc";
+	ofstream ftxt(txt_file);
+	io::ColumnWriter fbin;
+	fbin.chunk_rows = 1000;
+	fbin.open(bin_file, {{"t", io::ColumnWriter::FLOAT64}, {"speciesID", io::ColumnWriter::STRING}, {"cohortID", io::ColumnWriter::INT32}, 
+	                     {"height", io::ColumnWriter::FLOAT32}, {"lai", io::ColumnWriter::FLOAT32}});
+
+	vector<double> t_ref, h_ref, l_ref;
+	vector<string> s_ref;
+	vector<double> id_ref;
+	for (double t=1000; t<1200; t += 1){
+		for (int k=0; k<5; ++k){
+			string name = "spp_" + to_string(k);
+			for (int j=0; j<50; ++j){
+				double h = 20*(1-exp(-0.05*j - 0.001*(t-1000))); 
+				double l = 1.8 + 0.5*sin(t/10 + j);
+				ftxt << t << "\t" << name << "\t" << j << "\t" << h << "\t" << l << "\t\n";
+				fbin << t << name << j << h << l;
+				fbin.end_row();
+				t_ref.push_back(t); s_ref.push_back(name); id_ref.push_back(j); h_ref.push_back(float(h)); l_ref.push_back(float(l));
+			}
+		}
+	}
+	ftxt.close();
+	fbin.close();
+
+	io::ColumnReader reader;
+	reader.read(bin_file);
+	bool ok = reader.nrows() == t_ref.size() 
+	       && reader.get_numeric("t") == t_ref 
+	       && reader.get_string("speciesID") == s_ref 
+	       && reader.get_numeric("cohortID") == id_ref 
+	       && reader.get_numeric("height") == h_ref 
+	       && reader.get_numeric("lai") == l_ref;
+	cout << "Round trip: " << (ok? "exact" : "FAILED") << "\n";
+
+	double size_txt = std::filesystem::file_size(txt_file);
+	double size_bin = std::filesystem::file_size(bin_file);
+	cout << "Text size = " << size_txt << ", binary size = " << size_bin << " (" << size_txt/size_bin << "x smaller)" << endl;
+
+	if (!ok) return 1;
+	if (size_txt/size_bin < 5) return 1;
+
+	string bytes;
+	{
+		ifstream fin(bin_file, ios::binary);
+		bytes.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+	}
+
+	// A file continued from t = 1100, after rows up to 1120 had been written, must be identical to one written in one go
+	{
+		string part_file = "tests/build/columnar_test_part.pfc";
+		vector<pair<string, io::ColumnWriter::Type>> schema = {{"t", io::ColumnWriter::FLOAT64}, {"speciesID", io::ColumnWriter::STRING}, 
+		                     {"cohortID", io::ColumnWriter::INT32}, {"height", io::ColumnWriter::FLOAT32}, {"lai", io::ColumnWriter::FLOAT32}};
+		io::ColumnWriter fpart;
+		fpart.chunk_rows = 1000;
+		auto write_rows = [&](double t0, double t1){
+			for (int r=0; r<t_ref.size(); ++r){
+				if (t_ref[r] < t0 || t_ref[r] > t1) continue;
+				fpart << t_ref[r] << s_ref[r] << int(id_ref[r]) << h_ref[r] << l_ref[r];
+				fpart.end_row();
+			}
+		};
+		fpart.open(part_file, schema);
+		write_rows(1000, 1120);
+		fpart.close();
+		fpart.reopen(part_file, schema, 1100);
+		write_rows(1101, 1200);
+		fpart.close();
+
+		ifstream fin(part_file, ios::binary);
+		string part_bytes(istreambuf_iterator<char>(fin), (istreambuf_iterator<char>()));
+		if (part_bytes != bytes){ cout << "Continued file differs from file written in one go\n"; return 1; }
+	}
+
+	// Truncated files must be rejected
+	for (size_t len : {size_t(12), size_t(20), bytes.size()/2, bytes.size()-3}){
+		ofstream(bin_file, ios::binary).write(bytes.data(), len);
+		try{
+			io::ColumnReader r;
+			r.read(bin_file);
+			cout << "Truncated file (" << len << " bytes) was not rejected\n";
+			return 1;
+		}
+		catch(const std::runtime_error &e){}
+	}
+	return 0;
+}
+
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+#include "plantfate.h"
+
+using namespace std;
+
+// Compare the single-sweep community integrals with separate solver integrals for each quantity
+int main(){
+
+	Simulator sim("tests/params/p.ini");
+	sim.init(1000, 1020);
+	sim.simulate();
+
+	Solver& S = sim.S;
+	double t = S.current_time;
+
+	CommunityIntegrals ci;
+	ci.compute(t, S);
+
+	EmergentProps props;
+	props.update(t, S, ci);
+
+	auto rel_err = [](double a, double b){ return fabs(a-b)/std::max(1e-12, fabs(b)); };
+
+	double err = 0;
+	err = max(err, rel_err(props.gpp, integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.gpp;})));
+	err = max(err, rel_err(props.npp, integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.npp;})));
+	err = max(err, rel_err(props.trans, integrate_prop(t, S, [](const PSPM_Plant* p){return p->res.trans;})));
+	err = max(err, rel_err(props.lai, integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.crown_area*p->geometry.lai;})));
+	err = max(err, rel_err(props.leaf_mass, integrate_prop(t, S, [](const PSPM_Plant* p){return p->geometry.leaf_mass(p->traits);})));
+	for (int iz=0; iz<props.lai_vert.size(); ++iz){
+		double lv = integrate_prop(t, S, [iz](const PSPM_Plant* p){
+			auto G = p->geometry;
+			auto traits = p->traits;
+			return G.crown_area_above(iz, traits)*G.lai;
+		});
+		err = max(err, fabs(props.lai_vert[iz] - lv)/std::max(1e-12, props.lai));
+	}
+
+	double biomass = 0;
+	for (int k=0; k<S.n_species(); ++k){
+		if (!ci.species[k].resident) continue;
+		cout << "Species " << k << ": " << (ci.species[k].fused? "single sweep" : "solver integrals") << "\n";
+		biomass += S.integrate_wudx_above([&S,k](int i, double t){
+							auto& p = (static_cast<Species<PSPM_Plant>*>(S.species_vec[k]))->getCohort(i);
+							return p.get_biomass();
+						}, t, 0.1, k);
+	}
+	SpeciesProps cwm;
+	cwm.update(t, S, ci);
+	err = max(err, rel_err(cwm.biomass, biomass));
+
+	cout << setprecision(12) << "Max relative error = " << err << endl;
+	sim.close();
+
+	if (err > 1e-10) return 1;
+	return 0;
+}
+
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <chrono>
+
+#include "plant.h"
+#include "crown_kernel.h"
+
+using namespace std;
+
+inline double runif(double rmin=0, double rmax=1){
+	double r = double(rand())/RAND_MAX;
+	return rmin + (rmax-rmin)*r;
+}
+
+int main(){
+
+	cout << "AVX2 kernel: " << (env::crown_kernel::simd_enabled()? "yes" : "no") << "\n";
+	cout << setprecision(6);
+
+	// Error bound of fast_pow
+	double err_pow = 0;
+	for (int i=0; i<1000000; ++i){
+		double x = exp(runif(-600, 600));
+		double y = runif(-5, 5);
+		double w = y*log2(x);
+		double p0 = pow(x, y);
+		if (fabs(w) > 1000) continue;
+		double p1 = env::crown_kernel::fast_pow(x, y);
+		err_pow = max(err_pow, fabs(p1-p0)/p0/(1+fabs(w)));
+	}
+	cout << "Max relative error in fast_pow / (1+|y log2(x)|) = " << err_pow << "\n";
+	if (err_pow > 1e-12) return 1;
+
+	// Create cohorts of 2 species with random sizes
+	vector<plant::Plant> plants;
+	for (int k=0; k<2; ++k){
+		plant::Plant P;
+		P.initParamsFromFile("tests/params/p.ini");
+		P.traits.hmat = (k==0)? 29.18 : 12;
+		P.coordinateTraits();
+		for (int i=0; i<2000; ++i){
+			P.set_size(exp(runif(log(0.01), log(0.8))));
+			plants.push_back(P);
+		}
+	}
+	int N = plants.size();
+
+	vector<double> height(N), crown_area(N), zm(N), qm(N), m(N), n(N), fg(N), out(N);
+	for (int i=0; i<N; ++i){
+		auto& G = plants[i].geometry;
+		height[i] = G.height;
+		crown_area[i] = G.crown_area;
+		zm[i] = G.zm();
+		qm[i] = G.geom.qm;
+		m[i] = G.geom.m;
+		n[i] = G.geom.n;
+		fg[i] = G.geom.fg;
+	}
+
+	vector<double> zs;
+	for (double z=0; z<30; z += 0.0371) zs.push_back(z);
+
+	// Scalar path
+	auto t0 = chrono::steady_clock::now();
+	double sum_scalar = 0;
+	for (double z : zs){
+		for (int i=0; i<N; ++i) sum_scalar += plants[i].geometry.crown_area_above(z, plants[i].traits);
+	}
+	auto t1 = chrono::steady_clock::now();
+
+	// Batched path
+	double sum_batch = 0, err_ca = 0;
+	for (double z : zs){
+		env::crown_kernel::crown_area_above(N, z, height.data(), crown_area.data(), zm.data(), qm.data(), m.data(), n.data(), fg.data(), out.data());
+		for (int i=0; i<N; ++i) sum_batch += out[i];
+	}
+	auto t2 = chrono::steady_clock::now();
+
+	for (double z : zs){
+		env::crown_kernel::crown_area_above(N, z, height.data(), crown_area.data(), zm.data(), qm.data(), m.data(), n.data(), fg.data(), out.data());
+		for (int i=0; i<N; ++i){
+			double ca0 = plants[i].geometry.crown_area_above(z, plants[i].traits);
+			err_ca = max(err_ca, fabs(out[i] - ca0)/crown_area[i]);
+		}
+	}
+
+	double ns_scalar = chrono::duration<double, std::nano>(t1-t0).count()/(zs.size()*N);
+	double ns_batch  = chrono::duration<double, std::nano>(t2-t1).count()/(zs.size()*N);
+	cout << "Scalar:  " << ns_scalar << " ns/eval (sum = " << sum_scalar << ")\n";
+	cout << "Batched: " << ns_batch  << " ns/eval (sum = " << sum_batch << ")\n";
+	cout << "Speedup: " << ns_scalar/ns_batch << "\n";
+	cout << "Max error in crown area (relative to A_c) = " << err_ca << endl;
+	if (err_ca > 1e-10) return 1;
+
+	return 0;
+}
+
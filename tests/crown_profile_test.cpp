@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+
+#include "plant.h"
+#include "crown_profile.h"
+#include "cohort_cache.h"
+
+using namespace std;
+
+inline double runif(double rmin=0, double rmax=1){
+	double r = double(rand())/RAND_MAX;
+	return rmin + (rmax-rmin)*r;
+}
+
+int main(){
+
+	// Create a community of plants of 2 species with random sizes and densities
+	vector<plant::Plant> plants;
+	vector<double> u;
+	for (int k=0; k<2; ++k){
+		plant::Plant P;
+		P.initParamsFromFile("tests/params/p.ini");
+		P.traits.hmat = (k==0)? 29.18 : 12;
+		P.coordinateTraits();
+		for (int i=0; i<200; ++i){
+			P.set_size(exp(runif(log(0.01), log(0.8))));
+			plants.push_back(P);
+			u.push_back(runif(0, 0.002));
+		}
+	}
+
+	// Brute force crown area above z, as computed by PSPM_Dynamic_Environment::projected_crown_area_above_z()
+	auto ca_above = [&](double z){
+		double ca = 0;
+		for (int i=0; i<plants.size(); ++i) ca += u[i]*plants[i].geometry.crown_area_extent_projected(z, plants[i].traits);
+		return ca;
+	};
+
+	env::CrownAreaProfile prof;
+	for (int i=0; i<plants.size(); ++i){
+		auto& G = plants[i].geometry;
+		prof.add_crown(u[i], G.crown_area, G.height, G.zm(), G.geom.m, G.geom.n, G.geom.qm);
+	}
+	prof.build();
+
+	cout << setprecision(12);
+	double err_ca = 0;
+	for (double z=0; z<30; z += 0.137){
+		err_ca = max(err_ca, fabs(prof.area_above(z) - ca_above(z)));
+	}
+	cout << "Total crown area = " << prof.total() << " / " << ca_above(0) << "\n";
+	cout << "Max error in crown area profile = " << err_ca << "\n";
+	if (err_ca > 1e-10) return 1;
+
+	double fG = 0.99;
+	int n_layers = int(prof.total()/fG);
+	vector<double> z_star = prof.solve_z_star(n_layers, fG);
+
+	double err_z = 0;
+	for (int layer=1; layer<=n_layers; ++layer){
+		double zlo = 0, zhi = 100;
+		while (zhi - zlo > 1e-12){
+			double zmid = (zlo+zhi)/2;
+			if (ca_above(zmid) - layer*fG >= 0) zlo = zmid;
+			else zhi = zmid;
+		}
+		cout << "z*(" << layer << ") = " << z_star[layer-1] << " / " << zlo << "\n";
+		err_z = max(err_z, fabs(z_star[layer-1] - zlo));
+	}
+	cout << "Max error in z* = " << err_z << endl;
+	if (err_z > 1e-6) return 1;
+
+	// Cohort geometry cache must reproduce the crown functions of PlantGeometry
+	env::CohortGeometryCache::Columns c;
+	c.resize(plants.size());
+	for (int i=0; i<plants.size(); ++i){
+		auto& G = plants[i].geometry;
+		int j = c.col(i);
+		c.u[j] = u[i];
+		c.height[j] = G.height;
+		c.crown_area[j] = G.crown_area;
+		c.lai[j] = G.lai;
+		c.zm[j] = G.zm();
+		c.qm[j] = G.geom.qm;
+		c.m[j] = G.geom.m;
+		c.n[j] = G.geom.n;
+		c.fg[j] = G.geom.fg;
+	}
+	double err_cache = 0;
+	for (double z=0; z<30; z += 0.137){
+		for (int i=0; i<plants.size(); ++i){
+			int j = c.col(i);
+			err_cache = max(err_cache, fabs(c.crown_area_above(j, z) - plants[i].geometry.crown_area_above(z, plants[i].traits)));
+			err_cache = max(err_cache, fabs(c.crown_area_extent_projected(j, z) - plants[i].geometry.crown_area_extent_projected(z, plants[i].traits)));
+		}
+	}
+	cout << "Max error in cached crown area = " << err_cache << endl;
+	if (err_cache > 1e-12) return 1;
+
+	return 0;
+}
+
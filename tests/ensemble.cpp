@@ -0,0 +1,26 @@
+#include <iostream>
+#include <string>
+
+#include "ensemble.h"
+
+using namespace std;
+
+// Usage: ensemble.test <params_file> <members_file> <tstart> <tend> [n_threads]
+int main(int argc, char ** argv){
+
+	if (argc < 5){
+		cerr << "Usage: " << argv[0] << " <params_file> <members_file> <tstart> <tend> [n_threads]\n";
+		return 1;
+	}
+
+	EnsembleRunner ens(argv[1]);
+	ens.read_members(argv[2]);
+	if (argc > 5) ens.n_threads = stoi(argv[5]);
+
+	int n_failed = ens.run(stod(argv[3]), stod(argv[4]));
+
+	for (auto& m : ens.members){
+		cout << m.name << ": " << (m.error.empty()? "done" : "FAILED (" + m.error + ")") << "\n";
+	}
+	return (n_failed > 0)? 1 : 0;
+}
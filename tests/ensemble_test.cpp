@@ -0,0 +1,47 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+#include "ensemble.h"
+
+using namespace std;
+
+// Members get their own parameter files and output directories, share the climate forcing,
+// and a failing member does not stop the others
+int main(){
+
+	int nerr = 0;
+
+	EnsembleRunner ens("tests/params/p.ini");
+	ens.expt_dir = "ensemble_test";
+	ens.n_threads = 2;
+	ens.read_members("tests/params/ensemble_members.txt");
+	ens.add_member("bad", {"no_such_parameter"}, {"1"});
+
+	int n_failed = ens.run(1000, 1010);
+	for (auto& m : ens.members) cout << m.name << ": " << (m.error.empty()? "ok" : m.error) << "\n";
+	if (n_failed != 1 || ens.members.back().error.empty()){ cout << "Expected only the last member to fail\n"; ++nerr; }
+
+	string dir = ens.parent_dir + "/" + ens.expt_dir;
+	for (int i=0; i<ens.members.size()-1; ++i){
+		auto& m = ens.members[i];
+		if (!filesystem::exists(dir + "/" + m.name + "/p.ini")){ cout << "Output missing for " << m.name << "\n"; ++nerr; }
+
+		io::Initializer I(dir + "/" + m.name + "/p.ini");
+		I.readFile();
+		if (I.getScalar("kphio") != stod(m.overrides["kphio"]) || I.getScalar("T_return") != stod(m.overrides["T_return"])){
+			cout << "Overrides not applied for " << m.name << "\n"; ++nerr;
+		}
+	}
+
+	// all members use the same (cached) forcing
+	env::Climate C1, C2;
+	C1.metFile = C2.metFile = "tests/data/MetData_AmzFACE_Monthly_2000_2015_PlantFATE.csv";
+	C1.co2File = C2.co2File = "tests/data/CO2_ELE_AmzFACE2000_2100.csv";
+	C1.init();
+	C2.init();
+	if (C1.forcing != C2.forcing){ cout << "Forcing is not shared\n"; ++nerr; }
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
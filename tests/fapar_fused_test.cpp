@@ -0,0 +1,81 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "plantfate.h"
+
+using namespace std;
+
+struct Light{
+	vector<double> z_star, fapar;
+};
+
+Light compute(Simulator &sim, bool profile, bool fused, bool kernel){
+	sim.E.use_crown_profile = profile;
+	sim.E.use_fused_fapar = fused;
+	sim.E.use_crown_kernel = kernel;
+	sim.E.computeEnv(sim.S.current_time, &sim.S, sim.S.state.begin(), sim.S.state.begin());
+	return {sim.E.z_star, sim.E.fapar_tot};
+}
+
+double max_diff(const vector<double> &a, const vector<double> &b){
+	if (a.size() != b.size()) return 1e20;
+	double d = 0;
+	for (int i=0; i<a.size(); ++i) d = max(d, fabs(a[i]-b[i]));
+	return d;
+}
+
+// On a real solver state (tests/params/p.ini, IEBT), the crown area profile and the fused fapar pass must be used
+// (no fallbacks) and must agree with per-layer root-finding and integration over cohorts
+int main(){
+	io::Initializer I("tests/params/p.ini");
+	I.readFile();
+	I.setScalar("nSpecies", 5);
+	I.setScalar("n_threads", 1);
+	I.setString("evolveTraits", "no");
+	I.setString("saveState", "no");
+	I.setString("asyncOutput", "no");
+
+	Simulator sim(I, "tests/params/p.ini");
+	sim.expt_dir = "fapar_fused_test";
+	sim.set_random_seed(1);
+	sim.init(1000, 1030);   // long enough for several canopy layers
+	sim.simulate();
+
+	int nerr = 0;
+	cout << setprecision(12);
+
+	sim.E.n_crown_profile_fallbacks = 0;
+	sim.E.z_star_tol = 1e-9;
+	Light ref   = compute(sim, false, false, false);  // root-finding for z*, per-layer fapar
+	Light prof  = compute(sim, true,  false, false);  // profile z*, per-layer fapar
+	Light fused = compute(sim, true,  true,  false);  // profile z*, fused fapar
+	Light kern  = compute(sim, true,  true,  true);   // profile z*, fused fapar with the crown kernel
+
+	cout << "layers = " << ref.fapar.size() << ", profile fallbacks = " << sim.E.n_crown_profile_fallbacks << "\n";
+	if (sim.E.n_crown_profile_fallbacks > 0) ++nerr;
+	if (ref.fapar.size() < 1) ++nerr;
+
+	// with root-finding converged to 1e-9 m, z* from the profile must match to 1e-6 m
+	double dz = max_diff(ref.z_star, prof.z_star);
+	double df_z = max_diff(ref.fapar, prof.fapar);
+	cout << "profile vs root-finding: max |dz*| = " << dz << ", max |dfapar| = " << df_z << "\n";
+	if (dz > 1e-6 || df_z > 1e-6) ++nerr;
+
+	// With the same z*, the fused pass sums the same terms in a different order
+	double df = max_diff(prof.fapar, fused.fapar);
+	double dk = max_diff(prof.fapar, kern.fapar);
+	cout << "fused vs per-layer: max |dfapar| = " << df << " (crown kernel: " << dk << ")\n";
+	if (df > 1e-10 || dk > 1e-10) ++nerr;
+
+	for (int i=0; i<ref.fapar.size(); ++i){
+		cout << "layer " << i << ": z* = " << ref.z_star[i] << " / " << prof.z_star[i] << ", fapar = " << ref.fapar[i] << " / " << prof.fapar[i] << " / " << fused.fapar[i] << "\n";
+	}
+
+	sim.close();
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <chrono>
+
+#include "treelife.h"
+
+using namespace std;
+
+// Batched fitness must be identical to fitness calculated one trait vector at a time
+int main(){
+
+	vector<vector<double>> traits;
+	for (double lma : {0.06, 0.1, 0.14, 0.2}){
+		for (double wd : {400, 600, 800}){
+			traits.push_back({lma, wd});
+		}
+	}
+
+	auto t0 = chrono::steady_clock::now();
+	vector<double> fitness;
+	for (auto& tvec : traits){
+		LifeHistoryOptimizer lho;
+		lho.params_file = "tests/params/p.ini";
+		lho.init();
+		lho.set_traits(tvec);
+		fitness.push_back(lho.calcFitness());
+	}
+	auto t1 = chrono::steady_clock::now();
+
+	LifeHistoryOptimizer lho;
+	lho.params_file = "tests/params/p.ini";
+	lho.n_threads = 4;
+	vector<double> fitness_batch = lho.calcFitness_batch(traits);
+	auto t2 = chrono::steady_clock::now();
+
+	int nerr = 0;
+	for (int i=0; i<traits.size(); ++i){
+		cout << traits[i][0] << "\t" << traits[i][1] << "\t" << fitness[i] << "\t" << fitness_batch[i] << "\n";
+		if (fitness[i] != fitness_batch[i]) ++nerr;
+	}
+
+	double t_loop  = chrono::duration<double>(t1-t0).count();
+	double t_batch = chrono::duration<double>(t2-t1).count();
+	cout << traits.size() << " trait vectors: loop = " << t_loop << " s, batch = " << t_batch << " s (" << t_loop/t_batch << "x)\n";
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
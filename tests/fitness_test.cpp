@@ -64,12 +64,14 @@ int main(){
 			
 			std::default_random_engine generator;
 			std::normal_distribution<double> dist(i_mean, swp_stddev);
+			auto forcing = std::make_shared<env::ClimateForcing>();
 			for (double t=sim_start_t; t<=sim_end_t; t=t+time_step_swp){
-				C.t_met.push_back(t);
+				forcing->t_met.push_back(t);
 				double val = dist(generator);
 				if(val>0) val = 0;
-				C.v_met_swp.push_back(val);
+				forcing->v_met_swp.push_back(val);
 			}
+			C.init(forcing);
 			//C.print(0);
 			
 			double total_prod = P.get_biomass();
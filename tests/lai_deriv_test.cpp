@@ -0,0 +1,50 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+#include "treelife.h"
+using namespace std;
+
+int main(){
+
+	LifeHistoryOptimizer lho;
+	lho.params_file = "tests/params/p.ini";
+	lho.init();
+
+	cout << setprecision(8);
+	double err_max = 0;
+	for (double D : {0.01, 0.05, 0.2, 0.6}){
+		for (double L : {0.5, 1.0, 2.0, 4.0}){
+			auto P = lho.P;
+			P.set_size(D);
+			P.geometry.set_lai(L);
+			auto res = P.assimilator.net_production(lho.C, &P.geometry, P.par, P.traits);
+
+			auto d0 = P.lai_derivatives(res, lho.C, 0);
+			auto d1 = P.lai_derivatives(res, lho.C, 1);
+
+			// Method 1 must be identical to method 0, since canopy openness does not depend on LAI
+			double err1 = fabs(d1.npp - d0.npp) + fabs(d1.gpp - d0.gpp) + fabs(d1.trans - d0.trans);
+			cout << "D = " << D << ", L = " << L 
+			     << ": dnpp_dL = " << d0.npp << " / " << d1.npp << "\n";
+			err_max = max(err_max, err1);
+		}
+	}
+	cout << "Max difference between methods 0 and 1 = " << err_max << endl;
+	if (err_max > 1e-8) return 1;
+
+	// Unknown methods are rejected
+	bool thrown = false;
+	try {
+		auto P = lho.P;
+		auto res = P.assimilator.net_production(lho.C, &P.geometry, P.par, P.traits);
+		P.lai_derivatives(res, lho.C, 2);
+	}
+	catch (const std::runtime_error &e){
+		thrown = true;
+	}
+	if (!thrown) return 1;
+
+	return 0;
+}
+
@@ -0,0 +1,44 @@
+#include <iostream>
+#include <cmath>
+
+#include "treelife.h"
+
+using namespace std;
+
+double fitness(string integrator, double dt, double rtol, int &n_derivs, int &n_saved){
+	LifeHistoryOptimizer lho;
+	lho.params_file = "tests/params/p.ini";
+	lho.integrator = integrator;
+	lho.dt = dt;
+	lho.rtol = rtol;
+	lho.init();
+	double f = lho.calcFitness();
+	n_derivs = lho.n_derivs;
+	n_saved = lho.n_derivs_saved;
+	return f;
+}
+
+// With a tight enough tolerance, the adaptive integrator must be at least as accurate as fixed-step RK4 with dt = 0.1,
+// with fewer rate evaluations
+int main(){
+	int nerr = 0;
+	int n, saved;
+
+	double f_ref = fitness("rk45", 0.1, 1e-11, n, saved);
+	double f_rk4 = fitness("rk4", 0.1, 0, n, saved);
+	int n_rk4 = n;
+	double err_rk4 = fabs(f_rk4/f_ref - 1);
+	cout << "Reference (rk45, rtol = 1e-11): " << f_ref << "\n";
+	cout << "rk4 (dt = 0.1):   fitness = " << f_rk4 << ", error = " << err_rk4 << ", evaluations = " << n_rk4 << "\n";
+
+	for (double rtol : {1e-4, 1e-6, 1e-8}){
+		double f = fitness("rk45", 0.1, rtol, n, saved);
+		double err = fabs(f/f_ref - 1);
+		cout << "rk45 (rtol = " << rtol << "): fitness = " << f << ", error = " << err << ", evaluations = " << n << " (saved " << saved << ")\n";
+		if (saved != n_rk4 - n) ++nerr;
+		if (rtol == 1e-8 && (err > err_rk4 || n >= n_rk4)) ++nerr;
+	}
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -1,9 +1,64 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <vector>
+#include <cstdio>
+#include <list>
+
 #include "utils/moving_average.h"
 
 using namespace std;
 
+// Trapezoidal average of (t,f) over the points within T of the last point
+double direct_average(const vector<double>& t, const vector<double>& f, double T){
+	int i0 = t.size()-1;
+	while (i0 > 0 && t[i0-1] >= t.back() - T) --i0;
+	if (i0 == int(t.size())-1) return f.back();
+	double A = 0;
+	for (int i=i0+1; i<t.size(); ++i) A += (f[i]+f[i-1])/2*(t[i]-t[i-1]);
+	return A/(t.back()-t[i0]);
+}
+
+// Reference: the list-based implementation that MovingAverager replaced
+struct ListAverager{
+	double T, area_sum = 0;
+	list<double> areas, f_hist, t_hist;
+
+	void push(double t, double f){
+		if (f_hist.empty()){ f_hist.push_back(f); t_hist.push_back(t); return; }
+		double area_new = (f + f_hist.back()) / 2 * (t - t_hist.back());
+		f_hist.push_back(f);
+		t_hist.push_back(t);
+		areas.push_back(area_new);
+		area_sum += area_new;
+		while (!t_hist.empty() && t_hist.front() < t - T){
+			area_sum -= areas.front();
+			f_hist.pop_front(); t_hist.pop_front(); areas.pop_front();
+		}
+	}
+
+	double get(){
+		if (t_hist.size() == 0) return 0;
+		else if (t_hist.size() == 1) return f_hist.front();
+		else return area_sum/(t_hist.back()-t_hist.front());
+	}
+
+	double get_exp(double c){
+		if (t_hist.size() < 2) return get();
+		double avg = 0, D = 0, t0 = t_hist.back();
+		for (auto f_it = f_hist.rbegin(), t_it = t_hist.rbegin(); next(f_it) != f_hist.rend(); ++f_it, ++t_it){
+			double w_hi = exp(-c*(t0-*t_it)), w_lo = exp(-c*(t0-*next(t_it)));
+			double dt = *t_it - *next(t_it);
+			avg += (*f_it*w_hi + *next(f_it)*w_lo)/2 * dt;
+			D += (w_hi + w_lo)/2 * dt;
+		}
+		return avg/D;
+	}
+};
+
 int main(){
 
+
 	MovingAverager M;
 	
 	for (int i=0; i<10; ++i){
@@ -56,6 +111,69 @@ int main(){
 	M.get_exp(0.00);
 	M.get_exp(0.2);
 
-	return 0;
-}
+	int nerr = 0;
 
+	// Ring buffer wraps around and grows many times
+	for (double T : {0.5, 5.0, 100.0}){
+		MovingAverager M;
+		M.set_interval(T);
+		vector<double> t, f;
+		ListAverager L{T, 0, {}, {}, {}};
+		double err = 0;
+		int n_diff = 0;
+		for (int i=0; i<20000; ++i){
+			t.push_back(i*0.1 + 0.05*sin(i));
+			f.push_back(sin(t.back()) + 2);
+			M.push(t.back(), f.back());
+			L.push(t.back(), f.back());
+			if (M.get() != L.get()) ++n_diff;
+			if (i % 97 == 0){
+				err = max(err, fabs(M.get() - direct_average(t, f, T)));
+				if (M.get_exp(0.02) != L.get_exp(0.02)) ++n_diff;
+			}
+		}
+		cout << "T = " << T << ": points = " << M.size() << ", max error = " << err << ", differences from list version = " << n_diff << "\n";
+		if (err > 1e-9 || n_diff > 0) ++nerr;
+
+		// save and restore
+		ofstream fout("moving_avg_test.txt");
+		fout.precision(17);
+		M.save(fout);
+		fout.close();
+		ifstream fin("moving_avg_test.txt");
+		MovingAverager M2;
+		M2.restore(fin);
+		fin.close();
+		remove("moving_avg_test.txt");
+		M.push(t.back()+0.1, 1);
+		M2.push(t.back()+0.1, 1);
+		if (M.get() != M2.get() || M.get_exp(0.02) != M2.get_exp(0.02)) { cout << "restored history differs\n"; ++nerr; }
+	}
+
+	// Fixed capacity keeps only the newest points
+	MovingAverager Mcap;
+	Mcap.set_interval(1e9);
+	Mcap.set_capacity(10, true);
+	for (int i=0; i<100; ++i) Mcap.push(i, i);
+	cout << "Fixed capacity: points = " << Mcap.size() << ", avg = " << Mcap.get() << "\n";
+	if (Mcap.size() != 10 || Mcap.get_first() != 90 || Mcap.get() != 94.5) ++nerr;
+
+	// ... also when restoring a longer history
+	MovingAverager Mlong;
+	Mlong.set_interval(1e9);
+	for (int i=0; i<100; ++i) Mlong.push(i, i);
+	io::BinaryWriter bw;
+	Mlong.save(bw);
+	io::BinaryReader br(bw.data());
+	MovingAverager Mfixed;
+	Mfixed.set_capacity(10, true);
+	Mfixed.restore(br);
+	cout << "Fixed capacity after restore: points = " << Mfixed.size() << ", avg = " << Mfixed.get() << "\n";
+	if (Mfixed.size() != 10 || Mfixed.get_first() != 90 || Mfixed.get() != Mcap.get()) ++nerr;
+	Mfixed.push(100, 100);
+	Mcap.push(100, 100);
+	if (Mfixed.size() != 10 || Mfixed.get() != Mcap.get()) ++nerr;
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include <cmath>
+
+#include "multipatch.h"
+
+using namespace std;
+
+// Patches get different disturbance histories, and the landscape output is the mean over patches
+int main(){
+
+	MultiPatchSimulator sim("tests/params/p.ini");
+	sim.expt_dir = "multipatch_test";
+	sim.n_patches = 4;
+	sim.n_threads = 2;
+	sim.init(1000, 1030);
+	sim.simulate();
+
+	int nerr = 0;
+
+	double gpp = 0, lai = 0, n_ind = 0;
+	for (auto& p : sim.patches){
+		cout << "t_clear = " << p->t_clear << ", GPP = " << p->props.gpp << ", LAI = " << p->props.lai << "\n";
+		gpp += p->props.gpp / sim.n_patches;
+		lai += p->props.lai / sim.n_patches;
+		n_ind += p->cwm.n_ind / sim.n_patches;
+	}
+	cout << "Landscape: GPP = " << sim.props.gpp << ", LAI = " << sim.props.lai << "\n";
+	if (fabs(sim.props.gpp - gpp) > 1e-12*fabs(gpp) || fabs(sim.props.lai - lai) > 1e-12*fabs(lai) || fabs(sim.cwm.n_ind - n_ind) > 1e-12*fabs(n_ind)){
+		cout << "Landscape average differs from mean over patches\n"; ++nerr;
+	}
+
+	bool all_same = true;
+	for (auto& p : sim.patches) all_same = all_same && (p->t_clear == sim.patches[0]->t_clear);
+	if (all_same){ cout << "Patches have identical disturbance times\n"; ++nerr; }
+
+	sim.close();
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <memory>
+
+#include "treelife.h"
+#include "utils/thread_pool.h"
+
+using namespace std;
+
+inline double runif(double rmin=0, double rmax=1){
+	double r = double(rand())/RAND_MAX;
+	return rmin + (rmax-rmin)*r;
+}
+
+// Rates of all plants, for comparison
+vector<double> collect_rates(vector<plant::Plant>& plants){
+	vector<double> v;
+	for (auto& p : plants){
+		v.push_back(p.rates.dlai_dt);
+		v.push_back(p.rates.dsize_dt);
+		v.push_back(p.rates.dmort_dt);
+		v.push_back(p.rates.dseeds_dt);
+	}
+	return v;
+}
+
+int main(){
+
+	LifeHistoryOptimizer lho;
+	lho.params_file = "tests/params/p.ini";
+	lho.init();
+
+	int nt = max(2u, thread::hardware_concurrency());
+	ThreadPool pool(nt);
+	cout << "Threads: " << pool.size() << "\n";
+
+	for (bool use_cache : {false, true}){
+		// Cohorts of 2 species with random sizes. Cohorts of a species share the Phydro cache
+		vector<plant::Plant> plants;
+		for (int k=0; k<2; ++k){
+			plant::Plant P;
+			P.initParamsFromFile("tests/params/p.ini");
+			P.traits.hmat = (k==0)? 29.18 : 12;
+			P.coordinateTraits();
+			if (use_cache) P.assimilator.phydro_cache = std::make_shared<plant::PhydroCache>(1e-4);
+			for (int i=0; i<500; ++i){
+				P.set_size(exp(runif(log(0.01), log(0.8))));
+				P.geometry.set_lai(runif(0.5, 3));
+				plants.push_back(P);
+			}
+		}
+
+		auto t0 = chrono::steady_clock::now();
+		for (auto& p : plants) p.calc_demographic_rates(lho.C, 2000);
+		auto t1 = chrono::steady_clock::now();
+		vector<double> rates_serial = collect_rates(plants);
+
+		if (use_cache){  // start the parallel run from empty tables
+			plants[0].assimilator.phydro_cache->clear();
+			plants.back().assimilator.phydro_cache->clear();
+		}
+
+		int chunk = 4;
+		int ntasks = (plants.size()+chunk-1)/chunk;
+		auto t2 = chrono::steady_clock::now();
+		pool.parallel_for(ntasks, [&](int id){
+			for (int i=id*chunk; i<min<int>((id+1)*chunk, plants.size()); ++i) plants[i].calc_demographic_rates(lho.C, 2000);
+		});
+		auto t3 = chrono::steady_clock::now();
+		vector<double> rates_parallel = collect_rates(plants);
+
+		cout << "Phydro cache: " << (use_cache? "yes" : "no") << "\n";
+		cout << "  Serial:   " << chrono::duration<double, std::milli>(t1-t0).count() << " ms\n";
+		cout << "  Parallel: " << chrono::duration<double, std::milli>(t3-t2).count() << " ms\n";
+
+		// Results must be bit-identical
+		bool same = (rates_serial.size() == rates_parallel.size()) && 
+		            memcmp(rates_serial.data(), rates_parallel.data(), rates_serial.size()*sizeof(double)) == 0;
+		cout << "  Bit-identical: " << (same? "yes" : "no") << endl;
+		if (!same) return 1;
+	}
+
+	// Exceptions in tasks are passed to the caller
+	bool caught = false;
+	try{
+		pool.parallel_for(100, [](int i){ if (i == 57) throw std::runtime_error("task failed"); });
+	}
+	catch(std::runtime_error& e){
+		caught = true;
+	}
+	if (!caught) return 1;
+
+	return 0;
+}
+
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <memory>
+
+#include "plantfate.h"
+
+using namespace std;
+
+unique_ptr<Simulator> make_simulator(int n_threads){
+	io::Initializer I("tests/params/p.ini");
+	I.readFile();
+	I.setScalar("nSpecies", 3);
+	I.setScalar("n_threads", n_threads);
+	I.setString("evolveTraits", "yes");   // with probe species
+	I.setString("saveState", "no");
+	I.setString("asyncOutput", "no");
+
+	auto sim = make_unique<Simulator>(I, "tests/params/p.ini");
+	sim->expt_dir = "parallel_simulator_test/threads" + to_string(n_threads);
+	sim->set_random_seed(1);
+	sim->init(1000, 1020);
+	return sim;
+}
+
+// Everything the next step depends on
+vector<double> collect_state(Simulator &sim){
+	vector<double> v(sim.S.state.begin(), sim.S.state.end());
+	for (auto s : sim.S.species_vec){
+		auto spp = static_cast<MySpecies<PSPM_Plant>*>(s);
+		v.push_back(spp->xsize());
+		v.push_back(spp->seeds_hist.get());
+		v.push_back(spp->r0_hist.get());
+		for (int i=-1; i<spp->xsize(); ++i){
+			auto& c = spp->getCohort(i);
+			v.push_back(c.rates.dsize_dt);
+			v.push_back(c.rates.dlai_dt);
+			v.push_back(c.rates.dmort_dt);
+			v.push_back(c.rates.dseeds_dt);
+		}
+	}
+	v.insert(v.end(), sim.E.fapar_tot.begin(), sim.E.fapar_tot.end());
+	return v;
+}
+
+// Simulations with cohort rates computed serially and in parallel (see PSPM_Dynamic_Environment::precompute_all_cohorts())
+// must be bit-identical, also when the environment is recomputed between solver steps (which precomputes
+// rates from states that the solver then changes)
+int main(){
+	auto sim1 = make_simulator(1);
+	auto sim4 = make_simulator(4);
+
+	int nerr = 0;
+	for (double t = sim1->y0; t <= sim1->yf; t += sim1->delta_T){
+		sim1->step_to(t);
+		sim4->step_to(t);
+
+		vector<double> v1 = collect_state(*sim1);
+		vector<double> v4 = collect_state(*sim4);
+		bool same = (v1.size() == v4.size()) && memcmp(v1.data(), v4.data(), v1.size()*sizeof(double)) == 0;
+		if (!same){
+			cout << "t = " << t << ": serial and parallel runs differ\n";
+			++nerr;
+			break;
+		}
+
+		for (auto sim : {sim1.get(), sim4.get()}){
+			sim->E.computeEnv(t, &sim->S, sim->S.state.begin(), sim->S.state.begin());
+		}
+	}
+
+	sim1->close();
+	sim4->close();
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+
+#include "plant.h"
+
+using namespace std;
+
+// Plants initialized from the cached prototype must be identical to plants initialized by parsing the file,
+// and the prototype must be updated when the file changes
+int main(){
+
+	string file = "tests/params/p.ini";
+	int nerr = 0;
+
+	plant::PlantParameters par;
+	plant::PlantTraits traits;
+	par.initFromFile(file);
+	traits.initFromFile(file);
+
+	plant::Plant P;
+	P.initParamsFromFile(file);
+	if (!(P.traits == traits)) { cout << "traits differ\n"; ++nerr; }
+	if (P.par.kphio != par.kphio || P.par.m != par.m || P.par.cD1 != par.cD1 || P.par.T_seed_rain_avg != par.T_seed_rain_avg){
+		cout << "parameters differ\n"; ++nerr;
+	}
+	if (plant::Plant::params_prototype(file) != plant::Plant::params_prototype(file)){
+		cout << "file parsed again\n"; ++nerr;
+	}
+
+	// Startup cost for many species
+	int n = 1000;
+	auto t0 = chrono::steady_clock::now();
+	for (int i=0; i<n; ++i){
+		plant::Plant P1;
+		P1.par.initFromFile(file);
+		P1.traits.initFromFile(file);
+		P1.coordinateTraits();
+	}
+	auto t1 = chrono::steady_clock::now();
+	for (int i=0; i<n; ++i){
+		plant::Plant P1;
+		P1.initParamsFromFile(file);
+	}
+	auto t2 = chrono::steady_clock::now();
+	double t_parse = chrono::duration<double>(t1-t0).count();
+	double t_proto = chrono::duration<double>(t2-t1).count();
+	cout << n << " plants: parsing = " << t_parse << " s, prototype = " << t_proto << " s (" << t_parse/t_proto << "x)\n";
+
+	// Modified file is parsed again
+	string tmp = "tests/params/p_prototype_test.ini";
+	filesystem::copy_file(file, tmp, filesystem::copy_options::overwrite_existing);
+	plant::Plant P2;
+	P2.initParamsFromFile(tmp);
+	auto mtime = filesystem::last_write_time(tmp);
+	{
+		ifstream fin(file);
+		ofstream fout(tmp);
+		string line;
+		while (getline(fin, line)){
+			if (line.rfind("lma ", 0) == 0) line = "lma 0.2";
+			fout << line << "\n";
+		}
+	}
+	// as if rewritten within the timestamp resolution of the file system
+	filesystem::last_write_time(tmp, mtime);
+	P2.initParamsFromFile(tmp);
+	if (P2.traits.lma != 0.2){ cout << "modified file not parsed again\n"; ++nerr; }
+
+	// Cleared prototypes are parsed again
+	auto proto = plant::Plant::params_prototype(tmp);
+	plant::Plant::clear_params_cache(tmp);
+	if (plant::Plant::params_prototype(tmp) == proto){ cout << "prototype not cleared\n"; ++nerr; }
+	filesystem::remove(tmp);
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <thread>
+
+#include "plant.h"
+#include "climate.h"
+
+using namespace std;
+
+inline double runif(double rmin=0, double rmax=1){
+	double r = double(rand())/RAND_MAX;
+	return rmin + (rmax-rmin)*r;
+}
+
+int main(){
+
+	plant::Plant P;
+	P.initParamsFromFile("tests/params/p.ini");
+
+	env::Clim clim;
+
+	double tol = 1e-3;
+	plant::PhydroCache cache(tol);
+	auto exact = [&](double I0, double fapar){
+		return P.assimilator.leaf_assimilation_rate_exact(I0, fapar, clim, P.par, P.traits);
+	};
+
+	// Cohorts of one species in 12 successive climate snapshots, 30 derivative evaluations per snapshot
+	long n_exact = 0;
+	double err_max = 0;
+	for (int month=0; month<12; ++month){
+		clim.tc  = 25 + 3*sin(2*M_PI*month/12);
+		clim.vpd = 800 + 300*cos(2*M_PI*month/12);
+		clim.swp = -0.04 - 0.3*runif();
+
+		vector<double> c_open(300), lai(300);
+		for (int i=0; i<300; ++i){
+			c_open[i] = runif(0.01, 1);
+			lai[i] = runif(0.5, 5);
+		}
+
+		for (int k=0; k<30; ++k){
+			for (int i=0; i<300; ++i){
+				double I0 = clim.ppfd_max*c_open[i];
+				double fapar = 1-exp(-P.par.k_light*lai[i]);
+				auto r0 = exact(I0, fapar);
+				auto r1 = cache.get(I0, fapar, clim, P.par, P.traits, exact);
+				++n_exact;
+				err_max = max(err_max, fabs(r1.a - r0.a)/max(fabs(r0.a), 1e-6));
+				err_max = max(err_max, fabs(r1.vcmax - r0.vcmax)/max(fabs(r0.vcmax), 1e-6));
+				err_max = max(err_max, fabs(r1.e - r0.e)/max(fabs(r0.e), 1e-12));
+				// small perturbations of lai, as used for derivatives
+				lai[i] += 1e-3*runif(-1,1);
+			}
+		}
+	}
+
+	cache.print_stats();
+	cout << "Table: " << ((cache.is_1d())? "1D in absorbed light" : "2D in (I0, fapar)") << "\n";
+	cout << "Phydro calls without cache = " << n_exact << "\n";
+	cout << "Reduction = " << double(n_exact)/cache.n_phydro_calls << "x\n";
+	cout << "Max relative error = " << err_max << " (tol = " << tol << ")\n";
+
+	// Several threads filling one table must give the same results as a serial fill
+	vector<double> I0s(4000), fapars(4000);
+	for (int i=0; i<4000; ++i){
+		I0s[i] = clim.ppfd_max*runif(0.01, 1);
+		fapars[i] = runif(0.05, 0.99);
+	}
+	plant::PhydroCache cache_serial(tol), cache_parallel(tol);
+	vector<double> a_serial(4000), a_parallel(4000);
+	for (int i=0; i<4000; ++i) a_serial[i] = cache_serial.get(I0s[i], fapars[i], clim, P.par, P.traits, exact).a;
+	vector<thread> threads;
+	for (int t=0; t<4; ++t){
+		threads.emplace_back([&, t](){
+			for (int i=t; i<4000; i+=4) a_parallel[i] = cache_parallel.get(I0s[i], fapars[i], clim, P.par, P.traits, exact).a;
+		});
+	}
+	for (auto& th : threads) th.join();
+	bool same = (a_serial == a_parallel);
+	cout << "Parallel fill matches serial fill: " << ((same)? "yes" : "no") << "\n";
+
+	// The midpoint check does not guarantee tol everywhere in a cell, but error should be of the same order
+	if (err_max > 10*tol) return 1;
+	// The reduction depends on the curvature of Phydro's light response, so only require that the cache saves calls
+	if (cache.n_phydro_calls >= n_exact) return 1;
+	if (!same) return 1;
+	return 0;
+}
+
@@ -46,13 +46,15 @@ int main(){
 	double prng_stddev = -4.0;
 	std::default_random_engine generator;
 	std::normal_distribution<double> dist(prng_mean, prng_stddev);
+	auto forcing = std::make_shared<env::ClimateForcing>();
 	for (double t=2000; t<=2100; t=t+10){
-		C.t_met.push_back(t);
+		forcing->t_met.push_back(t);
 		double val = dist(generator);
 		if(val>0) val = 0;
-		C.v_met_swp.push_back(val);
-		fswp << C.v_met_swp[t] << "\n";
+		forcing->v_met_swp.push_back(val);
+		fswp << forcing->v_met_swp.back() << "\n";
 	}
+	C.init(forcing);
 	
 	
 	C.print(0);
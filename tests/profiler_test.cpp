@@ -0,0 +1,70 @@
+#define PLANTFATE_PROFILE
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <thread>
+#include <filesystem>
+
+#include "utils/profiler.h"
+#include "utils/thread_pool.h"
+
+using namespace std;
+
+void work(int n){
+	PF_PROFILE_SCOPE(PHYDRO);
+	volatile double x = 0;
+	for (int i=0; i<n; ++i) x = x + 1e-3*i;
+}
+
+// Timers must count calls from all threads, nested phases must include inner time,
+// and the profile file must have the calls of each simulated year.
+int main(){
+	int nerr = 0;
+	auto& P = prof::Profiler::instance();
+	P.reset();
+
+	string file = "profiler_test.txt";
+	prof::ProfileWriter W;
+	W.open(file);
+
+	// 2 steps in year 2000, 3 in 2001, 1 in 2002
+	vector<double> steps = {2000.0, 2000.5, 2001.0, 2001.25, 2001.75, 2002.0};
+	map<int, long long> expected_phydro;
+	ThreadPool pool(2);
+	for (double t : steps){
+		{
+			PF_PROFILE_SCOPE(COMPUTE_ENV);
+			pool.parallel_for(10, [](int i){ work(100000); });
+		}
+		expected_phydro[int(t)] += 10;
+		W.record(t);
+	}
+	W.close();
+
+	cout << "computeEnv: " << P.calls(prof::COMPUTE_ENV) << " calls, " << P.seconds(prof::COMPUTE_ENV) << " s\n";
+	cout << "phydro:     " << P.calls(prof::PHYDRO) << " calls, " << P.seconds(prof::PHYDRO) << " s\n";
+	if (P.calls(prof::COMPUTE_ENV) != 6 || P.calls(prof::PHYDRO) != 60) ++nerr;
+	if (P.seconds(prof::PHYDRO) <= 0) ++nerr;
+	if (pool.size() == 1 && P.seconds(prof::COMPUTE_ENV) < P.seconds(prof::PHYDRO)) ++nerr;  // with one thread, inner time is part of outer time
+
+	ifstream fin(file);
+	string line;
+	getline(fin, line);
+	if (line != "year\tphase\tcalls\tseconds") ++nerr;
+	map<int, long long> phydro, env;
+	while (getline(fin, line)){
+		stringstream ss(line);
+		int year; string phase; long long calls; double secs;
+		ss >> year >> phase >> calls >> secs;
+		if (phase == "phydro") phydro[year] = calls;
+		if (phase == "computeEnv") env[year] = calls;
+	}
+	for (auto& y : expected_phydro) cout << y.first << ": " << phydro[y.first] << " phydro calls, " << env[y.first] << " computeEnv calls\n";
+	if (phydro != expected_phydro || env[2000] != 2 || env[2001] != 3 || env[2002] != 1) ++nerr;
+
+	filesystem::remove(file);
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}
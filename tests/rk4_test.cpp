@@ -0,0 +1,59 @@
+#include <iostream>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <array>
+
+#include "utils/rk4.h"
+
+using namespace std;
+
+// Integrate dy_i/dt = -k_i y_i from 0 to 1 and return the max relative error vs exp(-k_i)
+template<class container>
+double decay_error(container y, double k0){
+	auto derivs = [k0](double t, container &y, container &dydt){
+		for (int i=0; i<y.size(); ++i) dydt[i] = -(k0+i)*y[i];
+	};
+	RK4Integrator<container> rk4;
+	for (int s=0; s<100; ++s) rk4.step(s*0.01, 0.01, y, derivs);
+	double err = 0;
+	for (int i=0; i<y.size(); ++i) err = max(err, fabs(y[i]/exp(-(k0+i)) - 1));
+	return err;
+}
+
+// Integrators do not share state: calls with different state sizes and from many threads give correct results
+int main(){
+	int nerr = 0;
+
+	// different sizes in sequence
+	for (int n : {3, 10, 1, 7}){
+		double err = decay_error(vector<double>(n, 1.0), 1);
+		cout << "n = " << n << ": error = " << err << "\n";
+		if (err > 1e-4) ++nerr;
+	}
+
+	// fixed-size integrator gives the same result as the vector one
+	double e_arr = decay_error(array<double,4>{1, 1, 1, 1}, 2);
+	double e_vec = decay_error(vector<double>(4, 1.0), 2);
+	cout << "array: " << e_arr << ", vector: " << e_vec << "\n";
+	if (e_arr != e_vec) ++nerr;
+
+	// concurrent integrators
+	vector<double> errs(8);
+	vector<thread> threads;
+	for (int i=0; i<8; ++i) threads.emplace_back([&errs, i](){ errs[i] = decay_error(vector<double>(i+2, 1.0), 0.5*i); });
+	for (auto& t : threads) t.join();
+	for (int i=0; i<8; ++i){
+		if (errs[i] != decay_error(vector<double>(i+2, 1.0), 0.5*i)) { cout << "thread " << i << " differs\n"; ++nerr; }
+	}
+
+	// Euler with a temporary workspace
+	vector<double> y = {1};
+	auto f = [](double t, vector<double> &y, vector<double> &dydt){ dydt[0] = -y[0]; };
+	for (int s=0; s<1000; ++s) Euler(s*0.001, 0.001, y, f);
+	cout << "Euler: " << y[0] << " vs " << exp(-1) << "\n";
+	if (fabs(y[0] - exp(-1)) > 1e-3) ++nerr;
+
+	cout << nerr << " errors" << endl;
+	return (nerr > 0)? 1 : 0;
+}